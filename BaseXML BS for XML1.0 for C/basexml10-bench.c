@@ -0,0 +1,79 @@
+/*********************************************************************\
+
+BaseXML - small message benchmark
+
+USAGE            :  gcc -O3 basexml10-bench.c -o basexml10-bench.exe
+					 basexml10-bench.exe [<Calls>]
+
+DESCRIPTION      :  Time per call, in ns, of basexml_encode_small /
+					 basexml_decode_small against the streaming
+					 basexml_encoder_* / basexml_decoder_* functions,
+					 for messages of 1 to 64 bytes (best of 5 runs of
+					 <Calls> calls, 200000 by default).
+
+\******************************************************************** */
+
+#define BASEXML_NO_MAIN
+#include "basexml10.c"
+#include <time.h>
+
+static volatile unsigned char sink;
+
+static double best_ns( int op, const unsigned char *in, size_t len, unsigned char *out, long calls )
+{
+	basexml_encoder enc;
+	basexml_decoder dec;
+	size_t n, m;
+	double best = 1e30, t;
+	clock_t start;
+	long i;
+	int run;
+
+	for( run = 0; run < 5; run++ ) {
+		start = clock();
+		for( i = 0; i < calls; i++ ) {
+			switch( op ) {
+				case 0: // streaming encode
+					basexml_encoder_init( &enc );
+					n = basexml_encoder_update( &enc, in, len, out );
+					basexml_encoder_finish( &enc, out + n );
+					break;
+				case 1: // small encode
+					basexml_encode_small( in, len, out );
+					break;
+				case 2: // streaming decode
+					basexml_decoder_init( &dec );
+					basexml_decoder_update( &dec, in, len, out, &n );
+					basexml_decoder_finish( &dec, out + n, &m );
+					break;
+				case 3: // small decode
+					basexml_decode_small( in, len, out, &n );
+					break;
+			}
+			sink ^= out[0];
+		}
+		t = (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / calls;
+		if( t < best ) best = t;
+	}
+	return best;
+}
+
+int main( int argc, char **argv )
+{
+	unsigned char raw[BASEXML_SMALL_MAX], enc[BASEXML_SMALL_MAX * 2], out[BASEXML_SMALL_MAX * 2];
+	long calls = argc > 1 ? atol( argv[1] ) : 200000;
+	size_t len, enc_len;
+
+	srand( 1 );
+	for( len = 0; len < BASEXML_SMALL_MAX; len++ ) {
+		raw[len] = (unsigned char) rand();
+	}
+	printf( "bytes  encode ns/call (stream small)  decode ns/call (stream small)\n" );
+	for( len = 1; len <= BASEXML_SMALL_MAX; len++ ) {
+		enc_len = basexml_encode_small( raw, len, enc );
+		printf( "%5u  %14.1f %6.1f  %14.1f %6.1f\n", (unsigned) len,
+		        best_ns( 0, raw, len, out, calls ), best_ns( 1, raw, len, out, calls ),
+		        best_ns( 2, enc, enc_len, out, calls ), best_ns( 3, enc, enc_len, out, calls ) );
+	}
+	return 0;
+}
@@ -15,6 +15,22 @@ LICENSE          :  Open source under the MIT License.
 USAGE            :  Compile and run as a command line to see the help.
 					 To compile: gcc -O3 basexml10.c -o basexml10.exe
 					 Download MinGW to compile on Windows.
+					 As a library: #include "basexml10.c" after
+					 #define BASEXML_NO_MAIN, and use the streaming
+					 basexml_encoder_* / basexml_decoder_* functions,
+					 or basexml_encode_small / basexml_decode_small
+					 for short messages (basexml10-bench.c times them).
+					 Framed data (-e --framed) is decoded frame by
+					 frame, in parallel when compiled with
+					 -DBASEXML_WITH_PTHREADS -lpthread.
+					 Compression (-e --zlib/--zstd) needs
+					 -DBASEXML_WITH_ZLIB -lz or -DBASEXML_WITH_ZSTD
+					 -lzstd.
+					 basexml_writer_* / basexml_write_* make a
+					 streaming XML writer with binary content,
+					 basexml_scan_* extract it from documents, and
+					 basexml_expat_attach (-DBASEXML_WITH_EXPAT
+					 -lexpat) decodes it as expat parses.
 
 DESCRIPTION      :  This software encodes and decodes binary data for
                      use WITHIN AN XML 1.0 document, with a minimum
@@ -34,8 +50,9 @@ REQUIREMENTS     :  Your XML parser MUST:
 NON-REQUIREMENTS :  Your XML file SHOULD:
 				      - Declare UTF-8 encoding:
 				        <?xml version="1.0" encoding="UTF-8" ?>
-				        (dont' forget DOCTYPE or standalone,
-						XML1.1 is fine too)
+				        (dont' forget DOCTYPE or standalone;
+						XML1.1 documents need BaseXML for
+						XML1.1: -e11/-d11, see encodeblock11)
 				    With this XML1.0 BINARY SAFE version, your parser
                      **DOESN'T NEED** to read and write XML files in
 					 binary mode. Awesome!
@@ -98,11 +115,65 @@ Except as contained in this notice, the name(s) of the above copyright
  
 \******************************************************************* */
 
+#if !defined(_WIN32) && !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64 // files over 2GB for fseeko/ftello
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
+#include <stddef.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+#ifdef BASEXML_WITH_PTHREADS
+#include <pthread.h> // parallel frames, link with -lpthread
+#endif
+#ifdef BASEXML_WITH_ZLIB
+#include <zlib.h>    // link with -lz
+#endif
+#ifdef BASEXML_WITH_ZSTD
+#include <zstd.h>    // link with -lzstd
+#endif
+#ifdef BASEXML_WITH_EXPAT
+#include <expat.h>   // link with -lexpat
+#endif
+#ifdef BASEXML_WITH_LIBXML2
+#include <libxml/xmlwriter.h> // -I/usr/include/libxml2, link with -lxml2
+#endif
+
+#ifdef _WIN32
+#define basexml_fseek _fseeki64
+#define basexml_ftell _ftelli64
+typedef __int64 basexml_off_t;
+#else
+#include <sys/types.h>
+#define basexml_fseek fseeko
+#define basexml_ftell ftello
+typedef off_t basexml_off_t;
+#endif
 
-#define DEBUG        1
+#ifdef _WIN32
+#include <io.h>
+#define basexml_truncate(file, len) _chsize_s( _fileno( file ), len )
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#define basexml_truncate(file, len) ftruncate( fileno( file ), len )
+#endif
+
+#ifndef DEBUG
+#define DEBUG        0 // -DDEBUG=1 to trace every block on stderr
+#endif
 #define debug_print(...) \
             do { if (DEBUG) fprintf(stderr, __VA_ARGS__); } while (0)
 
@@ -120,6 +191,16 @@ Except as contained in this notice, the name(s) of the above copyright
 #define BASEXML_ILLEGAL_TERMINATION 5
 #define BASEXML_SYNTAX_TOOMANYARGS  6
 #define BASEXML_UNEXPECTED_END      7
+#define BASEXML_OUT_OF_RANGE        8
+#define BASEXML_UNDECODABLE_GROUP   9
+#define BASEXML_CRC_MISMATCH       10
+#define BASEXML_BAD_FRAMING        11
+#define BASEXML_BAD_CODEC          12
+#define BASEXML_CODEC_ERROR        13
+#define BASEXML_WRITER_ERROR       14
+#define BASEXML_BAD_BASE64         15
+#define BASEXML_BAD_ESCAPE         16
+#define BASEXML_CONTAINER          17
 
 /*
 ** basexml_message
@@ -127,7 +208,7 @@ Except as contained in this notice, the name(s) of the above copyright
 ** Gather text messages in one place.
 **
 */
-#define BASEXML_MAX_MESSAGES 8
+#define BASEXML_MAX_MESSAGES 18
 const char *basexml_msgs[ BASEXML_MAX_MESSAGES ] = {
             "basexml:000:Invalid Message Code.",
             "basexml:001:Syntax Error -- check help (-h) for usage.",
@@ -136,7 +217,17 @@ const char *basexml_msgs[ BASEXML_MAX_MESSAGES ] = {
             "basexml:004:Error on output file close.",
             "basexml:005:BaseXML illegal input - Illegal BaseXML termination sequence.",
             "basexml:006:Syntax: Too many arguments.",
-			"basexml:007:BaseXML illegal input - Unexpected end of decoding stream."
+			"basexml:007:BaseXML illegal input - Unexpected end of decoding stream.",
+			"basexml:008:Range out of the decoded data.",
+			"basexml:009:BaseXML illegal input - Undecodable group.",
+			"basexml:010:CRC32C mismatch - Decoded data is corrupted.",
+			"basexml:011:BaseXML illegal input - Bad framed header or index.",
+			"basexml:012:Compression codec unknown or not in this build.",
+			"basexml:013:Compression codec error - Bad compressed data.",
+			"basexml:014:XML writer misuse - Bad nesting, or names too long.",
+			"basexml:015:Base64 illegal input.",
+			"basexml:016:Escaped data illegal input - Bad marker or escape.",
+			"basexml:017:Framed, compressed or escaped data - Only decoded whole (-d)."
 };
 
 #define basexml_message( ec ) ((ec > 0 && ec < BASEXML_MAX_MESSAGES ) ? basexml_msgs[ ec ] : basexml_msgs[ 0 ])
@@ -188,9 +279,119 @@ debug_print ("Debug info "BYTETOBINARYPATTERN"\n", BYTETOBINARY(!(in[0] & 0xf0))
 */
 /* /DEBUG INFORMATION */
 
-// This could also be put in encodeblock and decodeblock but it may be faster "globally"
-uint32_t input  = 0x00000000;
-uint32_t output = 0x00000000;
+/*
+** encode20
+**
+** encode the 20 bits at the top of input (ABCDEFGH IJKLMNOP QRST0000)
+** into 24 bits at the top of the result, case by case
+*/
+static uint32_t encode20( uint32_t input )
+{
+	uint32_t output = 0x00000000;
+
+	// input = ABCDEFGH IJKLMNOP QRST0000
+
+	// Case ILLEGAL<>_BOTH I3
+	if ( ( input & 0x03efd000 ) == 0x01e3c000 ) { // GHIJKMNOPQRT == 011110011110
+			output  = 0x38404000; // 001110LS 01ABCDEF 01000000 ********
+			output |= (input & 0x00100000) <<  5; // L
+			output |= (input & 0x00002000) << 11; // S
+			output |= (input & 0xfc000000) >> 10; // ABCDEF
+	} else 
+	// Case ILLEGAL<>_LEFT I1
+	if ( ( input & 0x03e80000 ) == 0x01e00000 ) { // GHIJKM == 011110
+			output  = 0x30404000; // 001100LT 01ABCDEF 01NOPQRS ********
+			output |= (input & 0x00100000) <<  5; // L
+			output |= (input & 0x00001000) << 12; // T
+			output |= (input & 0xfc000000) >> 10; // ABCDEF
+			output |= (input & 0x0007e000) >>  5; // NOPQRS
+	} else 
+	// Case ILLEGAL<>_RIGHT I2
+	if ( ( input & 0x0007d000 ) == 0x0003c000 ) { // NOPQRT == 011110
+			output  = 0x34404000; // 001101SM 01ABCDEF 01GHIJKL ********
+			output |= (input & 0x00002000) << 12; // S
+			output |= (input & 0x00080000) <<  5; // M
+			output |= (input & 0xfc000000) >> 10; // ABCDEF
+			output |= (input & 0x03f00000) >> 12; // GHIJKL
+	} else 
+	if ( input & 0x03000000  &&  // GH != 00
+
+	 input & 0x00060000 ) { // NO != 00
+
+	// Case STANDARD E1
+			output  = 0x40000000; // 01ABCDEF 0GHIJKLM 0NOPQRST ********
+			output |= (input & 0xfc000000) >>  2; // ABCDEF
+			output |= (input & 0x03f80000) >>  3; // GHIJKLM
+			output |= (input & 0x0007f000) >>  4; // NOPQRST
+	} else 
+	// Case CONTROL_CHARS_LEFT_CANONICAL E5 : ABCD==0000 and GH==00
+	if ( !( input & 0xf3000000 ) ) { // ABCDGH == 000000
+			output  = 0x20204000; // 0010EFIJ 0010KLMN 01OPQRST ********
+			output |= (input & 0x0c000000); // EF
+			output |= (input & 0x00c00000) <<  2; // IJ
+			output |= (input & 0x003c0000) >>  2; // KLMN
+			output |= (input & 0x0003f000) >>  4; // OPQRST
+	} else 
+	// Case CONTROL_CHARS_RIGHT_CANONICAL E6 : ABCD==0000 and NO==00
+	if ( !( input & 0xf0060000 ) ) { // ABCDNO == 000000
+			output  = 0x20402000; // 0010PEFG 01HIJKLM 0010QRST ********
+			output |= (input & 0x00010000) << 11; // P
+			output |= (input & 0x0e000000) >>  1; // EFG
+			output |= (input & 0x01f80000) >>  3; // HIJKLM
+			output |= (input & 0x0000f000) >>  4; // QRST
+	} else 
+	// Case CONTROL_CHARS_BOTH E2
+	if ( !( input & 0x03060000 ) ) { // GHNO == 0000
+			output  = 0x20404000; // 0010ABCD 01EFIJKL 01MPQRST ********
+			output |= (input & 0xf0000000) >>  4; // ABCD
+			output |= (input & 0x0c000000) >>  6; // EF
+			output |= (input & 0x00f00000) >>  4; // IJKL
+			output |= (input & 0x00080000) >>  6; // M
+			output |= (input & 0x0001f000) >>  4; // PQRST
+	} else 
+	// Case CONTROL_CHARS_LEFT E3
+	if ( !( input & 0x03000000 ) ) { // GH == 00
+			output  = 0x00c08000; // 0NOPQRST 110ABCDE 10MFIJKL ********
+			output |= (input & 0x0007f000) << 12; // NOPQRST
+			output |= (input & 0xf8000000) >> 11; // ABCDE
+			output |= (input & 0x00080000) >>  6; // M
+			output |= (input & 0x04000000) >> 14; // F
+			output |= (input & 0x00f00000) >> 12; // IJKL
+	} else 
+	// Case CONTROL_CHARS_RIGHT E4
+	if ( !( input & 0x00060000 ) ) { // NO == 00
+			output  = 0xc0800000; // 110ABCDE 10FPQRST 0GHIJKLM ********
+			output |= (input & 0xf8000000) >>  3; // ABCDE
+			output |= (input & 0x04000000) >>  5; // F
+			output |= (input & 0x0001f000) <<  4; // PQRST
+			output |= (input & 0x03f80000) >> 11; // GHIJKLM
+	}
+		
+
+	debug_print ("ENCODEBLOCK input   32: "BYTETOBINARYPATTERN"\n", BYTETOBINARY(input));
+	debug_print ("ENCODEBLOCK out<>   32: "BYTETOBINARYPATTERN"\n", BYTETOBINARY(output));
+	
+	
+
+	
+	
+	// XML ENTITY UNALLOWED CHARS
+	/*
+		On "encoded" variable apply:
+		convert & (0x26) to TAB (0x09)
+	*/
+	if ((output & 0xFF000000) == 0x26000000) {
+		output &= 0x00FFFFFF; output |= 0x09000000;
+	}
+	if ((output & 0x00FF0000) == 0x00260000) {
+		output &= 0xFF00FFFF; output |= 0x00090000;
+	}
+	if ((output & 0x0000FF00) == 0x00002600) {
+		output &= 0xFFFF00FF; output |= 0x00000900;
+	}
+
+	return output;
+}
 
 static void encodeblock( unsigned char *in, unsigned char *out, int len ) // encode 1 block of 2*20=40 bits (5 bytes) into 2*24=48 bits (6 bytes)
 {
@@ -201,6 +402,8 @@ static void encodeblock( unsigned char *in, unsigned char *out, int len ) // enc
 	int i = 0;
 	int illegal_left = 0;
 	int illegal_right = 0;
+	uint32_t input  = 0x00000000; // local, not global: frames can be encoded by several threads
+	uint32_t output = 0x00000000;
 	do {
 		// in each loop (2 loops except if termination), we encode 20bits to 24 bits
 		// i == 1 && len = 1,2 => end of stream reached in the first 20 bits (ie after the 1st or 2nd stream byte), result will be a 20bit termination sequence followed by a 20bit feed sequence
@@ -217,106 +420,7 @@ static void encodeblock( unsigned char *in, unsigned char *out, int len ) // enc
 					in[1] << 16 |
 					(in[2] & 0xF0) << 8;
 		
-		// input = ABCDEFGH IJKLMNOP QRST0000
-
-		// Case ILLEGAL<>_BOTH I3
-		if ( ( input & 0x03efd000 ) == 0x01e3c000 ) { // GHIJKMNOPQRT == 011110011110
-				output  = 0x38404000; // 001110LS 01ABCDEF 01000000 ********
-				output |= (input & 0x00100000) <<  5; // L
-				output |= (input & 0x00002000) << 11; // S
-				output |= (input & 0xfc000000) >> 10; // ABCDEF
-		} else 
-		// Case ILLEGAL<>_LEFT I1
-		if ( ( input & 0x03e80000 ) == 0x01e00000 ) { // GHIJKM == 011110
-				output  = 0x30404000; // 001100LT 01ABCDEF 01NOPQRS ********
-				output |= (input & 0x00100000) <<  5; // L
-				output |= (input & 0x00001000) << 12; // T
-				output |= (input & 0xfc000000) >> 10; // ABCDEF
-				output |= (input & 0x0007e000) >>  5; // NOPQRS
-		} else 
-		// Case ILLEGAL<>_RIGHT I2
-		if ( ( input & 0x0007d000 ) == 0x0003c000 ) { // NOPQRT == 011110
-				output  = 0x34404000; // 001101SM 01ABCDEF 01GHIJKL ********
-				output |= (input & 0x00002000) << 12; // S
-				output |= (input & 0x00080000) <<  5; // M
-				output |= (input & 0xfc000000) >> 10; // ABCDEF
-				output |= (input & 0x03f00000) >> 12; // GHIJKL
-		} else 
-		if ( input & 0x03000000  &&  // GH != 00
-
-		 input & 0x00060000 ) { // NO != 00
-
-		// Case STANDARD E1
-				output  = 0x40000000; // 01ABCDEF 0GHIJKLM 0NOPQRST ********
-				output |= (input & 0xfc000000) >>  2; // ABCDEF
-				output |= (input & 0x03f80000) >>  3; // GHIJKLM
-				output |= (input & 0x0007f000) >>  4; // NOPQRST
-		} else 
-		// Case CONTROL_CHARS_LEFT_CANONICAL E5 : ABCD==0000 and GH==00
-		if ( !( input & 0xf3000000 ) ) { // ABCDGH == 000000
-				output  = 0x20204000; // 0010EFIJ 0010KLMN 01OPQRST ********
-				output |= (input & 0x0c000000); // EF
-				output |= (input & 0x00c00000) <<  2; // IJ
-				output |= (input & 0x003c0000) >>  2; // KLMN
-				output |= (input & 0x0003f000) >>  4; // OPQRST
-		} else 
-		// Case CONTROL_CHARS_RIGHT_CANONICAL E6 : ABCD==0000 and NO==00
-		if ( !( input & 0xf0060000 ) ) { // ABCDNO == 000000
-				output  = 0x20402000; // 0010PEFG 01HIJKLM 0010QRST ********
-				output |= (input & 0x00010000) << 11; // P
-				output |= (input & 0x0e000000) >>  1; // EFG
-				output |= (input & 0x01f80000) >>  3; // HIJKLM
-				output |= (input & 0x0000f000) >>  4; // QRST
-		} else 
-		// Case CONTROL_CHARS_BOTH E2
-		if ( !( input & 0x03060000 ) ) { // GHNO == 0000
-				output  = 0x20404000; // 0010ABCD 01EFIJKL 01MPQRST ********
-				output |= (input & 0xf0000000) >>  4; // ABCD
-				output |= (input & 0x0c000000) >>  6; // EF
-				output |= (input & 0x00f00000) >>  4; // IJKL
-				output |= (input & 0x00080000) >>  6; // M
-				output |= (input & 0x0001f000) >>  4; // PQRST
-		} else 
-		// Case CONTROL_CHARS_LEFT E3
-		if ( !( input & 0x03000000 ) ) { // GH == 00
-				output  = 0x00c08000; // 0NOPQRST 110ABCDE 10MFIJKL ********
-				output |= (input & 0x0007f000) << 12; // NOPQRST
-				output |= (input & 0xf8000000) >> 11; // ABCDE
-				output |= (input & 0x00080000) >>  6; // M
-				output |= (input & 0x04000000) >> 14; // F
-				output |= (input & 0x00f00000) >> 12; // IJKL
-		} else 
-		// Case CONTROL_CHARS_RIGHT E4
-		if ( !( input & 0x00060000 ) ) { // NO == 00
-				output  = 0xc0800000; // 110ABCDE 10FPQRST 0GHIJKLM ********
-				output |= (input & 0xf8000000) >>  3; // ABCDE
-				output |= (input & 0x04000000) >>  5; // F
-				output |= (input & 0x0001f000) <<  4; // PQRST
-				output |= (input & 0x03f80000) >> 11; // GHIJKLM
-		}
-			
-
-		debug_print ("ENCODEBLOCK(%i) input   32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(input));
-		debug_print ("ENCODEBLOCK(%i) out<>   32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(output));
-		
-		
-
-		
-		
-		// XML ENTITY UNALLOWED CHARS
-		/*
-			On "encoded" variable apply:
-			convert & (0x26) to TAB (0x09)
-		*/
-		if ((output & 0xFF000000) == 0x26000000) {
-			output &= 0x00FFFFFF; output |= 0x09000000;
-		}
-		if ((output & 0x00FF0000) == 0x00260000) {
-			output &= 0xFF00FFFF; output |= 0x00090000;
-		}
-		if ((output & 0x0000FF00) == 0x00002600) {
-			output &= 0xFFFF00FF; output |= 0x00000900;
-		}
+		output = encode20( input );
 		
 		debug_print ("ENCODEBLOCK(%i) outXML  32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(output));
 		
@@ -357,6 +461,112 @@ static void encodeblock( unsigned char *in, unsigned char *out, int len ) // enc
 }
 
 
+/*
+** decode20
+**
+** decode the 24 bits at the top of input into 20 bits at the top of
+** the result, 0 if undecodable
+*/
+static uint32_t decode20( uint32_t input )
+{
+	uint32_t output = 0x00000000;
+
+	debug_print ("DECODEBLOCK inXML   32: "BYTETOBINARYPATTERN"\n", BYTETOBINARY(input));
+	
+	// XML ENTITY UNALLOWED CHARS
+	// Preliminary transform of \n\r\t to <>& in each encoded byte
+	if((input & 0xFF000000) == 0x09000000) {
+		input &= 0x00FFFFFF; input |= 0x26000000;
+	}
+	
+	if((input & 0x00FF0000) == 0x00090000) {
+		input &= 0xFF00FFFF; input |= 0x00260000;
+	}
+	
+	if((input & 0x0000FF00) == 0x00000900) {
+		input &= 0xFFFF00FF; input |= 0x00002600;
+	}
+	
+	debug_print ("DECODEBLOCK in<>    32: "BYTETOBINARYPATTERN"\n", BYTETOBINARY(input));
+			
+
+	// Case ILLEGAL<>_BOTH I3 DECODE
+	if ( ( input & 0xfcc0f000 ) == 0x38404000 ) { // ABCDEFIJQRST == 001110010100
+		    output  = 0x01e3c000; // 001110LS 01ABCDEF 01000000 ********
+		    output |= (input & 0x02000000) >>  5; // L
+		    output |= (input & 0x01000000) >> 11; // S
+		    output |= (input & 0x003f0000) << 10; // ABCDEF
+	} else 
+	// Case ILLEGAL<>_LEFT I1 DECODE
+	if ( ( input & 0xfcc0c000 ) == 0x30404000 ) { // ABCDEFIJQR == 0011000101
+		    output  = 0x01e00000; // 001100LT 01ABCDEF 01NOPQRS ********
+		    output |= (input & 0x02000000) >>  5; // L
+		    output |= (input & 0x01000000) >> 12; // T
+		    output |= (input & 0x003f0000) << 10; // ABCDEF
+		    output |= (input & 0x00003f00) <<  5; // NOPQRS
+	} else 
+	// Case ILLEGAL<>_RIGHT I2 DECODE
+	if ( ( input & 0xfcc0c000 ) == 0x34404000 ) { // ABCDEFIJQR == 0011010101
+		    output  = 0x0003c000; // 001101SM 01ABCDEF 01GHIJKL ********
+		    output |= (input & 0x02000000) >> 12; // S
+		    output |= (input & 0x01000000) >>  5; // M
+		    output |= (input & 0x003f0000) << 10; // ABCDEF
+		    output |= (input & 0x00003f00) << 12; // GHIJKL
+	} else 
+	// Case STANDARD E1 DECODE
+	if ( ( input & 0xc0808000 ) == 0x40000000 ) { // ABIQ == 0100
+		    output |= (input & 0x3f000000) <<  2; // ABCDEF
+		    output |= (input & 0x007f0000) <<  3; // GHIJKLM
+		    output |= (input & 0x00007f00) <<  4; // NOPQRST
+	} else 
+	// Case CONTROL_CHARS_LEFT_CANONICAL E5 : ABCD==0000 and GH==00 DECODE
+	if ( ( input & 0xf0f0c000 ) == 0x20204000 ) { // ABCDIJKLQR == 0010001001
+		    output |= (input & 0x0c000000); // EF
+		    output |= (input & 0x03000000) >>  2; // IJ
+		    output |= (input & 0x000f0000) <<  2; // KLMN
+		    output |= (input & 0x00003f00) <<  4; // OPQRST
+	} else 
+	// Case CONTROL_CHARS_RIGHT_CANONICAL E6 : ABCD==0000 and NO==00 DECODE
+	if ( ( input & 0xf0c0f000 ) == 0x20402000 ) { // ABCDIJQRST == 0010010010
+		    output |= (input & 0x08000000) >> 11; // P
+		    output |= (input & 0x07000000) <<  1; // EFG
+		    output |= (input & 0x003f0000) <<  3; // HIJKLM
+		    output |= (input & 0x00000f00) <<  4; // QRST
+	} else 
+	// Case CONTROL_CHARS_BOTH E2 DECODE
+	if ( ( input & 0xf0c0c000 ) == 0x20404000 ) { // ABCDIJQR == 00100101
+		    output |= (input & 0x0f000000) <<  4; // ABCD
+		    output |= (input & 0x00300000) <<  6; // EF
+		    output |= (input & 0x000f0000) <<  4; // IJKL
+		    output |= (input & 0x00002000) <<  6; // M
+		    output |= (input & 0x00001f00) <<  4; // PQRST
+	} else 
+	// Case CONTROL_CHARS_LEFT E3 DECODE
+	if ( ( input & 0x80e0c000 ) == 0x00c08000 ) { // AIJKQR == 011010
+		    output |= (input & 0x7f000000) >> 12; // NOPQRST
+		    output |= (input & 0x001f0000) << 11; // ABCDE
+		    output |= (input & 0x00002000) <<  6; // M
+		    output |= (input & 0x00001000) << 14; // F
+		    output |= (input & 0x00000f00) << 12; // IJKL
+	} else 
+	// Case CONTROL_CHARS_RIGHT E4 DECODE
+	if ( ( input & 0xe0c08000 ) == 0xc0800000 ) { // ABCIJQ == 110100
+		    output |= (input & 0x1f000000) <<  3; // ABCDE
+		    output |= (input & 0x00200000) <<  5; // F
+		    output |= (input & 0x001f0000) >>  4; // PQRST
+		    output |= (input & 0x00007f00) << 11; // GHIJKLM
+	} /*
+	  else if( ( input & 0xfff0ff00 ) == 0x3f303f00 ) { // == 00111111 0011**** 00111111 ********
+
+		// ERROR
+		// BaseXML10BS termination sequence doesn't store encoded bytes.
+		// That's the job of decode() to anticipate termination sequence and pass len to decodeblock().
+
+	} */
+
+	return output;
+}
+
 /*
 ** decodeblock
 **
@@ -373,6 +583,8 @@ static void decodeblock( unsigned char *in, unsigned char *out)
 	debug_print ("DECODEBLOCK input bytes[0-6]: 0x%x 0x%x 0x%x 0x%x 0x%x 0x%x\n", in[0], in[1], in[2], in[3], in[4], in[5]);
 	
 	int i = 0;
+	uint32_t input  = 0x00000000; // local, not global: frames can be decoded by several threads
+	uint32_t output = 0x00000000;
 	do {
 
 		debug_print ("DECODEBLOCK loop i=%i\n", i);
@@ -386,268 +598,4503 @@ static void decodeblock( unsigned char *in, unsigned char *out)
 					in[1] << 16 |
 					in[2] << 8;
 	
-		output  = 0x00000000;
-		
-		debug_print ("DECODEBLOCK(%i) inXML   32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(input));
-		
-		// XML ENTITY UNALLOWED CHARS
-		// Preliminary transform of \n\r\t to <>& in each encoded byte
-		if((input & 0xFF000000) == 0x09000000) {
-			input &= 0x00FFFFFF; input |= 0x26000000;
-		}
-		
-		if((input & 0x00FF0000) == 0x00090000) {
-			input &= 0xFF00FFFF; input |= 0x00260000;
-		}
+		output = decode20( input );
 		
-		if((input & 0x0000FF00) == 0x00000900) {
-			input &= 0xFFFF00FF; input |= 0x00002600;
+	debug_print ("DECODEBLOCK(%i) output  32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(output));
+	
+		if(i) {
+			out[2] |= ((unsigned char) (output >> 28)) & 0x0F;
+			out[3]  =  (unsigned char) (output >> 20);
+			out[4]  =  (unsigned char) (output >> 12);	
+		} else {
+			out[0]  =  (unsigned char) (output >> 24);
+			out[1]  =  (unsigned char) (output >> 16);
+			out[2]  =  (unsigned char) (output >> 8);
 		}
 		
-		debug_print ("DECODEBLOCK(%i) in<>    32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(input));
-				
+	} while (++i != 2);
+
+	debug_print ("DECODEBLOCK output bytes[0-5]: 0x%x 0x%x 0x%x 0x%x 0x%x\n",   out[0], out[1], out[2], out[3], out[4]);
+	
+}
+
 
-		// Case ILLEGAL<>_BOTH I3 DECODE
-		if ( ( input & 0xfcc0f000 ) == 0x38404000 ) { // ABCDEFIJQRST == 001110010100
-			    output  = 0x01e3c000; // 001110LS 01ABCDEF 01000000 ********
-			    output |= (input & 0x02000000) >>  5; // L
-			    output |= (input & 0x01000000) >> 11; // S
-			    output |= (input & 0x003f0000) << 10; // ABCDEF
+/*
+** encodeblock11 / decodeblock11
+**
+** BaseXML for XML1.1. XML 1.1 only allows DEL (0x7F) and the C1 controls
+** (U+0080-U+009F, U+0085 even becomes a line feed) as character
+** references, and the XML1.0 cases above write some of them. The 20-bit
+** sequences that would get one (about 3% of them) are caught first and
+** written as one 3-byte UTF-8 character (U+1000-U+CFFF) instead, which
+** the XML1.0 cases never write. Same 20% overhead, same termination
+** sequence: XML 1.1 allows no more characters than XML 1.0 does, so it
+** can't be denser. Cases generated by auto_transposer.py (XML 1.1 part).
+** A stream of it starts with the ?X? marker (like ?F?, never the start
+** of plain BaseXML data): basexml_decoder switches to it by itself.
+*/
+#define BASEXML_XML11_MARKER "?X?"
+
+static uint32_t encode20_xml11( uint32_t input ) // input = ABCDEFGH IJKLMNOP QRST0000, 0 if XML1.0 case is fine
+{
+	uint32_t output = 0x00000000;
+
+		// Case XML11_ABCDEF X1
+		if ( ( input & 0xfc000000 ) == 0xfc000000 ) { // ABCDEF == 111111
+			    output  = 0xe4808000; // 111001GH 10IJKLMN 10OPQRST ********
+			    output |= (input & 0x03000000); // GH
+			    output |= (input & 0x00fc0000) >>  2; // IJKLMN
+			    output |= (input & 0x0003f000) >>  4; // OPQRST
+		} else 
+		// Case XML11_GHIJKLM X2
+		if ( ( input & 0x03f80000 ) == 0x03f80000 ) { // GHIJKLM == 1111111
+			    output  = 0xe8808000; // 1110100A 10BCDEFN 10OPQRST ********
+			    output |= (input & 0x80000000) >>  7; // A
+			    output |= (input & 0x7c000000) >>  9; // BCDEF
+			    output |= (input & 0x00040000) >>  2; // N
+			    output |= (input & 0x0003f000) >>  4; // OPQRST
+		} else 
+		// Case XML11_NOPQRST X3
+		if ( ( input & 0x0007f000 ) == 0x0007f000 ) { // NOPQRST == 1111111
+			    output  = 0xea808000; // 1110101A 10BCDEFG 10HIJKLM ********
+			    output |= (input & 0x80000000) >>  7; // A
+			    output |= (input & 0x7e000000) >>  9; // BCDEFG
+			    output |= (input & 0x01f80000) >> 11; // HIJKLM
 		} else 
-		// Case ILLEGAL<>_LEFT I1 DECODE
-		if ( ( input & 0xfcc0c000 ) == 0x30404000 ) { // ABCDEFIJQR == 0011000101
-			    output  = 0x01e00000; // 001100LT 01ABCDEF 01NOPQRS ********
-			    output |= (input & 0x02000000) >>  5; // L
-			    output |= (input & 0x01000000) >> 12; // T
-			    output |= (input & 0x003f0000) << 10; // ABCDEF
-			    output |= (input & 0x00003f00) <<  5; // NOPQRS
+		// Case XML11_C1_LEFT X4
+		if ( ( input & 0xfb080000 ) == 0x10000000 ) { // ABCDEGHM == 00010000
+			    output  = 0xec808000; // 11101100 10FIJKLN 10OPQRST ********
+			    output |= (input & 0x04000000) >>  5; // F
+			    output |= (input & 0x00f00000) >>  3; // IJKL
+			    output |= (input & 0x00040000) >>  2; // N
+			    output |= (input & 0x0003f000) >>  4; // OPQRST
 		} else 
-		// Case ILLEGAL<>_RIGHT I2 DECODE
-		if ( ( input & 0xfcc0c000 ) == 0x34404000 ) { // ABCDEFIJQR == 0011010101
-			    output  = 0x0003c000; // 001101SM 01ABCDEF 01GHIJKL ********
-			    output |= (input & 0x02000000) >> 12; // S
-			    output |= (input & 0x01000000) >>  5; // M
-			    output |= (input & 0x003f0000) << 10; // ABCDEF
-			    output |= (input & 0x00003f00) << 12; // GHIJKL
+		// Case XML11_C1_RIGHT X5
+		if ( ( input & 0xfc060000 ) == 0x10000000 ) { // ABCDEFNO == 00010000
+			    output  = 0xe3808000; // 11100011 10GHIJKL 10MPQRST ********
+			    output |= (input & 0x03f00000) >>  4; // GHIJKL
+			    output |= (input & 0x00080000) >>  6; // M
+			    output |= (input & 0x0001f000) >>  4; // PQRST
 		} else 
-		// Case STANDARD E1 DECODE
-		if ( ( input & 0xc0808000 ) == 0x40000000 ) { // ABIQ == 0100
-			    output |= (input & 0x3f000000) <<  2; // ABCDEF
-			    output |= (input & 0x007f0000) <<  3; // GHIJKLM
-			    output |= (input & 0x00007f00) <<  4; // NOPQRST
+		// Case XML11_RIGHT_CANONICAL X6
+		if ( ( input & 0xf1fe0000 ) == 0x01f80000 ) { // ABCDHIJKLMNO == 000011111100
+			    output  = 0xe1808000; // 11100001 100000EF 10GPQRST ********
+			    output |= (input & 0x0c000000) >> 10; // EF
+			    output |= (input & 0x02000000) >> 12; // G
+			    output |= (input & 0x0001f000) >>  4; // PQRST
 		} else 
-		// Case CONTROL_CHARS_LEFT_CANONICAL E5 : ABCD==0000 and GH==00 DECODE
-		if ( ( input & 0xf0f0c000 ) == 0x20204000 ) { // ABCDIJKLQR == 0010001001
-			    output |= (input & 0x0c000000); // EF
-			    output |= (input & 0x03000000) >>  2; // IJ
-			    output |= (input & 0x000f0000) <<  2; // KLMN
+		// Case XML11_LEFT_CANONICAL X7
+		if ( ( input & 0xf303f000 ) == 0x0003f000 ) { // ABCDGHOPQRST == 000000111111
+			    output  = 0xe1848000; // 11100001 100001EF 10IJKLMN ********
+			    output |= (input & 0x0c000000) >> 10; // EF
+			    output |= (input & 0x00fc0000) >> 10; // IJKLMN
+		} else 
+		// Case XML11_BOTH_LEFT X8
+		if ( ( input & 0x0ff60000 ) == 0x0cf00000 ) { // EFGHIJKLNO == 1100111100
+			    output  = 0xe2908000; // 11100010 1001ABCD 10MPQRST ********
+			    output |= (input & 0xf0000000) >> 12; // ABCD
+			    output |= (input & 0x00080000) >>  6; // M
+			    output |= (input & 0x0001f000) >>  4; // PQRST
+		} else 
+		// Case XML11_BOTH_RIGHT X9
+		if ( ( input & 0x030ff000 ) == 0x0009f000 ) { // GHMNOPQRST == 0010011111
+			    output  = 0xe2b08000; // 11100010 1011ABCD 10EFIJKL ********
+			    output |= (input & 0xf0000000) >> 12; // ABCD
+			    output |= (input & 0x0c000000) >> 14; // EF
+			    output |= (input & 0x00f00000) >> 12; // IJKL
+		} else 
+		// Case XML11_ILLEGAL<>_LEFT X10
+		if ( ( input & 0x03efe000 ) == 0x01e7e000 ) { // GHIJKMNOPQRS == 011110111111
+			    output  = 0xe1888000; // 11100001 100010AB 10CDEFLT ********
+			    output |= (input & 0xc0000000) >> 14; // AB
+			    output |= (input & 0x3c000000) >> 16; // CDEF
+			    output |= (input & 0x00100000) >> 11; // L
+			    output |= (input & 0x00001000) >>  4; // T
+		} else 
+		// Case XML11_ILLEGAL<>_RIGHT X11
+		if ( ( input & 0x03f7d000 ) == 0x03f3c000 ) { // GHIJKLNOPQRT == 111111011110
+			    output  = 0xe18c8000; // 11100001 100011AB 10CDEFMS ********
+			    output |= (input & 0xc0000000) >> 14; // AB
+			    output |= (input & 0x3c000000) >> 16; // CDEF
+			    output |= (input & 0x00080000) >> 10; // M
+			    output |= (input & 0x00002000) >>  5; // S
+		}
+
+	return output;
+}
+
+static uint32_t decode20_xml11( uint32_t input ) // 3-byte character in, ABCDEFGH IJKLMNOP QRST0000 out
+{
+	uint32_t output = 0x00000000;
+
+		// Case XML11_ABCDEF X1 DECODE
+		if ( ( input & 0xfcc0c000 ) == 0xe4808000 ) { // ABCDEFIJQR == 1110011010
+			    output  = 0xfc000000; // 111001GH 10IJKLMN 10OPQRST ********
+			    output |= (input & 0x03000000); // GH
+			    output |= (input & 0x003f0000) <<  2; // IJKLMN
+			    output |= (input & 0x00003f00) <<  4; // OPQRST
+		} else 
+		// Case XML11_GHIJKLM X2 DECODE
+		if ( ( input & 0xfec0c000 ) == 0xe8808000 ) { // ABCDEFGIJQR == 11101001010
+			    output  = 0x03f80000; // 1110100A 10BCDEFN 10OPQRST ********
+			    output |= (input & 0x01000000) <<  7; // A
+			    output |= (input & 0x003e0000) <<  9; // BCDEF
+			    output |= (input & 0x00010000) <<  2; // N
 			    output |= (input & 0x00003f00) <<  4; // OPQRST
 		} else 
-		// Case CONTROL_CHARS_RIGHT_CANONICAL E6 : ABCD==0000 and NO==00 DECODE
-		if ( ( input & 0xf0c0f000 ) == 0x20402000 ) { // ABCDIJQRST == 0010010010
-			    output |= (input & 0x08000000) >> 11; // P
-			    output |= (input & 0x07000000) <<  1; // EFG
-			    output |= (input & 0x003f0000) <<  3; // HIJKLM
-			    output |= (input & 0x00000f00) <<  4; // QRST
+		// Case XML11_NOPQRST X3 DECODE
+		if ( ( input & 0xfec0c000 ) == 0xea808000 ) { // ABCDEFGIJQR == 11101011010
+			    output  = 0x0007f000; // 1110101A 10BCDEFG 10HIJKLM ********
+			    output |= (input & 0x01000000) <<  7; // A
+			    output |= (input & 0x003f0000) <<  9; // BCDEFG
+			    output |= (input & 0x00003f00) << 11; // HIJKLM
 		} else 
-		// Case CONTROL_CHARS_BOTH E2 DECODE
-		if ( ( input & 0xf0c0c000 ) == 0x20404000 ) { // ABCDIJQR == 00100101
-			    output |= (input & 0x0f000000) <<  4; // ABCD
-			    output |= (input & 0x00300000) <<  6; // EF
-			    output |= (input & 0x000f0000) <<  4; // IJKL
+		// Case XML11_C1_LEFT X4 DECODE
+		if ( ( input & 0xffc0c000 ) == 0xec808000 ) { // ABCDEFGHIJQR == 111011001010
+			    output  = 0x10000000; // 11101100 10FIJKLN 10OPQRST ********
+			    output |= (input & 0x00200000) <<  5; // F
+			    output |= (input & 0x001e0000) <<  3; // IJKL
+			    output |= (input & 0x00010000) <<  2; // N
+			    output |= (input & 0x00003f00) <<  4; // OPQRST
+		} else 
+		// Case XML11_C1_RIGHT X5 DECODE
+		if ( ( input & 0xffc0c000 ) == 0xe3808000 ) { // ABCDEFGHIJQR == 111000111010
+			    output  = 0x10000000; // 11100011 10GHIJKL 10MPQRST ********
+			    output |= (input & 0x003f0000) <<  4; // GHIJKL
 			    output |= (input & 0x00002000) <<  6; // M
 			    output |= (input & 0x00001f00) <<  4; // PQRST
 		} else 
-		// Case CONTROL_CHARS_LEFT E3 DECODE
-		if ( ( input & 0x80e0c000 ) == 0x00c08000 ) { // AIJKQR == 011010
-			    output |= (input & 0x7f000000) >> 12; // NOPQRST
-			    output |= (input & 0x001f0000) << 11; // ABCDE
+		// Case XML11_RIGHT_CANONICAL X6 DECODE
+		if ( ( input & 0xfffcc000 ) == 0xe1808000 ) { // ABCDEFGHIJKLMNQR == 1110000110000010
+			    output  = 0x01f80000; // 11100001 100000EF 10GPQRST ********
+			    output |= (input & 0x00030000) << 10; // EF
+			    output |= (input & 0x00002000) << 12; // G
+			    output |= (input & 0x00001f00) <<  4; // PQRST
+		} else 
+		// Case XML11_LEFT_CANONICAL X7 DECODE
+		if ( ( input & 0xfffcc000 ) == 0xe1848000 ) { // ABCDEFGHIJKLMNQR == 1110000110000110
+			    output  = 0x0003f000; // 11100001 100001EF 10IJKLMN ********
+			    output |= (input & 0x00030000) << 10; // EF
+			    output |= (input & 0x00003f00) << 10; // IJKLMN
+		} else 
+		// Case XML11_BOTH_LEFT X8 DECODE
+		if ( ( input & 0xfff0c000 ) == 0xe2908000 ) { // ABCDEFGHIJKLQR == 11100010100110
+			    output  = 0x0cf00000; // 11100010 1001ABCD 10MPQRST ********
+			    output |= (input & 0x000f0000) << 12; // ABCD
 			    output |= (input & 0x00002000) <<  6; // M
-			    output |= (input & 0x00001000) << 14; // F
+			    output |= (input & 0x00001f00) <<  4; // PQRST
+		} else 
+		// Case XML11_BOTH_RIGHT X9 DECODE
+		if ( ( input & 0xfff0c000 ) == 0xe2b08000 ) { // ABCDEFGHIJKLQR == 11100010101110
+			    output  = 0x0009f000; // 11100010 1011ABCD 10EFIJKL ********
+			    output |= (input & 0x000f0000) << 12; // ABCD
+			    output |= (input & 0x00003000) << 14; // EF
 			    output |= (input & 0x00000f00) << 12; // IJKL
 		} else 
-		// Case CONTROL_CHARS_RIGHT E4 DECODE
-		if ( ( input & 0xe0c08000 ) == 0xc0800000 ) { // ABCIJQ == 110100
-			    output |= (input & 0x1f000000) <<  3; // ABCDE
-			    output |= (input & 0x00200000) <<  5; // F
-			    output |= (input & 0x001f0000) >>  4; // PQRST
-			    output |= (input & 0x00007f00) << 11; // GHIJKLM
-		} /*
-		  else if( ( input & 0xfff0ff00 ) == 0x3f303f00 ) { // == 00111111 0011**** 00111111 ********
+		// Case XML11_ILLEGAL<>_LEFT X10 DECODE
+		if ( ( input & 0xfffcc000 ) == 0xe1888000 ) { // ABCDEFGHIJKLMNQR == 1110000110001010
+			    output  = 0x01e7e000; // 11100001 100010AB 10CDEFLT ********
+			    output |= (input & 0x00030000) << 14; // AB
+			    output |= (input & 0x00003c00) << 16; // CDEF
+			    output |= (input & 0x00000200) << 11; // L
+			    output |= (input & 0x00000100) <<  4; // T
+		} else 
+		// Case XML11_ILLEGAL<>_RIGHT X11 DECODE
+		if ( ( input & 0xfffcc000 ) == 0xe18c8000 ) { // ABCDEFGHIJKLMNQR == 1110000110001110
+			    output  = 0x03f3c000; // 11100001 100011AB 10CDEFMS ********
+			    output |= (input & 0x00030000) << 14; // AB
+			    output |= (input & 0x00003c00) << 16; // CDEF
+			    output |= (input & 0x00000200) << 10; // M
+			    output |= (input & 0x00000100) <<  5; // S
+		}
 
-			// ERROR
-			// BaseXML10BS termination sequence doesn't store encoded bytes.
-			// That's the job of decode() to anticipate termination sequence and pass len to decodeblock().
+	return output;
+}
 
-		} */
-		
-	debug_print ("DECODEBLOCK(%i) output  32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(output));
-	
-		if(i) {
-			out[2] |= ((unsigned char) (output >> 28)) & 0x0F;
-			out[3]  =  (unsigned char) (output >> 20);
-			out[4]  =  (unsigned char) (output >> 12);	
-		} else {
-			out[0]  =  (unsigned char) (output >> 24);
-			out[1]  =  (unsigned char) (output >> 16);
-			out[2]  =  (unsigned char) (output >> 8);
+static void encodeblock11( unsigned char *in, unsigned char *out, int len )
+{
+	uint32_t output;
+
+	encodeblock( in, out, len );
+	output = encode20_xml11( (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) (in[2] & 0xF0) << 8 );
+	if( output ) {
+		out[0] = (unsigned char) (output >> 24);
+		out[1] = (unsigned char) (output >> 16);
+		out[2] = (unsigned char) (output >> 8);
+	}
+	if( len > 2 ) { // else out[3-5] is the short termination sequence
+		output = encode20_xml11( (uint32_t) in[2] << 28 | (uint32_t) in[3] << 20 | (uint32_t) in[4] << 12 );
+		if( output ) {
+			out[3] = (unsigned char) (output >> 24);
+			out[4] = (unsigned char) (output >> 16);
+			out[5] = (unsigned char) (output >> 8);
 		}
-		
-	} while (++i != 2);
+	}
+}
 
-	debug_print ("DECODEBLOCK output bytes[0-5]: 0x%x 0x%x 0x%x 0x%x 0x%x\n",   out[0], out[1], out[2], out[3], out[4]);
-	
+static void decodeblock11( unsigned char *in, unsigned char *out )
+{
+	uint32_t output;
+
+	decodeblock( in, out ); // decodes 3-byte characters to 0
+	if( in[0] >= 0xe0 ) {
+		output = decode20_xml11( (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 );
+		out[0] = (unsigned char) (output >> 24);
+		out[1] = (unsigned char) (output >> 16);
+		out[2] = (unsigned char) ((out[2] & 0x0F) | ((output >> 8) & 0xF0));
+	}
+	if( in[3] >= 0xe0 ) {
+		output = decode20_xml11( (uint32_t) in[3] << 24 | (uint32_t) in[4] << 16 | (uint32_t) in[5] << 8 );
+		out[2] = (unsigned char) ((out[2] & 0xF0) | ((output >> 28) & 0x0F));
+		out[3] = (unsigned char) (output >> 20);
+		out[4] = (unsigned char) (output >> 12);
+	}
 }
 
 
 /*
-** encode
+** basexml_crc32c
 **
-** basexml encode a stream
+** CRC32C (Castagnoli) of len bytes, continuing crc (0 to start).
+** Uses the SSE4.2 crc32 instruction when compiled for it (-msse4.2),
+** else a precomputed byte table (read-only: safe from any thread).
 */
-static int encode( FILE *infile, FILE *outfile )
+#ifndef __SSE4_2__
+static const uint32_t crc32c_table[256] = { // CRC32C, reflected polynomial 0x82f63b78
+	0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c, 0x26a1e7e8, 0xd4ca64eb,
+	0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b, 0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24,
+	0x105ec76f, 0xe235446c, 0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+	0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc, 0xbc267848, 0x4e4dfb4b,
+	0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a, 0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35,
+	0xaa64d611, 0x580f5512, 0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+	0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad, 0x1642ae59, 0xe4292d5a,
+	0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a, 0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595,
+	0x417b1dbc, 0xb3109ebf, 0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+	0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f, 0xed03a29b, 0x1f682198,
+	0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927, 0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38,
+	0xdbfc821c, 0x2997011f, 0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+	0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e, 0x4767748a, 0xb50cf789,
+	0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859, 0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46,
+	0x7198540d, 0x83f3d70e, 0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+	0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de, 0xdde0eb2a, 0x2f8b6829,
+	0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c, 0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93,
+	0x082f63b7, 0xfa44e0b4, 0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+	0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b, 0xb4091bff, 0x466298fc,
+	0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c, 0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033,
+	0xa24bb5a6, 0x502036a5, 0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+	0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975, 0x0e330a81, 0xfc588982,
+	0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d, 0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622,
+	0x38cc2a06, 0xcaa7a905, 0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+	0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8, 0xe52cc12c, 0x1747422f,
+	0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff, 0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0,
+	0xd3d3e1ab, 0x21b862a8, 0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+	0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78, 0x7fab5e8c, 0x8dc0dd8f,
+	0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee, 0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1,
+	0x69e9f0d5, 0x9b8273d6, 0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+	0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69, 0xd5cf889d, 0x27a40b9e,
+	0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e, 0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+};
+#endif
+
+uint32_t basexml_crc32c( uint32_t crc, const unsigned char *p, size_t len )
 {
-    unsigned char in[5]  = {0x00, 0x00, 0x00, 0x00, 0x00}; // 5 bytes
-	unsigned char out[9] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}; // map into 6 bytes once encoded (or 9 with a termination sequence)
-    int i, len, blocksout = 0;
-    int retcode = 0;
-	int imax = 6;
-		
-    while( feof( infile ) == 0 ) { // beware, there may be a last try for getc uncasted == EOF <=> feof after getc : so that's handled :)
-        len = 0;
-		
-        for( i = 0; i < 5; i++ ) { // Read file into in[0-4]
-            in[i] = (unsigned char) getc( infile );
+	crc = ~crc;
+#ifdef __SSE4_2__
+#if defined(__x86_64__) || defined(_M_X64)
+	for( ; len >= 8; len -= 8, p += 8 ) {
+		uint64_t v;
+		memcpy( &v, p, 8 );
+		crc = (uint32_t) _mm_crc32_u64( crc, v );
+	}
+#endif
+	for( ; len >= 4; len -= 4, p += 4 ) {
+		uint32_t v;
+		memcpy( &v, p, 4 );
+		crc = _mm_crc32_u32( crc, v );
+	}
+	for( ; len; len--, p++ ) {
+		crc = _mm_crc32_u8( crc, *p );
+	}
+#else
+	for( ; len; len--, p++ ) {
+		crc = crc32c_table[(crc ^ *p) & 0xff] ^ (crc >> 8);
+	}
+#endif
+	return ~crc;
+}
 
-            if( !feof( infile ) ) {
-                len++;
-            }
-            else { // end of file reached
-				in[i] = (unsigned char) 0;
-            }
-        }
-		if(ferror( infile )) { // Unexpected file I/O error
-			perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
-	        retcode = BASEXML_FILE_IO_ERROR;
+
+/*
+** run_length / run_fill
+**
+** Runs of identical blocks (zero-filled disk images, sparse dumps):
+** run_length counts the bytes from p (len of them) that repeat the
+** period (5 or 6) bytes before them, 16 bytes per vector compare.
+** run_fill writes count copies of the size bytes at out after them,
+** 8 copies per round of wide stores.
+*/
+#ifdef __SSE2__
+#define RUN_EQ16(q, period) _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i *) (q) ), _mm_loadu_si128( (const __m128i *) ((q) - (period)) ) )
+#endif
+
+static size_t run_length( const unsigned char *p, size_t len, size_t period )
+{
+	size_t n = 0;
+#ifdef __SSE2__
+	__m128i eq;
+
+	for( ; n + 64 <= len; n += 64 ) { // one branch per 64 bytes
+		eq = _mm_and_si128( _mm_and_si128( RUN_EQ16( p + n, period ), RUN_EQ16( p + n + 16, period ) ),
+		                    _mm_and_si128( RUN_EQ16( p + n + 32, period ), RUN_EQ16( p + n + 48, period ) ) );
+		if( _mm_movemask_epi8( eq ) != 0xffff )
 			break;
-		}
-        if( len > 0 ) {  // Encode 2*20bits (5 bytes) to 2*24bits (6 bytes)
-            encodeblock( in, out, len );
+	}
+	for( ; n + 16 <= len; n += 16 ) {
+		if( _mm_movemask_epi8( RUN_EQ16( p + n, period ) ) != 0xffff )
+			break;
+	}
+#else
+	uint64_t a, b;
 
-			for( i = 0; i < 6; i++ ) { // Put the encoded bytes in the output stream.
-                putc( (int)(out[i]), outfile );
-			}
-			if( out[6] ) { // encodeblock() added a termination sequence with len=3 or len=4
-				putc( (int)(out[6]), outfile );
-				putc( (int)(out[7]), outfile );
-				putc( (int)(out[8]), outfile );
-				break;
-			}
-			
-        } else break; // that's an end of file reached, len=5 or 1 or 2
-    }
-	
-	if( ferror( outfile ) ) { // let's handle that out of the stream loop to improve performance. who cares we can't write?
-		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
-		retcode = BASEXML_FILE_IO_ERROR;
+	for( ; n + 8 <= len; n += 8 ) {
+		memcpy( &a, p + n, 8 );
+		memcpy( &b, p + n - period, 8 );
+		if( a != b )
+			break;
 	}
-	
-    return( retcode );
+#endif
+	while( n < len && p[n] == p[n - period] ) n++;
+	return n;
+}
+
+static inline void run_fill( unsigned char *out, size_t size, size_t count ) // size is a constant once inlined
+{
+	unsigned char pattern[48];
+	unsigned char *dst = out + size;
+	size_t k;
+
+	for( k = 0; k < 8 * size; k++ ) pattern[k] = out[k % size];
+	for( ; count >= 8; count -= 8, dst += 8 * size ) {
+		memcpy( dst, pattern, 8 * size );
+	}
+	memcpy( dst, pattern, count * size );
 }
 
 /*
-** decode
+** same8
 **
-** decode a basexml encoded stream
+** cheap test for the start of a run, on every block: the 8 bytes at p
+** and at p + period are equal
 */
-static int decode( FILE *infile, FILE *outfile )
+static inline int same8( const unsigned char *p, size_t period )
 {
-	int retcode = 0;
-    unsigned char in[6]  = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-	int innext[3]  = {0x00, 0x00, 0x00};
-    unsigned char out[5] = {0x00, 0x00, 0x00, 0x00, 0x00};
-		
-    int v;
-    int i = 0;
-	int len = 5;
+	uint64_t a, b;
 
-	innext[0] = getc( infile );
-	innext[1] = getc( infile );
-	innext[2] = getc( infile );
-
-    while( innext[0] != EOF ) {
-		in[0] = (unsigned char) innext[0];
-		in[1] = (unsigned char) innext[1];
-		in[2] = (unsigned char) innext[2];
-		in[3] = (unsigned char) getc( infile );
-		in[4] = (unsigned char) getc( infile );
-		in[5] = (unsigned char) getc( infile );
-		if(feof( infile )) { // Unexpected end of decoding stream (correctly encoded stream is a multiple of 6 bytes - or 3 with termination)
-			perror( basexml_message( BASEXML_UNEXPECTED_END ) );
-	        retcode = BASEXML_UNEXPECTED_END;
-			break;
-		} else if(ferror( infile )) { // Unexpected file I/O error
-			perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
-	        retcode = BASEXML_FILE_IO_ERROR;
-			break;
+	memcpy( &a, p, 8 );
+	memcpy( &b, p + period, 8 );
+	return a == b;
+}
+
+
+/*
+** basexml_encoder / basexml_decoder
+**
+** Push-style streaming API: feed chunks of any size, whole blocks are
+** written to the caller's output as soon as they are complete.
+** The encoder keeps at most 5 pending input bytes, the decoder at most
+** 6 pending bytes plus the 3 bytes of termination lookahead.
+** Output space needed per call (len = input length of the call):
+**   basexml_encoder_update: BASEXML_ENCODE_UPDATE_MAX(len), finish: 9
+**   basexml_decoder_update: BASEXML_DECODE_UPDATE_MAX(len), finish: 5
+** Set crc_on to 1 after init to get crc, the CRC32C of the raw bytes
+** so far, computed chunk by chunk while they are hot in cache.
+** Errors are returned as BASEXML_* codes, nothing is printed.
+** Set xml11 to 1 after init for BaseXML for XML1.1 (see encodeblock11):
+** the encoder writes the ?X? marker first, the decoder detects it.
+*/
+#define BASEXML_ENCODE_UPDATE_MAX(len) (((len) / 5 + 1) * 6 + 3) // + 3: the ?X? marker
+#define BASEXML_DECODE_UPDATE_MAX(len) (((len) / 6 + 2) * 5)
+
+typedef struct basexml_encoder {
+	unsigned char pending[5];
+	int pending_len;
+	int crc_on;
+	uint32_t crc;             // CRC32C of the input so far, if crc_on
+	int xml11;                // BaseXML for XML1.1
+	int started;              // output written: the ?X? marker is out
+} basexml_encoder;
+
+typedef struct basexml_decoder {
+	unsigned char pending[9]; // group being completed, then its termination lookahead
+	int pending_len;
+	int done;                 // termination sequence (or error) met: further input is ignored
+	int crc_on;
+	uint32_t crc;             // CRC32C of the output so far, if crc_on
+	int xml11;                // BaseXML for XML1.1, also set by the ?X? marker
+	int started;              // the first 3 bytes were checked for the marker
+} basexml_decoder;
+
+void basexml_encoder_init( basexml_encoder *enc )
+{
+	enc->pending_len = 0;
+	enc->crc_on = 0;
+	enc->crc = 0;
+	enc->xml11 = 0;
+	enc->started = 0;
+}
+
+size_t basexml_encoder_update( basexml_encoder *enc, const unsigned char *in, size_t len, unsigned char *out )
+{
+	size_t i = 0, j = 0, run;
+	int n;
+
+	if( enc->crc_on ) {
+		enc->crc = basexml_crc32c( enc->crc, in, len );
+	}
+	if( !enc->started ) {
+		enc->started = 1;
+		if( enc->xml11 ) {
+			memcpy( out, BASEXML_XML11_MARKER, 3 );
+			j = 3;
 		}
-		
-		innext[0] = getc( infile );
-		innext[1] = getc( infile );
-		innext[2] = getc( infile );
-		if( ((innext[0] == 0x3f) && (innext[2] == 0x3f)) ) { // Termination sequence after
-			len = innext[1] & 0x07;
-			debug_print("Termination sequence now (long) (len=%i) 0x%x 0x%x 0x%x\n",len,innext[0],innext[1],innext[2]);
-			if(feof( infile ) || len < 1 || len > 4) { // Termination sequence after without correct length in it: illegal.
-				debug_print("in[] is %c %c %c %c %c %c %c\n",in[0],in[1],in[2],in[3],in[4],in[5]);
-				debug_print("len is %i (0x%x)\n",len,len);
-				debug_print("feof() is %i\n",feof(infile));
-				perror( basexml_message( BASEXML_ILLEGAL_TERMINATION ) );
-				retcode = BASEXML_ILLEGAL_TERMINATION;
-			}
-		} else if( ((in[3] == 0x3f) && (in[5] == 0x3f)) ) {
-			len = in[4] & 0x07;
-			debug_print("Termination sequence now (short) (len=%i) 0x%x 0x%x 0x%x\n",len,in[3],in[4],in[5]);
-			if(len > 5) {
-				perror( basexml_message( BASEXML_ILLEGAL_TERMINATION ) );
-				retcode = BASEXML_ILLEGAL_TERMINATION;
-				}
+	}
+	if( enc->pending_len ) { // complete the pending block first
+		n = 5 - enc->pending_len;
+		if( (size_t) n > len ) n = (int) len;
+		memcpy( enc->pending + enc->pending_len, in, n );
+		enc->pending_len += n;
+		i = n;
+		if( enc->pending_len < 5 )
+			return j;
+		(enc->xml11 ? encodeblock11 : encodeblock)( enc->pending, out + j, 5 );
+		enc->pending_len = 0;
+		j += 6;
+	}
+	for( ; i + 5 <= len; i += 5, j += 6 ) { // whole blocks straight from the input
+		(enc->xml11 ? encodeblock11 : encodeblock)( (unsigned char *) in + i, out + j, 5 );
+		if( i + 13 <= len && same8( in + i, 5 ) ) { // the next blocks repeat this one: copy its 6 bytes
+			run = run_length( in + i + 5, len - i - 5, 5 ) / 5;
+			run_fill( out + j, 6, run );
+			i += run * 5;
+			j += run * 6;
 		}
-		
-		decodeblock( in, out );
-		debug_print ("Saving len = %i characters\n\n", len);
-		for( i = 0; i < len; i++ ) {
-			putc( (int) out[i], outfile );
+	}
+	enc->pending_len = (int) (len - i);
+	memcpy( enc->pending, in + i, enc->pending_len );
+
+	return j;
+}
+
+size_t basexml_encoder_finish( basexml_encoder *enc, unsigned char *out )
+{
+	int len = enc->pending_len;
+
+	if( !enc->started ) { // no input at all
+		enc->started = 1;
+		if( enc->xml11 ) {
+			memcpy( out, BASEXML_XML11_MARKER, 3 );
+			return 3;
 		}
-		if(len != 5)
-			break;
-    }
-	
-	if( ferror( outfile ) ) { // let's handle that out of the stream loop to improve performance
-		
-		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
-		retcode = BASEXML_FILE_IO_ERROR;
 	}
-	
-    return( retcode );
+	enc->pending_len = 0;
+	if( !len )
+		return 0;
+	memset( enc->pending + len, 0, 5 - len );
+	out[6] = 0x00;
+	(enc->xml11 ? encodeblock11 : encodeblock)( enc->pending, out, len ); // adds the termination sequence
+	return out[6] ? 9 : 6;
+}
+
+void basexml_decoder_init( basexml_decoder *dec )
+{
+	dec->pending_len = 0;
+	dec->done = 0;
+	dec->crc_on = 0;
+	dec->crc = 0;
+	dec->xml11 = 0;
+	dec->started = 0;
 }
 
 /*
-** basexml
-**
-** 'engine' that opens streams and calls encode/decode
+** decode one 6-byte group, la[0-2] being the 3 bytes after it (la_len of them exist)
+** returns the number of decoded bytes (5 unless termination), or -1 if illegal
 */
+static int decodegroup( basexml_decoder *dec, const unsigned char *g, const unsigned char *la, int la_len, unsigned char *out )
+{
+	int len = 5;
 
-static int basexml( char opt, char *infilename, char *outfilename )
+	if( la_len >= 3 && la[0] == 0x3f && la[2] == 0x3f ) { // Termination sequence after
+		len = la[1] & 0x07;
+		debug_print("Termination sequence now (long) (len=%i) 0x%x 0x%x 0x%x\n",len,la[0],la[1],la[2]);
+		dec->done = 1;
+	} else if( g[3] == 0x3f && g[5] == 0x3f ) { // Termination sequence inside
+		len = g[4] & 0x07;
+		debug_print("Termination sequence now (short) (len=%i) 0x%x 0x%x 0x%x\n",len,g[3],g[4],g[5]);
+		dec->done = 1;
+	}
+	if( len < 1 || len > 5 || (dec->done && len == 5) ) {
+		dec->done = 1;
+		return -1;
+	}
+	(dec->xml11 ? decodeblock11 : decodeblock)( (unsigned char *) g, out );
+	return len;
+}
+
+int basexml_decoder_update( basexml_decoder *dec, const unsigned char *in, size_t len, unsigned char *out, size_t *out_len )
 {
-    FILE *infile;
-    int retcode = BASEXML_FILE_ERROR;
+	size_t i = 0, run;
+	int n;
 
-    if( !infilename ) {
-        infile = stdin;
-    }
-    else {
-        infile = fopen( infilename, "rb" );
+	*out_len = 0;
+	if( !dec->started ) { // the first 3 bytes: the ?X? marker of BaseXML for XML1.1, or data
+		n = 3 - dec->pending_len;
+		if( (size_t) n > len ) n = (int) len;
+		memcpy( dec->pending + dec->pending_len, in, n );
+		dec->pending_len += n;
+		i = n;
+		if( dec->pending_len < 3 )
+			return 0;
+		dec->started = 1;
+		if( !memcmp( dec->pending, BASEXML_XML11_MARKER, 3 ) ) {
+			dec->xml11 = 1;
+			dec->pending_len = 0;
+		}
+	}
+	// the pending group needs its lookahead: decode it once 9 bytes are known
+	while( dec->pending_len && !dec->done && dec->pending_len + (len - i) >= 9 ) {
+		n = 9 - dec->pending_len;
+		memcpy( dec->pending + dec->pending_len, in + i, n );
+		n = decodegroup( dec, dec->pending, dec->pending + 6, 3, out + *out_len );
+		if( n < 0 ) {
+			return BASEXML_ILLEGAL_TERMINATION;
+		}
+		*out_len += n;
+		if( dec->pending_len > 6 ) { // some of the lookahead was pending too
+			memmove( dec->pending, dec->pending + 6, dec->pending_len - 6 );
+			dec->pending_len -= 6;
+		} else {
+			i += 6 - dec->pending_len;
+			dec->pending_len = 0;
+		}
+	}
+	// groups straight from the input
+	while( !dec->pending_len && !dec->done && i + 9 <= len ) {
+		n = decodegroup( dec, in + i, in + i + 6, 3, out + *out_len );
+		if( n < 0 ) {
+			return BASEXML_ILLEGAL_TERMINATION;
+		}
+		if( n == 5 && i + 14 <= len && same8( in + i, 6 ) ) {
+			// the next groups repeat this one: copy its 5 bytes for those whose lookahead
+			// is in the run too, the last one is decoded (and checked for termination) as usual
+			run = run_length( in + i + 6, len - i - 6, 6 );
+			run = run >= 3 ? (run - 3) / 6 : 0;
+			run_fill( out + *out_len, 5, run );
+			*out_len += run * 5;
+			i += run * 6;
+		}
+		*out_len += n;
+		i += 6;
+	}
+	if( !dec->done ) { // less than 9 bytes left
+		memcpy( dec->pending + dec->pending_len, in + i, len - i );
+		dec->pending_len += (int) (len - i);
+	}
+	if( dec->crc_on ) {
+		dec->crc = basexml_crc32c( dec->crc, out, *out_len );
+	}
+
+	return 0;
+}
+
+int basexml_decoder_finish( basexml_decoder *dec, unsigned char *out, size_t *out_len )
+{
+	int n;
+
+	*out_len = 0;
+	if( dec->done || !dec->pending_len ) {
+		dec->pending_len = 0;
+		return 0;
+	}
+	if( dec->pending_len != 6 ) { // a correctly encoded stream is a multiple of 6 bytes, or 3 with termination
+		dec->pending_len = 0;
+		return BASEXML_UNEXPECTED_END;
+	}
+	dec->pending_len = 0;
+	n = decodegroup( dec, dec->pending, NULL, 0, out );
+	if( n < 0 ) {
+		return BASEXML_ILLEGAL_TERMINATION;
+	}
+	*out_len = n;
+	if( dec->crc_on ) {
+		dec->crc = basexml_crc32c( dec->crc, out, *out_len );
+	}
+	return 0;
+}
+
+
+/*
+** Container markers
+**
+** Framed, compressed and escaped data (see their sections below) start
+** with a marker that is never the start of plain BaseXML data.
+*/
+#define BASEXML_FRAMED_MARKER     "?F?"
+#define BASEXML_COMPRESSED_MARKER "?Z?"
+#define BASEXML_ESCAPED_MARKER    "?E?"
+
+/*
+** plain_start
+**
+** where the groups of encoded data start: after the ?X? marker of
+** BaseXML for XML1.1 (*xml11 is then set), else at 0. Containers are
+** BASEXML_CONTAINER: their bytes aren't groups at fixed offsets of the
+** decoded data, they can only be decoded whole.
+*/
+static int plain_start( const unsigned char *enc, size_t enc_len, size_t *start, int *xml11 )
+{
+	*xml11 = enc_len >= 3 && !memcmp( enc, BASEXML_XML11_MARKER, 3 );
+	*start = *xml11 ? 3 : 0;
+	if( enc_len >= 3 && (!memcmp( enc, BASEXML_FRAMED_MARKER, 3 ) || !memcmp( enc, BASEXML_COMPRESSED_MARKER, 3 ) ||
+	                     !memcmp( enc, BASEXML_ESCAPED_MARKER, 3 )) ) {
+		return BASEXML_CONTAINER;
+	}
+	return 0;
+}
+
+
+/*
+** basexml_decoded_size
+**
+** Decoded size of well-formed encoded data, known from its length and
+** its last 3 bytes: a termination sequence 0x3f 0x3X 0x3f comes after
+** the last 6 bytes when 3 or 4 bytes are left, inside them when 1 or 2.
+** end points just past the last encoded byte. basexml_decoded_size
+** takes data starting with the ?X? marker too.
+*/
+static int decoded_size_end( const unsigned char *end, size_t enc_len, size_t *size )
+{
+	int len;
+
+	if( enc_len % 6 == 0 && (enc_len == 0 || end[-3] != 0x3f || end[-1] != 0x3f) ) { // whole blocks only
+		*size = enc_len / 6 * 5;
+		return 0;
+	}
+	if( enc_len % 6 == 3 && (enc_len < 9 || end[-3] != 0x3f || end[-1] != 0x3f) ) {
+		return enc_len < 9 ? BASEXML_UNEXPECTED_END : BASEXML_ILLEGAL_TERMINATION;
+	}
+	if( enc_len % 6 != 0 && enc_len % 6 != 3 ) {
+		return BASEXML_UNEXPECTED_END;
+	}
+	len = end[-2] & 0x07;
+	if( len < 1 || len > 4 ) {
+		return BASEXML_ILLEGAL_TERMINATION;
+	}
+	*size = enc_len / 6 * 5 - 5 + len;
+	return 0;
+}
+
+int basexml_decoded_size( const unsigned char *enc, size_t enc_len, size_t *size )
+{
+	size_t start;
+	int xml11, retcode = plain_start( enc, enc_len, &start, &xml11 );
+
+	return retcode ? retcode : decoded_size_end( enc + enc_len, enc_len - start, size );
+}
+
+/*
+** decode_span
+**
+** decode bytes [skip, skip+length) of the blocks starting at groups
+** (skip < 5), only touching the 6-byte groups covering them
+*/
+static void decode_span( const unsigned char *groups, size_t skip, size_t length, unsigned char *out, int xml11 )
+{
+	void (*decode)( unsigned char *, unsigned char * ) = xml11 ? decodeblock11 : decodeblock;
+	unsigned char block[5];
+	size_t n;
+
+	if( skip ) { // first block only partly wanted
+		decode( (unsigned char *) groups, block );
+		n = 5 - skip < length ? 5 - skip : length;
+		memcpy( out, block + skip, n );
+		groups += 6;
+		out += n;
+		length -= n;
+	}
+	for( ; length >= 5; length -= 5, groups += 6, out += 5 ) {
+		decode( (unsigned char *) groups, out );
+	}
+	if( length ) { // last block only partly wanted (or the final partial one)
+		decode( (unsigned char *) groups, block );
+		memcpy( out, block, length );
+	}
+}
+
+/*
+** basexml_decode_range
+**
+** Random access: decode bytes [offset, offset+length) of encoded data
+** into out (length bytes). Decoded byte N lives in the 6-byte group
+** starting at N / 5 * 6 (after the ?X? marker, if any), so the cost
+** only depends on length.
+*/
+int basexml_decode_range( const unsigned char *enc, size_t enc_len, size_t offset, size_t length, unsigned char *out )
+{
+	size_t size, start;
+	int xml11, retcode = plain_start( enc, enc_len, &start, &xml11 );
+
+	if( !retcode ) {
+		retcode = decoded_size_end( enc + enc_len, enc_len - start, &size );
+	}
+	if( !retcode && (offset > size || length > size - offset) ) {
+		retcode = BASEXML_OUT_OF_RANGE;
+	}
+	if( retcode ) {
+		return retcode;
+	}
+	if( length ) {
+		decode_span( enc + start + offset / 5 * 6, offset % 5, length, out, xml11 );
+	}
+	return 0;
+}
+
+
+/*
+** patch_span
+**
+** overwrite decoded bytes [skip, skip+len) of the blocks starting at
+** groups (skip < 5) and re-encode those blocks in place. last_len is the
+** decoded length of the last block touched: 1 to 4 if it is the final
+** partial one (its termination sequence is rewritten as is), else 5.
+*/
+static void patch_span( unsigned char *groups, size_t skip, const unsigned char *data, size_t len, int last_len, int xml11 )
+{
+	unsigned char block[5];
+	size_t n;
+	int block_len;
+
+	while( len ) {
+		n = 5 - skip < len ? 5 - skip : len;
+		block_len = n == len ? last_len : 5;
+		if( skip || n < (size_t) block_len ) { // keep the bytes around the patch
+			(xml11 ? decodeblock11 : decodeblock)( groups, block );
+		}
+		memcpy( block + skip, data, n );
+		memset( block + block_len, 0, 5 - block_len ); // padding, as when encoding
+		(xml11 ? encodeblock11 : encodeblock)( block, groups, block_len );
+		groups += 6;
+		data += n;
+		len -= n;
+		skip = 0;
+	}
+}
+
+/*
+** patch_last_len
+**
+** decoded length of the block holding the last patched byte
+*/
+static int patch_last_len( size_t size, size_t offset, size_t len )
+{
+	return size % 5 && (offset + len - 1) / 5 == size / 5 ? (int) (size % 5) : 5;
+}
+
+/*
+** basexml_patch
+**
+** Overwrite decoded bytes [offset, offset+len) of encoded data with data,
+** in place: only the 6-byte groups covering them are rewritten, the
+** encoded length never changes (see basexml_append to grow the data).
+** enc may be an encoded element inside a larger document. After the
+** ?X? marker, the blocks are re-encoded as BaseXML for XML1.1.
+*/
+int basexml_patch( unsigned char *enc, size_t enc_len, size_t offset, const unsigned char *data, size_t len )
+{
+	size_t size, start;
+	int xml11, retcode = plain_start( enc, enc_len, &start, &xml11 );
+
+	if( !retcode ) {
+		retcode = decoded_size_end( enc + enc_len, enc_len - start, &size );
+	}
+	if( !retcode && (offset > size || len > size - offset) ) {
+		retcode = BASEXML_OUT_OF_RANGE;
+	}
+	if( retcode ) {
+		return retcode;
+	}
+	if( len ) {
+		patch_span( enc + start + offset / 5 * 6, offset % 5, data, len, patch_last_len( size, offset, len ), xml11 );
+	}
+	return 0;
+}
+
+
+/*
+** basexml_decode_inplace
+**
+** Decode buf (len encoded bytes) over itself, no second buffer: the
+** decoded data ends up in the first *out_len bytes of buf. A scalar
+** loop, one block at a time from front to back: group i is copied out
+** of 6*i (3+6*i after the ?X? marker) before block i is written to
+** 5*i, which stays behind every group not read yet. There is no vector
+** path here.
+*/
+int basexml_decode_inplace( unsigned char *buf, size_t len, size_t *out_len )
+{
+	unsigned char group[6];
+	size_t size, start, i, blocks;
+	int xml11, retcode = plain_start( buf, len, &start, &xml11 );
+
+	if( !retcode ) {
+		retcode = decoded_size_end( buf + len, len - start, &size );
+	}
+	if( retcode ) {
+		return retcode;
+	}
+	blocks = ( size + 4 ) / 5; // the final partial block is written whole, the bytes after size are dropped
+	for( i = 0; i < blocks; i++ ) {
+		memcpy( group, buf + start + i * 6, 6 ); // read before write
+		(xml11 ? decodeblock11 : decodeblock)( group, buf + i * 5 );
+	}
+	*out_len = size;
+	return 0;
+}
+
+
+/*
+** basexml_encode_small / basexml_decode_small
+**
+** One-shot encoding/decoding for short messages (IDs, tokens, hashes):
+** up to BASEXML_SMALL_MAX bytes, a switch on the number of 20-bit groups
+** falls into straight-line code, with no loop, no floating point and no
+** allocation. Longer data goes through the block loop first, so any
+** length works. out gets BASEXML_ENCODED_SIZE(len) bytes (encode) or the
+** decoded size (decode, which also works in place, in == out).
+*/
+#define BASEXML_SMALL_MAX 64
+
+static inline void encode_small_group( const unsigned char *in, unsigned char *out, int k ) // 20-bit group k, a constant once inlined
+{
+	const unsigned char *p = in + k / 2 * 5;
+	uint32_t output = encode20( k % 2 ? (uint32_t) p[2] << 28 | (uint32_t) p[3] << 20 | (uint32_t) p[4] << 12
+	                                  : (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) (p[2] & 0xF0) << 8 );
+
+	out[k * 3]     = (unsigned char) (output >> 24);
+	out[k * 3 + 1] = (unsigned char) (output >> 16);
+	out[k * 3 + 2] = (unsigned char) (output >> 8);
+}
+
+static inline void decode_small_group( const unsigned char *in, unsigned char *out, int k )
+{
+	const unsigned char *g = in + k * 3;
+	unsigned char *p = out + k / 2 * 5;
+	uint32_t output = decode20( (uint32_t) g[0] << 24 | (uint32_t) g[1] << 16 | (uint32_t) g[2] << 8 );
+
+	if( k % 2 ) { // groups are decoded last to first: each one adds its half of p[2]
+		p[2] |= (unsigned char) ((output >> 28) & 0x0F);
+		p[3] = (unsigned char) (output >> 20);
+		p[4] = (unsigned char) (output >> 12);
+	} else {
+		p[0] = (unsigned char) (output >> 24);
+		p[1] = (unsigned char) (output >> 16);
+		p[2] |= (unsigned char) ((output >> 8) & 0xF0);
+	}
+}
+
+size_t basexml_encode_small( const unsigned char *in, size_t len, unsigned char *out )
+{
+	unsigned char pad[BASEXML_SMALL_MAX + 5];
+	size_t done = 0, groups;
+
+	for( ; len > BASEXML_SMALL_MAX; len -= 5, in += 5, out += 6, done += 6 ) {
+		encodeblock( (unsigned char *) in, out, 5 );
+	}
+	memcpy( pad, in, len );
+	memset( pad + len, 0, 5 ); // the last group is zero-padded, as by basexml_encoder_finish
+	groups = (len * 2 + 4) / 5;
+	switch( groups ) { // each case falls through, last group first
+		case 26: encode_small_group( pad, out, 25 ); /* fall through */
+		case 25: encode_small_group( pad, out, 24 ); /* fall through */
+		case 24: encode_small_group( pad, out, 23 ); /* fall through */
+		case 23: encode_small_group( pad, out, 22 ); /* fall through */
+		case 22: encode_small_group( pad, out, 21 ); /* fall through */
+		case 21: encode_small_group( pad, out, 20 ); /* fall through */
+		case 20: encode_small_group( pad, out, 19 ); /* fall through */
+		case 19: encode_small_group( pad, out, 18 ); /* fall through */
+		case 18: encode_small_group( pad, out, 17 ); /* fall through */
+		case 17: encode_small_group( pad, out, 16 ); /* fall through */
+		case 16: encode_small_group( pad, out, 15 ); /* fall through */
+		case 15: encode_small_group( pad, out, 14 ); /* fall through */
+		case 14: encode_small_group( pad, out, 13 ); /* fall through */
+		case 13: encode_small_group( pad, out, 12 ); /* fall through */
+		case 12: encode_small_group( pad, out, 11 ); /* fall through */
+		case 11: encode_small_group( pad, out, 10 ); /* fall through */
+		case 10: encode_small_group( pad, out, 9 ); /* fall through */
+		case 9: encode_small_group( pad, out, 8 ); /* fall through */
+		case 8: encode_small_group( pad, out, 7 ); /* fall through */
+		case 7: encode_small_group( pad, out, 6 ); /* fall through */
+		case 6: encode_small_group( pad, out, 5 ); /* fall through */
+		case 5: encode_small_group( pad, out, 4 ); /* fall through */
+		case 4: encode_small_group( pad, out, 3 ); /* fall through */
+		case 3: encode_small_group( pad, out, 2 ); /* fall through */
+		case 2: encode_small_group( pad, out, 1 ); /* fall through */
+		case 1: encode_small_group( pad, out, 0 );
+	}
+	if( len % 5 ) { // termination sequence: inside the last 6 bytes (1-2 bytes left) or after them (3-4)
+		out[groups * 3]     = 0x3f;
+		out[groups * 3 + 1] = (unsigned char) (0x30 | len % 5);
+		out[groups * 3 + 2] = 0x3f;
+		groups++;
+	}
+	return done + groups * 3;
+}
+
+int basexml_decode_small( const unsigned char *in, size_t len, unsigned char *out, size_t *out_len )
+{
+	unsigned char block[BASEXML_SMALL_MAX + 5] = { 0 };
+	size_t size, groups;
+	int retcode = decoded_size_end( in + len, len, &size );
+
+	if( retcode ) {
+		return retcode;
+	}
+	*out_len = size;
+	for( ; size > BASEXML_SMALL_MAX; size -= 5, in += 6, out += 5 ) { // in place too: each half is read before written
+		decodeblock( (unsigned char *) in, out );
+	}
+	groups = (size * 2 + 4) / 5;
+	switch( groups ) { // each case falls through, last group first
+		case 26: decode_small_group( in, block, 25 ); /* fall through */
+		case 25: decode_small_group( in, block, 24 ); /* fall through */
+		case 24: decode_small_group( in, block, 23 ); /* fall through */
+		case 23: decode_small_group( in, block, 22 ); /* fall through */
+		case 22: decode_small_group( in, block, 21 ); /* fall through */
+		case 21: decode_small_group( in, block, 20 ); /* fall through */
+		case 20: decode_small_group( in, block, 19 ); /* fall through */
+		case 19: decode_small_group( in, block, 18 ); /* fall through */
+		case 18: decode_small_group( in, block, 17 ); /* fall through */
+		case 17: decode_small_group( in, block, 16 ); /* fall through */
+		case 16: decode_small_group( in, block, 15 ); /* fall through */
+		case 15: decode_small_group( in, block, 14 ); /* fall through */
+		case 14: decode_small_group( in, block, 13 ); /* fall through */
+		case 13: decode_small_group( in, block, 12 ); /* fall through */
+		case 12: decode_small_group( in, block, 11 ); /* fall through */
+		case 11: decode_small_group( in, block, 10 ); /* fall through */
+		case 10: decode_small_group( in, block, 9 ); /* fall through */
+		case 9: decode_small_group( in, block, 8 ); /* fall through */
+		case 8: decode_small_group( in, block, 7 ); /* fall through */
+		case 7: decode_small_group( in, block, 6 ); /* fall through */
+		case 6: decode_small_group( in, block, 5 ); /* fall through */
+		case 5: decode_small_group( in, block, 4 ); /* fall through */
+		case 4: decode_small_group( in, block, 3 ); /* fall through */
+		case 3: decode_small_group( in, block, 2 ); /* fall through */
+		case 2: decode_small_group( in, block, 1 ); /* fall through */
+		case 1: decode_small_group( in, block, 0 );
+	}
+	memcpy( out, block, size ); // every group was read: safe in place
+	return 0;
+}
+
+
+/*
+** validgroup
+**
+** check one 3-byte group: none of the bytes the encoder never writes
+** (\0 \r \n < > &, and the other control chars but TAB), and once TAB
+** is swapped back to &, one of the nine case patterns of decodeblock
+*/
+static int validbytes( const unsigned char *g )
+{
+	int k;
+
+	for( k = 0; k < 3; k++ ) {
+		if( (g[k] < 0x20 && g[k] != 0x09) || g[k] == '<' || g[k] == '>' || g[k] == '&' )
+			return 0;
+	}
+	return 1;
+}
+
+static int validpattern( const unsigned char *g )
+{
+	uint32_t in = (uint32_t) (g[0] == 0x09 ? 0x26 : g[0]) << 24 |
+	              (uint32_t) (g[1] == 0x09 ? 0x26 : g[1]) << 16 |
+	              (uint32_t) (g[2] == 0x09 ? 0x26 : g[2]) << 8;
+
+	return ( in & 0xfcc0f000 ) == 0x38404000 || // I3
+	       ( in & 0xfcc0c000 ) == 0x30404000 || // I1
+	       ( in & 0xfcc0c000 ) == 0x34404000 || // I2
+	       ( in & 0xc0808000 ) == 0x40000000 || // E1
+	       ( in & 0xf0f0c000 ) == 0x20204000 || // E5
+	       ( in & 0xf0c0f000 ) == 0x20402000 || // E6
+	       ( in & 0xf0c0c000 ) == 0x20404000 || // E2
+	       ( in & 0x80e0c000 ) == 0x00c08000 || // E3
+	       ( in & 0xe0c08000 ) == 0xc0800000;   // E4
+}
+
+/*
+** validpattern11
+**
+** the same for BaseXML for XML1.1: a 3-byte character must be the one
+** encodeblock11 writes for the bits it decodes to, other groups must
+** not be one of the sequences it replaces
+*/
+static int validpattern11( const unsigned char *g )
+{
+	uint32_t in = (uint32_t) g[0] << 24 | (uint32_t) g[1] << 16 | (uint32_t) g[2] << 8;
+
+	if( g[0] >= 0xe0 )
+		return encode20_xml11( decode20_xml11( in ) ) == in;
+	return validpattern( g ) && !encode20_xml11( decode20( in ) );
+}
+
+#ifdef __SSE2__
+/*
+** badbytes16
+**
+** nonzero if any of 16 bytes can't be in encoded data
+*/
+static int badbytes16( const unsigned char *p )
+{
+	__m128i v = _mm_loadu_si128( (const __m128i *) p );
+	__m128i bad = _mm_andnot_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( 0x09 ) ), // v < 0x20, unsigned
+		_mm_cmplt_epi8( _mm_xor_si128( v, _mm_set1_epi8( (char) 0x80 ) ), _mm_set1_epi8( (char) 0xa0 ) ) );
+
+	bad = _mm_or_si128( bad, _mm_cmpeq_epi8( v, _mm_set1_epi8( '<' ) ) );
+	bad = _mm_or_si128( bad, _mm_cmpeq_epi8( v, _mm_set1_epi8( '>' ) ) );
+	bad = _mm_or_si128( bad, _mm_cmpeq_epi8( v, _mm_set1_epi8( '&' ) ) );
+	return _mm_movemask_epi8( bad );
+}
+#endif
+
+/*
+** validate_groups
+**
+** offset of the first bad 3-byte group of p (len multiple of 3), or len
+*/
+static size_t validate_groups( const unsigned char *p, size_t len, int xml11 )
+{
+	int (*pattern)( const unsigned char * ) = xml11 ? validpattern11 : validpattern;
+	size_t i = 0, k;
+
+#ifdef __SSE2__
+	for( ; i + 48 <= len; i += 48 ) { // 16 groups: bytes checked 16 at a time
+		int bytes_ok = !(badbytes16( p + i ) | badbytes16( p + i + 16 ) | badbytes16( p + i + 32 ));
+		for( k = i; k < i + 48; k += 3 ) {
+			if( (!bytes_ok && !validbytes( p + k )) || !pattern( p + k ) )
+				return k;
+		}
+	}
+#endif
+	for( k = i; k < len; k += 3 ) {
+		if( !validbytes( p + k ) || !pattern( p + k ) )
+			return k;
+	}
+	return len;
+}
+
+/*
+** validate_tail
+**
+** check the end of encoded data (end points just past its last byte):
+** a termination sequence 0x3f 0x3X 0x3f must hold 1 or 2 inside the
+** last 6 bytes, 3 or 4 after them, else the data is whole 6-byte groups.
+** *data_len is the length of the groups before the termination sequence.
+*/
+static int validate_tail( const unsigned char *end, size_t enc_len, size_t *data_len )
+{
+	if( enc_len % 3 == 0 && enc_len >= 3 && end[-3] == 0x3f && end[-1] == 0x3f ) {
+		*data_len = enc_len - 3;
+		if( enc_len % 6 == 0 ? (end[-2] == 0x31 || end[-2] == 0x32) : (enc_len >= 9 && (end[-2] == 0x33 || end[-2] == 0x34)) )
+			return 0;
+		return BASEXML_ILLEGAL_TERMINATION;
+	}
+	*data_len = enc_len / 6 * 6;
+	return *data_len == enc_len ? 0 : BASEXML_UNEXPECTED_END;
+}
+
+/*
+** basexml_validate
+**
+** Check encoded data without decoding it nor writing anything: every
+** group, the bytes it is made of, and the termination sequence. Data
+** starting with the ?X? marker is checked as BaseXML for XML1.1.
+** Returns 0 if valid, else BASEXML_UNDECODABLE_GROUP (*bad_offset is
+** the offset of the group), BASEXML_ILLEGAL_TERMINATION or
+** BASEXML_UNEXPECTED_END (*bad_offset is where the end goes wrong).
+*/
+int basexml_validate( const unsigned char *enc, size_t enc_len, size_t *bad_offset )
+{
+	int xml11 = enc_len >= 3 && !memcmp( enc, BASEXML_XML11_MARKER, 3 );
+	size_t start = xml11 ? 3 : 0, data_len;
+	int retcode = validate_tail( enc + enc_len, enc_len - start, &data_len );
+
+	*bad_offset = start + validate_groups( enc + start, data_len, xml11 );
+	if( *bad_offset < start + data_len ) {
+		return BASEXML_UNDECODABLE_GROUP;
+	}
+	return retcode;
+}
+
+
+/*
+** basexml_encoder_resume
+**
+** Start an encoder continuing existing encoded data, without re-encoding
+** it: the final partial block (1 to 4 bytes, decoded from the last 9
+** encoded bytes at most) becomes the encoder's pending input. Only the
+** first *keep_len encoded bytes are kept, the encoder's output goes
+** right after them. Data starting with the ?X? marker goes on as
+** BaseXML for XML1.1.
+*/
+int basexml_encoder_resume( basexml_encoder *enc, const unsigned char *data, size_t enc_len, size_t *keep_len )
+{
+	size_t size, start;
+	int xml11, retcode = plain_start( data, enc_len, &start, &xml11 );
+
+	if( !retcode ) {
+		retcode = decoded_size_end( data + enc_len, enc_len - start, &size );
+	}
+	if( retcode ) {
+		return retcode;
+	}
+	basexml_encoder_init( enc );
+	enc->xml11 = xml11;
+	enc->started = 1; // the marker, if any, is already out
+	*keep_len = start + size / 5 * 6;
+	enc->pending_len = (int) (size % 5);
+	if( enc->pending_len ) {
+		(xml11 ? decodeblock11 : decodeblock)( (unsigned char *) data + *keep_len, enc->pending );
+	}
+	return 0;
+}
+
+/*
+** basexml_append
+**
+** Append len bytes of data to encoded data (enc_len bytes, in a buffer
+** of at least BASEXML_APPEND_MAX(enc_len, len) bytes), in place.
+** Costs O(len): only the final partial block is decoded and re-encoded.
+*/
+#define BASEXML_APPEND_MAX(enc_len, len) ((enc_len) + BASEXML_ENCODE_UPDATE_MAX(len) + 9)
+
+int basexml_append( unsigned char *enc, size_t enc_len, const unsigned char *data, size_t len, size_t *new_len )
+{
+	basexml_encoder encoder;
+	size_t keep_len;
+	int retcode = basexml_encoder_resume( &encoder, enc, enc_len, &keep_len );
+
+	if( retcode ) {
+		return retcode;
+	}
+	*new_len = keep_len;
+	*new_len += basexml_encoder_update( &encoder, data, len, enc + *new_len );
+	*new_len += basexml_encoder_finish( &encoder, enc + *new_len );
+	return 0;
+}
+
+
+/*
+** Framed format
+**
+** For parallel decoding, checking in pieces and random access, the data
+** can be cut into frames encoded on their own:
+**   ?F?       marker (0x3f .. 0x3f never starts plain BaseXML data)
+**   header    15 bytes encoded as 18: version, flags, frame size
+**             (32 bits), total size (64 bits), reserved, little endian
+**   frames    frame k holds the raw bytes [k*frame_size, (k+1)*frame_size)
+**             frame_size is a multiple of 5: frames are whole blocks,
+**             frame k starts at 21 + k*frame_size/5*6 and only the
+**             last one ends with a termination sequence
+**   index     CRC32C of each frame (32 bits, little endian), encoded
+**             on its own, right after the frames
+** The total size being in the header, the decoded size is known from
+** the first 21 bytes, and the index offset too.
+*/
+#define BASEXML_FRAMED_VERSION     1
+#define BASEXML_FRAMED_HEADER      21      // marker + encoded header
+#define BASEXML_FRAME_SIZE_DEFAULT 1048575 // 1MB, multiple of 5
+#define BASEXML_FRAMED_MAX_SIZE    (UINT64_MAX / 8) // larger total sizes would overflow the encoded offsets
+
+#define BASEXML_ENCODED_SIZE(len) ((len) / 5 * 6 + ((len) % 5 == 0 ? 0 : (len) % 5 <= 2 ? 6 : 9))
+
+typedef struct basexml_frame_info {
+	uint32_t frame_size;
+	uint64_t total_size;   // decoded size
+	uint64_t frame_count;
+	uint64_t index_offset; // of the encoded CRC32C index
+} basexml_frame_info;
+
+/*
+** basexml_framed_size
+**
+** exact encoded size of len bytes in frames of frame_size bytes
+*/
+uint64_t basexml_framed_size( uint64_t len, uint32_t frame_size )
+{
+	uint64_t frames = (len + frame_size - 1) / frame_size;
+
+	return BASEXML_FRAMED_HEADER + BASEXML_ENCODED_SIZE( len ) + BASEXML_ENCODED_SIZE( frames * 4 );
+}
+
+/*
+** framed_header
+**
+** write the marker and the encoded header (BASEXML_FRAMED_HEADER bytes)
+*/
+static void framed_header( unsigned char *out, uint32_t frame_size, uint64_t total_size )
+{
+	unsigned char raw[15];
+	basexml_encoder enc;
+	int k;
+
+	raw[0] = BASEXML_FRAMED_VERSION;
+	raw[1] = 0; // flags
+	for( k = 0; k < 4; k++ ) raw[2 + k] = (unsigned char) (frame_size >> (8 * k));
+	for( k = 0; k < 8; k++ ) raw[6 + k] = (unsigned char) (total_size >> (8 * k));
+	raw[14] = 0;
+	memcpy( out, BASEXML_FRAMED_MARKER, 3 );
+	basexml_encoder_init( &enc );
+	basexml_encoder_update( &enc, raw, 15, out + 3 ); // 3 whole blocks: no termination
+}
+
+/*
+** basexml_framed_info
+**
+** Parse the first BASEXML_FRAMED_HEADER bytes of framed data (len of them
+** available). Returns BASEXML_BAD_FRAMING if it isn't framed data, if
+** its total size is too large to be encoded, or if more than the header
+** is given and len isn't the encoded size of the whole data.
+*/
+int basexml_framed_info( const unsigned char *enc, size_t len, basexml_frame_info *info )
+{
+	unsigned char raw[15];
+	int k;
+
+	if( len < BASEXML_FRAMED_HEADER || memcmp( enc, BASEXML_FRAMED_MARKER, 3 ) != 0 ) {
+		return BASEXML_BAD_FRAMING;
+	}
+	decode_span( enc + 3, 0, 15, raw, 0 );
+	info->frame_size = 0;
+	info->total_size = 0;
+	for( k = 3; k >= 0; k-- ) info->frame_size = info->frame_size << 8 | raw[2 + k];
+	for( k = 7; k >= 0; k-- ) info->total_size = info->total_size << 8 | raw[6 + k];
+	if( raw[0] != BASEXML_FRAMED_VERSION || !info->frame_size || info->frame_size % 5 ||
+		info->total_size > BASEXML_FRAMED_MAX_SIZE ) {
+		return BASEXML_BAD_FRAMING;
+	}
+	info->frame_count = (info->total_size + info->frame_size - 1) / info->frame_size;
+	info->index_offset = BASEXML_FRAMED_HEADER + BASEXML_ENCODED_SIZE( info->total_size );
+	if( len > BASEXML_FRAMED_HEADER && info->index_offset + BASEXML_ENCODED_SIZE( info->frame_count * 4 ) != len ) {
+		return BASEXML_BAD_FRAMING;
+	}
+	return 0;
+}
+
+/*
+** frame_span
+**
+** encoded offset and raw length of frame k
+*/
+static uint64_t frame_offset( const basexml_frame_info *info, uint64_t k )
+{
+	return BASEXML_FRAMED_HEADER + k * (info->frame_size / 5 * 6);
+}
+
+static size_t frame_len( const basexml_frame_info *info, uint64_t k )
+{
+	uint64_t rest = info->total_size - k * info->frame_size;
+
+	return (size_t) (rest < info->frame_size ? rest : info->frame_size);
+}
+
+/*
+** decode_frame
+**
+** decode one encoded frame of len raw bytes, and compute its CRC32C
+*/
+static int decode_frame( const unsigned char *enc, size_t len, unsigned char *out, uint32_t *crc )
+{
+	size_t size;
+
+	if( decoded_size_end( enc + BASEXML_ENCODED_SIZE( len ), BASEXML_ENCODED_SIZE( len ), &size ) || size != len ) {
+		return BASEXML_BAD_FRAMING;
+	}
+	decode_span( enc, 0, len, out, 0 );
+	*crc = basexml_crc32c( 0, out, len );
+	return 0;
+}
+
+/*
+** basexml_encode_framed
+**
+** Encode len bytes in frames of frame_size bytes (a multiple of 5).
+** out must hold basexml_framed_size( len, frame_size ) bytes.
+*/
+int basexml_encode_framed( const unsigned char *in, size_t len, uint32_t frame_size, unsigned char *out, size_t *out_len )
+{
+	basexml_encoder enc, index;
+	unsigned char crc[4];
+	size_t pos, n, j = BASEXML_FRAMED_HEADER, index_len;
+	uint32_t c;
+	int k;
+
+	if( !frame_size || frame_size % 5 ) {
+		return BASEXML_BAD_FRAMING;
+	}
+	framed_header( out, frame_size, len );
+	index_len = BASEXML_FRAMED_HEADER + BASEXML_ENCODED_SIZE( len ); // the index goes right after the frames
+	basexml_encoder_init( &index );
+	for( pos = 0; pos < len; pos += n ) {
+		n = len - pos < frame_size ? len - pos : frame_size;
+		basexml_encoder_init( &enc );
+		j += basexml_encoder_update( &enc, in + pos, n, out + j );
+		j += basexml_encoder_finish( &enc, out + j );
+		c = basexml_crc32c( 0, in + pos, n );
+		for( k = 0; k < 4; k++ ) crc[k] = (unsigned char) (c >> (8 * k));
+		index_len += basexml_encoder_update( &index, crc, 4, out + index_len );
+	}
+	index_len += basexml_encoder_finish( &index, out + index_len );
+	*out_len = index_len;
+	return 0;
+}
+
+/*
+** basexml_decode_frame
+**
+** Random access: decode frame k of framed data (enc_len bytes, header
+** parsed in info) into out, which must hold info->frame_size bytes, and
+** check its CRC32C. *out_len is its raw length.
+*/
+int basexml_decode_frame( const unsigned char *enc, size_t enc_len, const basexml_frame_info *info, uint64_t k, unsigned char *out, size_t *out_len )
+{
+	unsigned char crc[4];
+	uint32_t c;
+	int retcode = 0;
+
+	if( k >= info->frame_count ) {
+		retcode = BASEXML_OUT_OF_RANGE;
+	} else if( info->index_offset + BASEXML_ENCODED_SIZE( info->frame_count * 4 ) > enc_len ) {
+		retcode = BASEXML_BAD_FRAMING;
+	}
+	if( !retcode ) {
+		decode_span( enc + info->index_offset + k * 4 / 5 * 6, k * 4 % 5, 4, crc, 0 ); // 4 bytes of the index, found as a range
+		*out_len = frame_len( info, k );
+		retcode = decode_frame( enc + frame_offset( info, k ), *out_len, out, &c );
+	}
+	if( !retcode && c != ((uint32_t) crc[0] | (uint32_t) crc[1] << 8 | (uint32_t) crc[2] << 16 | (uint32_t) crc[3] << 24) ) {
+		retcode = BASEXML_CRC_MISMATCH;
+	}
+	return retcode;
+}
+
+/*
+** basexml_decode_framed
+**
+** Decode all the frames of framed data into out, which must hold the
+** total size of the header (basexml_framed_info), and check each of them.
+*/
+int basexml_decode_framed( const unsigned char *enc, size_t enc_len, unsigned char *out, size_t *out_len )
+{
+	basexml_frame_info info;
+	uint64_t k;
+	size_t n;
+	int retcode = basexml_framed_info( enc, enc_len, &info );
+
+	if( retcode ) {
+		return retcode;
+	}
+	*out_len = 0;
+	for( k = 0; k < info.frame_count && !retcode; k++ ) { // frames are independent: this loop could be split between threads
+		retcode = basexml_decode_frame( enc, enc_len, &info, k, out + *out_len, &n );
+		*out_len += n;
+	}
+	return retcode;
+}
+
+
+/*
+** Compressed data
+**
+** The data can be compressed before being encoded:
+**   ?Z?       marker (like ?F?, never the start of plain BaseXML data)
+**   codec     one byte: 'z' zlib (deflate), 's' zstd
+**   payload   the compressed stream, encoded as plain BaseXML
+** Compression and encoding are fused: each chunk goes through both
+** stages while it is in the cache, and the result is handed to a sink,
+** without intermediate file. The codecs come from the system libraries:
+** build with -DBASEXML_WITH_ZLIB -lz and/or -DBASEXML_WITH_ZSTD -lzstd.
+*/
+#define BASEXML_CODEC_ZLIB        'z'
+#define BASEXML_CODEC_ZSTD        's'
+#define BASEXML_CODEC_MAX_LEVEL(codec) ((codec) == BASEXML_CODEC_ZLIB ? 9 : 22) // levels: 0 to this
+#define BASEXML_ZCHUNK            30000 // multiple of 5 and 6, with its encoded copy fits in L2
+
+typedef int (*basexml_sink)( void *ctx, const unsigned char *data, size_t len ); // returns 0 or an error code
+
+typedef struct basexml_zstream {
+	int codec;
+	int encoding;
+	int active;              // the codec holds resources
+	int ended;               // decoding: end of the compressed stream seen
+	basexml_sink sink;
+	void *ctx;
+	basexml_encoder enc;
+	basexml_decoder dec;
+	unsigned char header[4]; // decoding: marker and codec, as they come
+	size_t header_len;
+#ifdef BASEXML_WITH_ZLIB
+	z_stream z;
+#endif
+#ifdef BASEXML_WITH_ZSTD
+	ZSTD_CStream *zc;
+	ZSTD_DStream *zd;
+#endif
+	unsigned char buf[BASEXML_ZCHUNK];                            // compressed or decompressed
+	unsigned char out[BASEXML_ENCODE_UPDATE_MAX( BASEXML_ZCHUNK )]; // encoded or decoded
+} basexml_zstream;
+
+/*
+** basexml_codec_available
+**
+** 1 if this build can use the codec
+*/
+int basexml_codec_available( int codec )
+{
+#ifdef BASEXML_WITH_ZLIB
+	if( codec == BASEXML_CODEC_ZLIB ) return 1;
+#endif
+#ifdef BASEXML_WITH_ZSTD
+	if( codec == BASEXML_CODEC_ZSTD ) return 1;
+#endif
+	(void) codec;
+	return 0;
+}
+
+/*
+** zstream_start
+**
+** set up the codec (level: -1 for its default)
+*/
+static int zstream_start( basexml_zstream *z, int level )
+{
+	int retcode = BASEXML_CODEC_ERROR;
+
+#ifdef BASEXML_WITH_ZLIB
+	if( z->codec == BASEXML_CODEC_ZLIB ) {
+		memset( &z->z, 0, sizeof( z->z ) );
+		if( (z->encoding ? deflateInit( &z->z, level < 0 ? Z_DEFAULT_COMPRESSION : level ) : inflateInit( &z->z )) == Z_OK ) {
+			retcode = 0;
+		}
+	}
+#endif
+#ifdef BASEXML_WITH_ZSTD
+	if( z->codec == BASEXML_CODEC_ZSTD ) {
+		if( z->encoding ) {
+			z->zc = ZSTD_createCStream();
+			if( z->zc && !ZSTD_isError( ZSTD_initCStream( z->zc, level < 0 ? ZSTD_CLEVEL_DEFAULT : level ) ) ) retcode = 0;
+		} else {
+			z->zd = ZSTD_createDStream();
+			if( z->zd && !ZSTD_isError( ZSTD_initDStream( z->zd ) ) ) retcode = 0;
+		}
+	}
+#endif
+	(void) level;
+	z->active = 1;
+	return retcode;
+}
+
+/*
+** basexml_zstream_end
+**
+** release the codec (done by the finish functions, needed after an error)
+*/
+void basexml_zstream_end( basexml_zstream *z )
+{
+	if( !z->active ) {
+		return;
+	}
+#ifdef BASEXML_WITH_ZLIB
+	if( z->codec == BASEXML_CODEC_ZLIB ) {
+		if( z->encoding ) deflateEnd( &z->z ); else inflateEnd( &z->z );
+	}
+#endif
+#ifdef BASEXML_WITH_ZSTD
+	if( z->codec == BASEXML_CODEC_ZSTD ) {
+		if( z->encoding ) ZSTD_freeCStream( z->zc ); else ZSTD_freeDStream( z->zd );
+		z->zc = NULL;
+		z->zd = NULL;
+	}
+#endif
+	z->active = 0;
+}
+
+#if defined(BASEXML_WITH_ZLIB) || defined(BASEXML_WITH_ZSTD)
+/*
+** zencode_emit
+**
+** encode compressed bytes and hand them to the sink
+*/
+static int zencode_emit( basexml_zstream *z, size_t len )
+{
+	size_t out_len = basexml_encoder_update( &z->enc, z->buf, len, z->out );
+
+	return out_len ? z->sink( z->ctx, z->out, out_len ) : 0;
+}
+#endif
+
+/*
+** zencode_chunk
+**
+** compress len bytes (up to BASEXML_ZCHUNK), or flush the compressor
+** when finish is set, encoding the output as it comes
+*/
+static int zencode_chunk( basexml_zstream *z, const unsigned char *in, size_t len, int finish )
+{
+	int retcode = BASEXML_CODEC_ERROR;
+
+#ifdef BASEXML_WITH_ZLIB
+	if( z->codec == BASEXML_CODEC_ZLIB ) {
+		int ret;
+		z->z.next_in = (unsigned char *) in;
+		z->z.avail_in = (unsigned) len;
+		do {
+			z->z.next_out = z->buf;
+			z->z.avail_out = BASEXML_ZCHUNK;
+			ret = deflate( &z->z, finish ? Z_FINISH : Z_NO_FLUSH );
+			if( ret == Z_STREAM_ERROR ) return BASEXML_CODEC_ERROR;
+			retcode = zencode_emit( z, BASEXML_ZCHUNK - z->z.avail_out );
+		} while( !retcode && (z->z.avail_out == 0 || (finish && ret != Z_STREAM_END)) );
+	}
+#endif
+#ifdef BASEXML_WITH_ZSTD
+	if( z->codec == BASEXML_CODEC_ZSTD ) {
+		ZSTD_inBuffer inb = { in, len, 0 };
+		ZSTD_outBuffer outb;
+		size_t ret;
+		do {
+			outb.dst = z->buf;
+			outb.size = BASEXML_ZCHUNK;
+			outb.pos = 0;
+			ret = ZSTD_compressStream2( z->zc, &outb, &inb, finish ? ZSTD_e_end : ZSTD_e_continue );
+			if( ZSTD_isError( ret ) ) return BASEXML_CODEC_ERROR;
+			retcode = zencode_emit( z, outb.pos );
+		} while( !retcode && (inb.pos < inb.size || outb.pos == outb.size || (finish && ret != 0)) );
+	}
+#endif
+	(void) z; (void) in; (void) len; (void) finish;
+	return retcode;
+}
+
+/*
+** basexml_zencoder_init / update / finish
+**
+** Compress and encode data pushed in pieces of any size, the encoded
+** result going to sink( ctx, ... ). codec: BASEXML_CODEC_*, level: -1
+** for the codec's default.
+*/
+int basexml_zencoder_init( basexml_zstream *z, int codec, int level, basexml_sink sink, void *ctx )
+{
+	unsigned char header[4] = { '?', 'Z', '?', 0 };
+	int retcode;
+
+	memset( z, 0, offsetof( basexml_zstream, buf ) );
+	z->codec = codec;
+	z->encoding = 1;
+	z->sink = sink;
+	z->ctx = ctx;
+	if( !basexml_codec_available( codec ) ) {
+		return BASEXML_BAD_CODEC;
+	}
+	basexml_encoder_init( &z->enc );
+	retcode = zstream_start( z, level );
+	header[3] = (unsigned char) codec;
+	if( !retcode ) retcode = sink( ctx, header, 4 );
+	if( retcode ) basexml_zstream_end( z );
+	return retcode;
+}
+
+int basexml_zencoder_update( basexml_zstream *z, const unsigned char *in, size_t len )
+{
+	size_t n;
+	int retcode = 0;
+
+	for( ; len && !retcode; in += n, len -= n ) { // in cache-sized chunks
+		n = len < BASEXML_ZCHUNK ? len : BASEXML_ZCHUNK;
+		retcode = zencode_chunk( z, in, n, 0 );
+	}
+	return retcode;
+}
+
+int basexml_zencoder_finish( basexml_zstream *z )
+{
+	size_t out_len;
+	int retcode = zencode_chunk( z, NULL, 0, 1 );
+
+	if( !retcode ) {
+		out_len = basexml_encoder_finish( &z->enc, z->out );
+		retcode = out_len ? z->sink( z->ctx, z->out, out_len ) : 0;
+	}
+	basexml_zstream_end( z );
+	return retcode;
+}
+
+/*
+** zdecode_chunk
+**
+** decompress len compressed bytes, handing the result to the sink
+*/
+static int zdecode_chunk( basexml_zstream *z, const unsigned char *in, size_t len )
+{
+	int retcode = 0;
+
+	if( len && z->ended ) { // data after the end of the compressed stream
+		return BASEXML_CODEC_ERROR;
+	}
+#ifdef BASEXML_WITH_ZLIB
+	if( z->codec == BASEXML_CODEC_ZLIB ) {
+		int ret;
+		z->z.next_in = (unsigned char *) in;
+		z->z.avail_in = (unsigned) len;
+		while( !retcode && z->z.avail_in && !z->ended ) {
+			z->z.next_out = z->buf;
+			z->z.avail_out = BASEXML_ZCHUNK;
+			ret = inflate( &z->z, Z_NO_FLUSH );
+			if( ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR ) return BASEXML_CODEC_ERROR;
+			z->ended = ret == Z_STREAM_END;
+			if( BASEXML_ZCHUNK - z->z.avail_out ) retcode = z->sink( z->ctx, z->buf, BASEXML_ZCHUNK - z->z.avail_out );
+		}
+		if( !retcode && z->ended && z->z.avail_in ) retcode = BASEXML_CODEC_ERROR;
+	}
+#endif
+#ifdef BASEXML_WITH_ZSTD
+	if( z->codec == BASEXML_CODEC_ZSTD ) {
+		ZSTD_inBuffer inb = { in, len, 0 };
+		ZSTD_outBuffer outb;
+		size_t ret;
+		while( !retcode && inb.pos < inb.size ) {
+			outb.dst = z->buf;
+			outb.size = BASEXML_ZCHUNK;
+			outb.pos = 0;
+			ret = ZSTD_decompressStream( z->zd, &outb, &inb );
+			if( ZSTD_isError( ret ) ) return BASEXML_CODEC_ERROR;
+			z->ended = ret == 0;
+			if( outb.pos ) retcode = z->sink( z->ctx, z->buf, outb.pos );
+		}
+	}
+#endif
+	(void) in;
+	return retcode;
+}
+
+/*
+** basexml_zdecoder_init / update / finish
+**
+** Decode and decompress data pushed in pieces of any size, starting
+** with the ?Z? marker, the raw result going to sink( ctx, ... ).
+*/
+int basexml_zdecoder_init( basexml_zstream *z, basexml_sink sink, void *ctx )
+{
+	memset( z, 0, offsetof( basexml_zstream, buf ) );
+	z->sink = sink;
+	z->ctx = ctx;
+	basexml_decoder_init( &z->dec );
+	return 0;
+}
+
+int basexml_zdecoder_update( basexml_zstream *z, const unsigned char *in, size_t len )
+{
+	size_t n, out_len;
+	int retcode = 0;
+
+	while( len && z->header_len < 4 ) { // marker and codec first
+		z->header[z->header_len++] = *in++;
+		len--;
+		if( z->header_len == 4 ) {
+			if( memcmp( z->header, BASEXML_COMPRESSED_MARKER, 3 ) != 0 || !basexml_codec_available( z->header[3] ) ) {
+				return BASEXML_BAD_CODEC;
+			}
+			z->codec = z->header[3];
+			retcode = zstream_start( z, -1 );
+			if( retcode ) return retcode;
+		}
+	}
+	for( ; len && !retcode; in += n, len -= n ) {
+		n = len < BASEXML_ZCHUNK ? len : BASEXML_ZCHUNK;
+		retcode = basexml_decoder_update( &z->dec, in, n, z->out, &out_len );
+		if( !retcode ) retcode = zdecode_chunk( z, z->out, out_len );
+	}
+	return retcode;
+}
+
+int basexml_zdecoder_finish( basexml_zstream *z )
+{
+	size_t out_len;
+	int retcode = z->header_len < 4 ? BASEXML_UNEXPECTED_END : 0;
+
+	if( !retcode ) retcode = basexml_decoder_finish( &z->dec, z->out, &out_len );
+	if( !retcode ) retcode = zdecode_chunk( z, z->out, out_len );
+	if( !retcode && !z->ended ) retcode = BASEXML_UNEXPECTED_END; // truncated compressed stream
+	basexml_zstream_end( z );
+	return retcode;
+}
+
+/*
+** Automatic mode
+**
+** Compressing already compressed data (JPEG, zip...) only costs time,
+** not compressing text costs bytes. A sample of the data decides,
+** from two cheap estimates:
+**   concentration  sum of the squared byte frequencies, times 256:
+**                  1.0 for random bytes, 181/256*256 past 7.5 bits of
+**                  (collision) entropy per byte
+**   repeats        share of 4-byte sequences seen shortly before, what
+**                  LZ compressors feed on even with spread out bytes
+** The choice is recorded by the data itself: the ?Z? marker and its
+** codec byte, or plain BaseXML.
+*/
+#define BASEXML_AUTO_MIN     512 // smaller data isn't worth compressing
+#define BASEXML_AUTO_HASH    12  // bits of the repeats table
+
+typedef struct basexml_auto_stats {
+	size_t sampled;       // bytes looked at
+	double concentration; // 1.0 for random bytes
+	double repeats;       // 0.0 to 1.0
+	int codec;            // chosen: 0 for plain BaseXML, else BASEXML_CODEC_*
+} basexml_auto_stats;
+
+/*
+** basexml_auto_codec
+**
+** Pick plain BaseXML (0) or the best codec of this build for data like
+** the len sampled bytes. stats may be NULL. Reentrant: its tables
+** (18 KB) are on the stack.
+*/
+int basexml_auto_codec( const unsigned char *sample, size_t len, basexml_auto_stats *stats )
+{
+	uint32_t seen[1 << BASEXML_AUTO_HASH];
+	size_t count[256], k, repeats = 0;
+	double sum_sq = 0;
+	uint32_t word = 0, hash;
+	int codec = 0;
+
+	memset( count, 0, sizeof( count ) );
+	memset( seen, 0, sizeof( seen ) );
+	for( k = 0; k < len; k++ ) {
+		count[sample[k]]++;
+		word = word << 8 | sample[k];
+		if( k >= 3 ) {
+			hash = (word * 2654435761u) >> (32 - BASEXML_AUTO_HASH);
+			repeats += seen[hash] == word;
+			seen[hash] = word;
+		}
+	}
+	for( k = 0; k < 256; k++ ) {
+		sum_sq += (double) count[k] * count[k];
+	}
+
+	if( len >= BASEXML_AUTO_MIN && (sum_sq * 181 > (double) len * len || repeats * 8 > len) ) { // < 7.5 bits per byte, or 1/8 repeated
+		codec = basexml_codec_available( BASEXML_CODEC_ZSTD ) ? BASEXML_CODEC_ZSTD :
+		        basexml_codec_available( BASEXML_CODEC_ZLIB ) ? BASEXML_CODEC_ZLIB : 0;
+	}
+	if( stats ) {
+		stats->sampled = len;
+		stats->concentration = len ? sum_sq * 256 / ((double) len * len) : 0;
+		stats->repeats = len > 3 ? (double) repeats / (len - 3) : 0;
+		stats->codec = codec;
+	}
+	return codec;
+}
+
+/*
+** XML writer
+**
+** A small streaming XML writer. Binary content is encoded straight into
+** its output buffer: a document of any size costs one encoding pass and
+** no allocation.
+**   basexml_writer w;                        // large: static or malloc'd
+**   basexml_writer_init_file( &w, stdout );  // or _init_fd, or _init( sink )
+**   basexml_start_document( &w );
+**   basexml_start_element( &w, "doc" );
+**   basexml_start_element( &w, "blob" );
+**   basexml_write_attribute( &w, "name", "a.jpg" );
+**   basexml_write_binary_file( &w, jpeg );   // or _buffer, _fd, _callback
+**   basexml_end_element( &w );
+**   basexml_writer_finish( &w );             // closes <doc> and flushes
+** Binary writes in a row make up one payload, ended with the element.
+** Errors stick: once a call fails, the next ones return the same code.
+** Nothing is printed, the caller reports the code.
+*/
+#define BASEXML_WRITER_BUFFER 65536
+#define BASEXML_WRITER_CHUNK  30000 // binary input encoded at once
+#define BASEXML_WRITER_DEPTH  64
+#define BASEXML_WRITER_NAMES  2048  // for the names of the open elements
+
+typedef size_t (*basexml_source)( void *ctx, unsigned char *buf, size_t len ); // returns 0 at the end
+
+typedef struct basexml_writer {
+	basexml_sink sink;
+	void *ctx;
+	int retcode;
+	int tag_open;        // '<name' written, not its '>' yet
+	int binary_open;     // a payload is being encoded
+	basexml_encoder enc;
+	int depth;
+	size_t name_at[BASEXML_WRITER_DEPTH];
+	size_t names_len;
+	char names[BASEXML_WRITER_NAMES];
+	size_t len;
+	unsigned char buf[BASEXML_WRITER_BUFFER];
+	unsigned char in[BASEXML_WRITER_CHUNK];
+} basexml_writer;
+
+static int writer_file_sink( void *ctx, const unsigned char *data, size_t len )
+{
+	return fwrite( data, 1, len, (FILE *) ctx ) == len ? 0 : BASEXML_FILE_IO_ERROR;
+}
+
+static int writer_fd_sink( void *ctx, const unsigned char *data, size_t len )
+{
+	int fd = (int) (intptr_t) ctx;
+	long n;
+
+	for( ; len; data += n, len -= (size_t) n ) {
+#ifdef _WIN32
+		n = _write( fd, data, len < 0x40000000 ? (unsigned) len : 0x40000000 );
+#else
+		n = (long) write( fd, data, len );
+#endif
+		if( n <= 0 ) return BASEXML_FILE_IO_ERROR;
+	}
+	return 0;
+}
+
+void basexml_writer_init( basexml_writer *w, basexml_sink sink, void *ctx )
+{
+	w->sink = sink;
+	w->ctx = ctx;
+	w->retcode = 0;
+	w->tag_open = 0;
+	w->binary_open = 0;
+	w->depth = 0;
+	w->names_len = 0;
+	w->len = 0;
+}
+
+void basexml_writer_init_file( basexml_writer *w, FILE *file )
+{
+	basexml_writer_init( w, writer_file_sink, file );
+}
+
+void basexml_writer_init_fd( basexml_writer *w, int fd )
+{
+	basexml_writer_init( w, writer_fd_sink, (void *) (intptr_t) fd );
+}
+
+static int writer_fail( basexml_writer *w, int retcode )
+{
+	if( !w->retcode ) {
+		w->retcode = retcode;
+	}
+	return w->retcode;
+}
+
+/*
+** basexml_writer_flush
+**
+** hand the buffered output to the sink
+*/
+int basexml_writer_flush( basexml_writer *w )
+{
+	int retcode;
+
+	if( !w->retcode && w->len ) {
+		retcode = w->sink( w->ctx, w->buf, w->len );
+		w->len = 0;
+		if( retcode ) writer_fail( w, retcode );
+	}
+	return w->retcode;
+}
+
+/*
+** writer_room
+**
+** make room for n bytes (up to BASEXML_WRITER_BUFFER) in the buffer
+*/
+static int writer_room( basexml_writer *w, size_t n )
+{
+	return w->len + n > BASEXML_WRITER_BUFFER ? basexml_writer_flush( w ) : w->retcode;
+}
+
+static int writer_put( basexml_writer *w, const char *s, size_t n )
+{
+	size_t k;
+
+	for( ; n && !w->retcode; s += k, n -= k ) {
+		k = n < BASEXML_WRITER_BUFFER ? n : BASEXML_WRITER_BUFFER;
+		if( writer_room( w, k ) ) break;
+		memcpy( w->buf + w->len, s, k );
+		w->len += k;
+	}
+	return w->retcode;
+}
+
+/*
+** writer_escaped
+**
+** write text with & < > (and " in attributes) escaped
+*/
+static int writer_escaped( basexml_writer *w, const char *s, size_t n, int attribute )
+{
+	size_t k, start = 0;
+
+	for( k = 0; k < n && !w->retcode; k++ ) {
+		const char *entity = s[k] == '&' ? "&amp;" : s[k] == '<' ? "&lt;" : s[k] == '>' ? "&gt;" :
+		                     s[k] == '"' && attribute ? "&quot;" : NULL;
+		if( entity ) {
+			writer_put( w, s + start, k - start );
+			writer_put( w, entity, strlen( entity ) );
+			start = k + 1;
+		}
+	}
+	return writer_put( w, s + start, n - start );
+}
+
+/*
+** writer_content
+**
+** end the start tag or the payload before other content
+*/
+static int writer_content( basexml_writer *w )
+{
+	if( w->binary_open && !writer_room( w, 9 ) ) {
+		w->len += basexml_encoder_finish( &w->enc, w->buf + w->len );
+		w->binary_open = 0;
+	}
+	if( w->tag_open && !writer_put( w, ">", 1 ) ) {
+		w->tag_open = 0;
+	}
+	return w->retcode;
+}
+
+/*
+** basexml_start_document
+**
+** the XML declaration: BaseXML content needs UTF-8
+*/
+int basexml_start_document( basexml_writer *w )
+{
+	static const char declaration[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+
+	return writer_put( w, declaration, sizeof( declaration ) - 1 );
+}
+
+int basexml_start_element( basexml_writer *w, const char *name )
+{
+	size_t n = strlen( name );
+
+	if( writer_content( w ) ) return w->retcode;
+	if( w->depth == BASEXML_WRITER_DEPTH || w->names_len + n + 1 > BASEXML_WRITER_NAMES ) {
+		return writer_fail( w, BASEXML_WRITER_ERROR );
+	}
+	w->name_at[w->depth++] = w->names_len;
+	memcpy( w->names + w->names_len, name, n + 1 );
+	w->names_len += n + 1;
+	writer_put( w, "<", 1 );
+	writer_put( w, name, n );
+	w->tag_open = 1;
+	return w->retcode;
+}
+
+int basexml_write_attribute( basexml_writer *w, const char *name, const char *value )
+{
+	if( !w->tag_open ) { // only right after start_element
+		return writer_fail( w, BASEXML_WRITER_ERROR );
+	}
+	writer_put( w, " ", 1 );
+	writer_put( w, name, strlen( name ) );
+	writer_put( w, "=\"", 2 );
+	writer_escaped( w, value, strlen( value ), 1 );
+	return writer_put( w, "\"", 1 );
+}
+
+int basexml_write_text( basexml_writer *w, const char *text, size_t len )
+{
+	if( writer_content( w ) ) return w->retcode;
+	return writer_escaped( w, text, len, 0 );
+}
+
+int basexml_end_element( basexml_writer *w )
+{
+	if( !w->depth ) {
+		return writer_fail( w, BASEXML_WRITER_ERROR );
+	}
+	if( w->tag_open ) { // empty element
+		w->tag_open = 0;
+		writer_put( w, "/>", 2 );
+	} else if( !writer_content( w ) ) {
+		writer_put( w, "</", 2 );
+		writer_put( w, w->names + w->name_at[w->depth - 1], w->names_len - w->name_at[w->depth - 1] - 1 );
+		writer_put( w, ">", 1 );
+	}
+	w->names_len = w->name_at[--w->depth];
+	return w->retcode;
+}
+
+/*
+** basexml_writer_finish
+**
+** end the open elements and flush
+*/
+int basexml_writer_finish( basexml_writer *w )
+{
+	while( w->depth && !w->retcode ) {
+		basexml_end_element( w );
+	}
+	return basexml_writer_flush( w );
+}
+
+/*
+** writer_binary
+**
+** encode n bytes (up to BASEXML_WRITER_CHUNK) into the buffer
+*/
+static int writer_binary( basexml_writer *w, const unsigned char *data, size_t n )
+{
+	if( !w->binary_open ) {
+		if( writer_content( w ) ) return w->retcode;
+		basexml_encoder_init( &w->enc );
+		w->binary_open = 1;
+	}
+	if( writer_room( w, BASEXML_ENCODE_UPDATE_MAX( n ) ) ) return w->retcode;
+	w->len += basexml_encoder_update( &w->enc, data, n, w->buf + w->len );
+	return 0;
+}
+
+/*
+** basexml_write_binary_buffer / _fd / _file / _callback
+**
+** write binary content, as BaseXML, from memory or read up to the end
+** of a file descriptor, a FILE or a source callback
+*/
+int basexml_write_binary_buffer( basexml_writer *w, const unsigned char *data, size_t len )
+{
+	size_t n;
+
+	if( !len ) return writer_binary( w, data, 0 ); // still a (empty) payload
+	for( ; len && !w->retcode; data += n, len -= n ) {
+		n = len < BASEXML_WRITER_CHUNK ? len : BASEXML_WRITER_CHUNK;
+		writer_binary( w, data, n );
+	}
+	return w->retcode;
+}
+
+int basexml_write_binary_callback( basexml_writer *w, basexml_source source, void *ctx )
+{
+	size_t n;
+
+	writer_binary( w, w->in, 0 );
+	while( !w->retcode && (n = source( ctx, w->in, BASEXML_WRITER_CHUNK )) > 0 ) {
+		writer_binary( w, w->in, n );
+	}
+	return w->retcode;
+}
+
+static size_t file_source( void *ctx, unsigned char *buf, size_t len )
+{
+	return fread( buf, 1, len, (FILE *) ctx );
+}
+
+int basexml_write_binary_file( basexml_writer *w, FILE *file )
+{
+	basexml_write_binary_callback( w, file_source, file );
+	return ferror( file ) ? writer_fail( w, BASEXML_FILE_IO_ERROR ) : w->retcode;
+}
+
+int basexml_write_binary_fd( basexml_writer *w, int fd )
+{
+	long n;
+
+	writer_binary( w, w->in, 0 );
+	while( !w->retcode ) {
+#ifdef _WIN32
+		n = _read( fd, w->in, BASEXML_WRITER_CHUNK );
+#else
+		n = (long) read( fd, w->in, BASEXML_WRITER_CHUNK );
+#endif
+		if( n < 0 ) return writer_fail( w, BASEXML_FILE_IO_ERROR );
+		if( n == 0 ) break;
+		writer_binary( w, w->in, (size_t) n );
+	}
+	return w->retcode;
+}
+
+#ifdef BASEXML_WITH_LIBXML2
+/*
+** basexml_xmltextwriter_write / _finish
+**
+** The same for libxml2's xmlTextWriter: write data pushed in pieces with
+** the caller's encoder (basexml_encoder_init it after starting the
+** element), as raw text since BaseXML never needs escaping. The
+** document encoding must be UTF-8.
+*/
+int basexml_xmltextwriter_write( xmlTextWriterPtr writer, basexml_encoder *enc, const unsigned char *data, size_t len )
+{
+	unsigned char out[BASEXML_ENCODE_UPDATE_MAX( BASEXML_WRITER_CHUNK )];
+	size_t n, out_len;
+
+	for( ; len; data += n, len -= n ) {
+		n = len < BASEXML_WRITER_CHUNK ? len : BASEXML_WRITER_CHUNK;
+		out_len = basexml_encoder_update( enc, data, n, out );
+		if( out_len && xmlTextWriterWriteRawLen( writer, out, (int) out_len ) < 0 ) {
+			return BASEXML_FILE_IO_ERROR;
+		}
+	}
+	return 0;
+}
+
+int basexml_xmltextwriter_finish( xmlTextWriterPtr writer, basexml_encoder *enc )
+{
+	unsigned char out[9];
+	size_t out_len = basexml_encoder_finish( enc, out );
+
+	return out_len && xmlTextWriterWriteRawLen( writer, out, (int) out_len ) < 0 ? BASEXML_FILE_IO_ERROR : 0;
+}
+#endif
+
+/*
+** Chunked elements
+**
+** Some consumers buffer a whole text node before handing it over: the
+** encoded data can be written as sibling elements <c>...</c><c>...</c>
+** of size encoded bytes each (a multiple of 6: whole groups), only the
+** last one ending with the termination sequence. Their concatenation
+** is plain BaseXML: the decoding side only drops the tags.
+*/
+#define BASEXML_CHUNK_NAME 64 // longest element name
+
+typedef struct basexml_chunker {
+	basexml_sink sink;
+	void *ctx;
+	char tags[2 * BASEXML_CHUNK_NAME + 6]; // "</c><c>"
+	size_t name_len;
+	size_t size;
+	size_t used;         // bytes in the current element
+	int boundary;        // the current element is full
+	unsigned char tail[3]; // after a boundary: maybe a long termination sequence
+	size_t tail_len;
+} basexml_chunker;
+
+/*
+** basexml_chunker_init / write / finish
+**
+** Write encoded data (from a basexml_encoder) to sink in elements named
+** name, of size encoded bytes (rounded down to whole groups).
+*/
+int basexml_chunker_init( basexml_chunker *ch, const char *name, size_t size, basexml_sink sink, void *ctx )
+{
+	ch->name_len = strlen( name );
+	if( ch->name_len > BASEXML_CHUNK_NAME || !ch->name_len ) {
+		return BASEXML_SYNTAX_ERROR;
+	}
+	sprintf( ch->tags, "</%s><%s>", name, name );
+	ch->sink = sink;
+	ch->ctx = ctx;
+	ch->size = size < 6 ? 6 : size / 6 * 6;
+	ch->used = 0;
+	ch->boundary = 0;
+	ch->tail_len = 0;
+	return sink( ctx, (const unsigned char *) ch->tags + ch->name_len + 3, ch->name_len + 2 ); // "<c>"
+}
+
+int basexml_chunker_write( basexml_chunker *ch, const unsigned char *data, size_t len )
+{
+	size_t n;
+	int retcode = 0;
+
+	while( len && !retcode ) {
+		if( ch->boundary ) { // a next element, unless only a long termination sequence follows
+			for( ; len && ch->tail_len < 3; len-- ) ch->tail[ch->tail_len++] = *data++;
+			if( !len ) break;
+			retcode = ch->sink( ch->ctx, (const unsigned char *) ch->tags, 2 * ch->name_len + 5 );
+			if( !retcode ) retcode = ch->sink( ch->ctx, ch->tail, 3 );
+			ch->used = 3;
+			ch->boundary = 0;
+			ch->tail_len = 0;
+			continue;
+		}
+		n = len < ch->size - ch->used ? len : ch->size - ch->used;
+		retcode = ch->sink( ch->ctx, data, n );
+		data += n;
+		len -= n;
+		ch->used += n;
+		ch->boundary = ch->used == ch->size;
+	}
+	return retcode;
+}
+
+int basexml_chunker_finish( basexml_chunker *ch )
+{
+	int retcode = ch->tail_len ? ch->sink( ch->ctx, ch->tail, ch->tail_len ) : 0;
+
+	return retcode ? retcode : ch->sink( ch->ctx, (const unsigned char *) ch->tags, ch->name_len + 3 ); // "</c>"
+}
+
+/*
+** basexml_unchunker_init / basexml_unchunk
+**
+** Keep the text of the elements named name (their content), out of len
+** bytes of chunked data possibly inside a document, in out (may be in)
+** for a basexml_decoder. Returns its length.
+*/
+typedef struct basexml_unchunker {
+	const char *name;
+	size_t name_len;
+	int in_tag;
+	int closing;         // the tag is an end tag
+	int name_done;       // the tag name has been read
+	size_t matched;      // its bytes matching name, name_len + 1: no match
+	int inside;          // in an element named name
+	unsigned char last;  // in the tag, to find "/>"
+} basexml_unchunker;
+
+void basexml_unchunker_init( basexml_unchunker *u, const char *name )
+{
+	u->name = name;
+	u->name_len = strlen( name );
+	u->in_tag = 0;
+	u->inside = 0;
+}
+
+size_t basexml_unchunk( basexml_unchunker *u, const unsigned char *in, size_t len, unsigned char *out )
+{
+	size_t k, out_len = 0;
+	unsigned char c;
+
+	for( k = 0; k < len; k++ ) {
+		c = in[k];
+		if( !u->in_tag ) {
+			if( c == '<' ) {
+				u->in_tag = 1;
+				u->closing = 0;
+				u->name_done = 0;
+				u->matched = 0;
+				u->last = c;
+			} else if( u->inside ) {
+				out[out_len++] = c;
+			}
+			continue;
+		}
+		if( c == '>' ) {
+			u->in_tag = 0;
+			if( u->closing ) u->inside = 0; // <c> holds no element: its end
+			else if( u->matched == u->name_len && u->last != '/' ) u->inside = 1;
+		} else if( u->last == '<' && c == '/' ) {
+			u->closing = 1;
+		} else if( !u->name_done ) {
+			if( c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '/' ) u->name_done = 1;
+			else if( u->matched < u->name_len && (unsigned char) u->name[u->matched] == c ) u->matched++;
+			else u->matched = u->name_len + 1;
+		}
+		u->last = c;
+	}
+	return out_len;
+}
+
+/*
+** Base64 transcoding
+**
+** Base64 to BaseXML in one pass: Base64 is decoded tile by tile (16
+** characters at a time with SSSE3) into a small buffer that stays in
+** the L1 cache, and encoded from there. No buffer of the whole binary
+** data. Whitespace (line breaks) is skipped, padding is optional.
+** 20 Base64 characters are 15 bytes, or 18 BaseXML bytes: chunks of
+** Base64 without whitespace cut every 20*k characters can be transcoded
+** in parallel, each by its own transcoder, their outputs concatenated
+** (only the last one finished).
+*/
+#define BASEXML_B64_TILE 4096 // Base64 characters decoded at once
+
+#define BASEXML_FROM_BASE64_MAX(len) BASEXML_ENCODE_UPDATE_MAX( ((len) + 3) / 4 * 3 )
+
+typedef struct basexml_from64 {
+	basexml_encoder enc;
+	uint32_t quad;       // pending 6-bit values
+	int quad_len;
+	int padded;          // '=' seen: the end
+} basexml_from64;
+
+static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#define BASE64_SPACE   64
+#define BASE64_PAD     65
+#define BASE64_INVALID 66
+static const unsigned char base64_values[256] = { // 6-bit value of each character, or one of the above
+	66, 66, 66, 66, 66, 66, 66, 66, 66, 64, 64, 66, 66, 64, 66, 66,
+	66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
+	64, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 62, 66, 66, 66, 63,
+	52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 66, 66, 66, 65, 66, 66,
+	66,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 66, 66, 66, 66, 66,
+	66, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 66, 66, 66, 66, 66,
+	66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
+	66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
+	66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
+	66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
+	66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
+	66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
+	66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
+	66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66
+};
+
+#ifdef __SSSE3__
+/*
+** base64_decode16
+**
+** decode 16 Base64 characters into 12 bytes (16 written), 0 if one of
+** them is something else (whitespace, padding, invalid)
+*/
+static int base64_decode16( const unsigned char *in, unsigned char *out )
+{
+	const __m128i lut_lo = _mm_setr_epi8( 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a );
+	const __m128i lut_hi = _mm_setr_epi8( 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 );
+	const __m128i lut_roll = _mm_setr_epi8( 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0 );
+	const __m128i mask_2f = _mm_set1_epi8( 0x2f );
+	__m128i v = _mm_loadu_si128( (const __m128i *) in );
+	__m128i hi_nibbles = _mm_and_si128( _mm_srli_epi32( v, 4 ), mask_2f );
+	__m128i lo_nibbles = _mm_and_si128( v, mask_2f );
+	__m128i lo = _mm_shuffle_epi8( lut_lo, lo_nibbles );
+	__m128i hi = _mm_shuffle_epi8( lut_hi, hi_nibbles );
+
+	if( _mm_movemask_epi8( _mm_cmpgt_epi8( _mm_and_si128( lo, hi ), _mm_setzero_si128() ) ) ) {
+		return 0;
+	}
+	v = _mm_add_epi8( v, _mm_shuffle_epi8( lut_roll, _mm_add_epi8( _mm_cmpeq_epi8( v, mask_2f ), hi_nibbles ) ) );
+	v = _mm_maddubs_epi16( v, _mm_set1_epi32( 0x01400140 ) ); // 2 values of 6 bits into 12 bits
+	v = _mm_madd_epi16( v, _mm_set1_epi32( 0x00011000 ) );    // 2 of 12 bits into 24 bits
+	v = _mm_shuffle_epi8( v, _mm_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 ) );
+	_mm_storeu_si128( (__m128i *) out, v );
+	return 1;
+}
+#endif
+
+/*
+** basexml_from_base64_init / update / finish
+**
+** Transcode Base64 pushed in pieces of any size to BaseXML. out must
+** hold BASEXML_FROM_BASE64_MAX( len ) bytes, 9 for finish.
+*/
+void basexml_from_base64_init( basexml_from64 *t )
+{
+	basexml_encoder_init( &t->enc );
+	t->quad = 0;
+	t->quad_len = 0;
+	t->padded = 0;
+}
+
+int basexml_from_base64_update( basexml_from64 *t, const unsigned char *in, size_t len, unsigned char *out, size_t *out_len )
+{
+	unsigned char tile[BASEXML_B64_TILE / 4 * 3 + 16];
+	size_t k = 0, n;
+	unsigned char v;
+
+	*out_len = 0;
+	while( k < len ) {
+		for( n = 0; k < len && n < BASEXML_B64_TILE / 4 * 3; ) {
+#ifdef __SSSE3__
+			if( !t->quad_len && !t->padded && len - k >= 16 && base64_decode16( in + k, tile + n ) ) {
+				k += 16;
+				n += 12;
+				continue;
+			}
+#endif
+			v = base64_values[in[k++]];
+			if( v == BASE64_SPACE ) continue;
+			if( v == BASE64_PAD ) { // the end: 1 or 2 more bytes
+				if( !t->padded && t->quad_len >= 2 ) {
+					tile[n++] = (unsigned char) (t->quad >> (t->quad_len * 6 - 8));
+					if( t->quad_len == 3 ) tile[n++] = (unsigned char) (t->quad >> 2);
+					t->quad_len = 0;
+					t->padded = 1;
+				} else if( !t->padded ) {
+					return BASEXML_BAD_BASE64;
+				}
+				continue;
+			}
+			if( v == BASE64_INVALID || t->padded ) {
+				return BASEXML_BAD_BASE64;
+			}
+			t->quad = t->quad << 6 | v;
+			if( ++t->quad_len == 4 ) {
+				tile[n++] = (unsigned char) (t->quad >> 16);
+				tile[n++] = (unsigned char) (t->quad >> 8);
+				tile[n++] = (unsigned char) t->quad;
+				t->quad_len = 0;
+			}
+		}
+		*out_len += basexml_encoder_update( &t->enc, tile, n, out + *out_len );
+	}
+	return 0;
+}
+
+int basexml_from_base64_finish( basexml_from64 *t, unsigned char *out, size_t *out_len )
+{
+	unsigned char tail[2];
+	size_t n = 0;
+
+	if( t->quad_len == 1 ) {
+		return BASEXML_BAD_BASE64;
+	}
+	if( t->quad_len ) { // without padding
+		tail[n++] = (unsigned char) (t->quad >> (t->quad_len * 6 - 8));
+		if( t->quad_len == 3 ) tail[n++] = (unsigned char) (t->quad >> 2);
+	}
+	*out_len = basexml_encoder_update( &t->enc, tail, n, out );
+	*out_len += basexml_encoder_finish( &t->enc, out + *out_len );
+	return 0;
+}
+
+/*
+** BaseXML to Base64, the other way: groups are decoded tile by tile by
+** the block decoder into a small buffer, and encoded to Base64 from
+** there (12 bytes into 16 characters at a time with SSSE3). The memory
+** used doesn't depend on the size of the data. wrap is the length of
+** the Base64 lines (0: one line), each ended by '\n', the last one too.
+*/
+#define BASEXML_B64_GROUPS 3600 // BaseXML bytes decoded at once
+
+#define BASEXML_TO_BASE64_MAX(len, wrap) ( (BASEXML_DECODE_UPDATE_MAX(len) / 3 + 2) * 4 * ((wrap) ? 2 : 1) )
+
+typedef struct basexml_to64 {
+	basexml_decoder dec;
+	unsigned char pending[2]; // decoded bytes waiting for a whole triple
+	int pending_len;
+	size_t wrap;
+	size_t col;               // characters on the current line
+} basexml_to64;
+
+#ifdef __SSSE3__
+/*
+** base64_encode12
+**
+** encode 12 bytes (16 read) into 16 Base64 characters
+*/
+static void base64_encode12( const unsigned char *in, unsigned char *out )
+{
+	const __m128i shift_lut = _mm_setr_epi8( 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+	                                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0 );
+	__m128i v = _mm_loadu_si128( (const __m128i *) in );
+	__m128i hi, lo, idx, shift;
+
+	v = _mm_shuffle_epi8( v, _mm_setr_epi8( 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10 ) );
+	hi = _mm_mulhi_epu16( _mm_and_si128( v, _mm_set1_epi32( 0x0fc0fc00 ) ), _mm_set1_epi32( 0x04000040 ) );
+	lo = _mm_mullo_epi16( _mm_and_si128( v, _mm_set1_epi32( 0x003f03f0 ) ), _mm_set1_epi32( 0x01000010 ) );
+	idx = _mm_or_si128( hi, lo ); // one 6-bit value per byte
+	shift = _mm_subs_epu8( idx, _mm_set1_epi8( 51 ) );
+	shift = _mm_or_si128( shift, _mm_and_si128( _mm_cmpgt_epi8( _mm_set1_epi8( 26 ), idx ), _mm_set1_epi8( 13 ) ) );
+	_mm_storeu_si128( (__m128i *) out, _mm_add_epi8( idx, _mm_shuffle_epi8( shift_lut, shift ) ) );
+}
+#endif
+
+/*
+** base64_put
+**
+** write one Base64 character, and the line break after it if due
+*/
+static size_t base64_put( basexml_to64 *t, unsigned char c, unsigned char *out )
+{
+	out[0] = c;
+	if( t->wrap && ++t->col == t->wrap ) {
+		out[1] = '\n';
+		t->col = 0;
+		return 2;
+	}
+	return 1;
+}
+
+/*
+** base64_emit
+**
+** encode the whole triples of p (len bytes, 16 readable), the 1 or 2
+** bytes left become pending unless last (then padded)
+*/
+static size_t base64_emit( basexml_to64 *t, const unsigned char *p, size_t len, int last, unsigned char *out )
+{
+	size_t i = 0, j = 0;
+	uint32_t v;
+
+	while( i + 3 <= len ) {
+#ifdef __SSSE3__
+		if( i + 12 <= len && (!t->wrap || t->col + 16 < t->wrap) ) {
+			base64_encode12( p + i, out + j );
+			i += 12;
+			j += 16;
+			t->col += 16;
+			continue;
+		}
+#endif
+		v = (uint32_t) p[i] << 16 | (uint32_t) p[i + 1] << 8 | p[i + 2];
+		j += base64_put( t, base64_chars[v >> 18], out + j );
+		j += base64_put( t, base64_chars[(v >> 12) & 0x3f], out + j );
+		j += base64_put( t, base64_chars[(v >> 6) & 0x3f], out + j );
+		j += base64_put( t, base64_chars[v & 0x3f], out + j );
+		i += 3;
+	}
+	t->pending_len = (int) (len - i);
+	if( t->pending_len && last ) {
+		v = (uint32_t) p[i] << 16 | (t->pending_len == 2 ? (uint32_t) p[i + 1] << 8 : 0);
+		j += base64_put( t, base64_chars[v >> 18], out + j );
+		j += base64_put( t, base64_chars[(v >> 12) & 0x3f], out + j );
+		j += base64_put( t, t->pending_len == 2 ? base64_chars[(v >> 6) & 0x3f] : '=', out + j );
+		j += base64_put( t, '=', out + j );
+		t->pending_len = 0;
+	}
+	memcpy( t->pending, p + i, t->pending_len );
+	if( last && t->wrap && t->col ) {
+		out[j++] = '\n';
+		t->col = 0;
+	}
+	return j;
+}
+
+/*
+** basexml_to_base64_init / update / finish
+**
+** Transcode BaseXML pushed in pieces of any size to Base64. out must
+** hold BASEXML_TO_BASE64_MAX( len, wrap ) bytes, 32 for finish.
+*/
+void basexml_to_base64_init( basexml_to64 *t, size_t wrap )
+{
+	basexml_decoder_init( &t->dec );
+	t->pending_len = 0;
+	t->wrap = wrap;
+	t->col = 0;
+}
+
+int basexml_to_base64_update( basexml_to64 *t, const unsigned char *in, size_t len, unsigned char *out, size_t *out_len )
+{
+	unsigned char tile[2 + BASEXML_DECODE_UPDATE_MAX( BASEXML_B64_GROUPS ) + 16];
+	size_t k, n, piece;
+	int rc;
+
+	*out_len = 0;
+	for( k = 0; k < len; k += piece ) {
+		piece = len - k < BASEXML_B64_GROUPS ? len - k : BASEXML_B64_GROUPS;
+		memcpy( tile, t->pending, t->pending_len );
+		rc = basexml_decoder_update( &t->dec, in + k, piece, tile + t->pending_len, &n );
+		if( rc ) return rc;
+		*out_len += base64_emit( t, tile, t->pending_len + n, 0, out + *out_len );
+	}
+	return 0;
+}
+
+int basexml_to_base64_finish( basexml_to64 *t, unsigned char *out, size_t *out_len )
+{
+	unsigned char tile[2 + 5 + 16];
+	size_t n;
+	int rc;
+
+	memcpy( tile, t->pending, t->pending_len );
+	rc = basexml_decoder_finish( &t->dec, tile + t->pending_len, &n );
+	if( rc ) return rc;
+	*out_len = base64_emit( t, tile, t->pending_len + n, 1, out );
+	return 0;
+}
+
+/*
+** Escaped data
+**
+** For mostly-text payloads (logs, JSON), instead of the 20% of BaseXML:
+** the bytes that can be in XML text as they are (printable ASCII, TAB,
+** well-formed UTF-8) are kept, the others escaped yEnc style with '=':
+**   \0 \r \n < > & = and the other control chars: '=' then byte + 0x40
+**   DEL and bytes of no well-formed UTF-8 sequence: '=' then U+0100 + byte
+** The C1 controls, U+2028, U+FFFE and U+FFFF are escaped byte by byte
+** too, so the result is text in XML 1.0 and XML 1.1 alike. It starts
+** with "?E?", which BaseXML never does (like "?F?"). Lines of 80 chars
+** of ASCII text grow by about 1.2%, their line breaks being escaped.
+*/
+#define BASEXML_ESCAPE_UPDATE_MAX(len) ( 3 * (len) + 12 ) // 12 for finish
+#define BASEXML_UNESCAPE_UPDATE_MAX(len) ( (len) + 1 )
+
+typedef struct basexml_escaper {
+	unsigned char pending[4]; // incomplete UTF-8 sequence (escaping) or escape (unescaping)
+	int pending_len;
+	int started;              // marker bytes written or checked
+} basexml_escaper;
+
+#ifdef __SSE2__
+/*
+** escape16
+**
+** bit k set if byte k of 16 isn't printable ASCII kept as is
+*/
+static int escape16( const unsigned char *p )
+{
+	__m128i v = _mm_loadu_si128( (const __m128i *) p );
+	__m128i bad = _mm_cmplt_epi8( v, _mm_set1_epi8( 0x20 ) ); // signed: also >= 0x80
+
+	bad = _mm_or_si128( bad, _mm_cmpeq_epi8( v, _mm_set1_epi8( '<' ) ) );
+	bad = _mm_or_si128( bad, _mm_cmpeq_epi8( v, _mm_set1_epi8( '>' ) ) );
+	bad = _mm_or_si128( bad, _mm_cmpeq_epi8( v, _mm_set1_epi8( '&' ) ) );
+	bad = _mm_or_si128( bad, _mm_cmpeq_epi8( v, _mm_set1_epi8( '=' ) ) );
+	bad = _mm_or_si128( bad, _mm_cmpeq_epi8( v, _mm_set1_epi8( 0x7f ) ) );
+	return _mm_movemask_epi8( bad );
+}
+#endif
+
+/*
+** escape_char
+**
+** length of the character at p (len bytes there) if kept as is, 0 if
+** its first byte is escaped, -1 if more bytes are needed to know
+*/
+static int escape_char( const unsigned char *p, size_t len )
+{
+	unsigned char c = p[0];
+	uint32_t cp;
+	int n, k;
+
+	if( c < 0x80 ) {
+		return c == 0x09 || (c >= 0x20 && c != '<' && c != '>' && c != '&' && c != '=' && c != 0x7f);
+	}
+	n = c >= 0xc2 && c <= 0xdf ? 2 : c >= 0xe0 && c <= 0xef ? 3 : c >= 0xf0 && c <= 0xf4 ? 4 : 0;
+	if( !n ) return 0;
+	cp = c & (0x7f >> n);
+	for( k = 1; k < n; k++ ) {
+		if( (size_t) k >= len ) return -1;
+		if( (p[k] & 0xc0) != 0x80 ) return 0;
+		cp = cp << 6 | (p[k] & 0x3f);
+		if( k == 1 && ((c == 0xe0 && p[1] < 0xa0) || (c == 0xed && p[1] >= 0xa0) || // overlong, surrogate
+		               (c == 0xf0 && p[1] < 0x90) || (c == 0xf4 && p[1] >= 0x90)) ) return 0; // overlong, > U+10FFFF
+	}
+	if( cp < 0xa0 || cp == 0x2028 || cp == 0xfffe || cp == 0xffff ) return 0;
+	return n;
+}
+
+static size_t escape_byte( unsigned char b, unsigned char *out )
+{
+	out[0] = '=';
+	if( b < 0x40 ) {
+		out[1] = (unsigned char) (b + 0x40);
+		return 2;
+	}
+	out[1] = (unsigned char) (0xc0 | (0x100 + b) >> 6);
+	out[2] = (unsigned char) (0x80 | (b & 0x3f));
+	return 3;
+}
+
+/*
+** escape_run
+**
+** escape p (len bytes) to out, *out_len bytes; returns the bytes used,
+** all of them if last, else up to an incomplete UTF-8 sequence at the end
+*/
+static size_t escape_run( const unsigned char *p, size_t len, int last, unsigned char *out, size_t *out_len )
+{
+	size_t i = 0, j = 0;
+	int n;
+#ifdef __SSE2__
+	int mask;
+#endif
+
+	while( i < len ) {
+#ifdef __SSE2__
+		if( len - i >= 16 ) { // printable ASCII straight through
+			mask = escape16( p + i );
+			for( n = 0; n < 16 && !(mask & 1); n++, mask >>= 1 ) ;
+			memcpy( out + j, p + i, 16 );
+			i += n;
+			j += n;
+			if( n == 16 ) continue;
+		}
+#endif
+		n = escape_char( p + i, len - i );
+		if( n < 0 && !last ) break;
+		if( n > 0 ) {
+			memcpy( out + j, p + i, n );
+			i += n;
+			j += n;
+		} else {
+			j += escape_byte( p[i++], out + j );
+		}
+	}
+	*out_len = j;
+	return i;
+}
+
+/*
+** basexml_escape_init / update / finish
+**
+** Escape data pushed in pieces of any size. out must hold
+** BASEXML_ESCAPE_UPDATE_MAX( len ) bytes, 12 for finish.
+*/
+void basexml_escape_init( basexml_escaper *e )
+{
+	e->pending_len = 0;
+	e->started = 0;
+}
+
+size_t basexml_escape_update( basexml_escaper *e, const unsigned char *in, size_t len, unsigned char *out )
+{
+	unsigned char tmp[7];
+	size_t i = 0, j = 0, n, used, out_len;
+
+	if( !e->started ) {
+		memcpy( out, BASEXML_ESCAPED_MARKER, 3 );
+		j = 3;
+		e->started = 3;
+	}
+	if( e->pending_len ) { // complete the pending sequence with 3 bytes at most
+		n = len < 3 ? len : 3;
+		memcpy( tmp, e->pending, e->pending_len );
+		memcpy( tmp + e->pending_len, in, n );
+		used = escape_run( tmp, e->pending_len + n, 0, out + j, &out_len );
+		j += out_len;
+		if( used < (size_t) e->pending_len ) { // still incomplete: all of in is in tmp
+			e->pending_len = (int) (e->pending_len + n - used);
+			memcpy( e->pending, tmp + used, e->pending_len );
+			return j;
+		}
+		i = used - e->pending_len;
+		e->pending_len = 0;
+	}
+	i += escape_run( in + i, len - i, 0, out + j, &out_len );
+	j += out_len;
+	e->pending_len = (int) (len - i);
+	memcpy( e->pending, in + i, e->pending_len );
+	return j;
+}
+
+size_t basexml_escape_finish( basexml_escaper *e, unsigned char *out )
+{
+	size_t j = 0, out_len;
+
+	if( !e->started ) { // nothing to escape
+		memcpy( out, BASEXML_ESCAPED_MARKER, 3 );
+		j = 3;
+		e->started = 3;
+	}
+	escape_run( e->pending, e->pending_len, 1, out + j, &out_len );
+	e->pending_len = 0;
+	return j + out_len;
+}
+
+/*
+** unescape_one
+**
+** decode the escape at p (len bytes there) to *out, returns its length,
+** 0 if more bytes are needed, -1 if illegal
+*/
+static int unescape_one( const unsigned char *p, size_t len, unsigned char *out )
+{
+	unsigned int cp;
+
+	if( len < 2 ) return 0;
+	if( p[1] < 0x80 ) {
+		if( p[1] < 0x40 || p[1] == 0x7f ) return -1;
+		*out = (unsigned char) (p[1] - 0x40);
+		return 2;
+	}
+	if( p[1] < 0xc5 || p[1] > 0xc7 ) return -1;
+	if( len < 3 ) return 0;
+	cp = (p[1] & 0x1f) << 6 | (p[2] & 0x3f);
+	if( (p[2] & 0xc0) != 0x80 || cp < 0x17f ) return -1;
+	*out = (unsigned char) (cp - 0x100);
+	return 3;
+}
+
+/*
+** basexml_unescape_init / update / finish
+**
+** Decode escaped data pushed in pieces of any size, marker included.
+** out must hold BASEXML_UNESCAPE_UPDATE_MAX( len ) bytes. Runs without
+** escape are found with memchr, vectorised by the C library.
+*/
+void basexml_unescape_init( basexml_escaper *e )
+{
+	e->pending_len = 0;
+	e->started = 0;
+}
+
+int basexml_unescape_update( basexml_escaper *e, const unsigned char *in, size_t len, unsigned char *out, size_t *out_len )
+{
+	unsigned char tmp[5];
+	const unsigned char *p;
+	size_t i = 0, j = 0, n;
+	int r;
+
+	*out_len = 0;
+	for( ; i < len && e->started < 3; i++ ) { // the marker, maybe in pieces
+		if( in[i] != BASEXML_ESCAPED_MARKER[e->started++] ) return BASEXML_BAD_ESCAPE;
+	}
+	if( e->pending_len && i < len ) { // complete the pending escape
+		n = len - i < 2 ? len - i : 2;
+		memcpy( tmp, e->pending, e->pending_len );
+		memcpy( tmp + e->pending_len, in + i, n );
+		r = unescape_one( tmp, e->pending_len + n, out );
+		if( r < 0 ) return BASEXML_BAD_ESCAPE;
+		if( r == 0 ) { // still incomplete: all of in is in tmp
+			memcpy( e->pending + e->pending_len, in + i, n );
+			e->pending_len += (int) n;
+			return 0;
+		}
+		i += r - e->pending_len;
+		e->pending_len = 0;
+		j = 1;
+	}
+	while( i < len ) {
+		p = (const unsigned char *) memchr( in + i, '=', len - i );
+		n = p ? (size_t) (p - in) - i : len - i;
+		memcpy( out + j, in + i, n );
+		i += n;
+		j += n;
+		if( !p ) break;
+		r = unescape_one( in + i, len - i, out + j );
+		if( r < 0 ) return BASEXML_BAD_ESCAPE;
+		if( r == 0 ) { // at the end of in
+			e->pending_len = (int) (len - i);
+			memcpy( e->pending, in + i, e->pending_len );
+			break;
+		}
+		i += r;
+		j++;
+	}
+	*out_len = j;
+	return 0;
+}
+
+int basexml_unescape_finish( basexml_escaper *e )
+{
+	if( e->started < 3 ) return BASEXML_BAD_ESCAPE;
+	if( e->pending_len ) return BASEXML_UNEXPECTED_END;
+	return 0;
+}
+
+/*
+** Element scanner
+**
+** Pulls the BaseXML elements out of a document in memory (mapped with
+** basexml_map_file for large ones) without parsing it: BaseXML never
+** contains '<', so the content of an element ends at the next '<',
+** searched 16 bytes at a time with SSE2. Comments, CDATA sections and
+** processing instructions are skipped. Elements holding anything else
+** than BaseXML (children, comments) are not taken.
+*/
+#define BASEXML_SCAN_CHUNK  30000 // encoded bytes decoded at once
+#define BASEXML_MAX_THREADS 16
+
+typedef struct basexml_element {
+	int name;            // index in the names given to the scan
+	size_t index;        // order in the document, among the elements found
+	size_t offset;       // of the encoded content in the document
+	size_t enc_len;
+} basexml_element;
+
+// Gets the decoded content of an element in pieces, then len 0 at its
+// end. Called from several threads at once when threads > 1, but each
+// element is decoded by one thread, in order. Returns 0 or an error code.
+typedef int (*basexml_element_fn)( void *ctx, const basexml_element *element, const unsigned char *data, size_t len );
+
+/*
+** basexml_map_file / basexml_unmap_file
+**
+** the content of a file, mapped in memory (read in memory on Windows),
+** NULL on error: errno tells why, nothing is printed
+*/
+const unsigned char *basexml_map_file( const char *path, size_t *len )
+{
+	static const unsigned char empty[1] = { 0 };
+	unsigned char *doc = NULL;
+#ifdef _WIN32
+	FILE *file = fopen( path, "rb" );
+	basexml_off_t size;
+
+	if( file && basexml_fseek( file, 0, SEEK_END ) == 0 && (size = basexml_ftell( file )) >= 0 && basexml_fseek( file, 0, SEEK_SET ) == 0 ) {
+		*len = (size_t) size;
+		doc = (unsigned char *) malloc( *len ? *len : 1 );
+		if( doc && fread( doc, 1, *len, file ) != *len ) {
+			free( doc );
+			doc = NULL;
+		}
+	}
+	if( file ) fclose( file );
+#else
+	struct stat st;
+	int fd = open( path, O_RDONLY );
+
+	if( fd >= 0 && fstat( fd, &st ) == 0 ) {
+		*len = (size_t) st.st_size;
+		if( !*len ) {
+			close( fd );
+			return empty;
+		}
+		doc = (unsigned char *) mmap( NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0 );
+		if( doc == (unsigned char *) MAP_FAILED ) doc = NULL;
+	}
+	if( fd >= 0 ) close( fd );
+#endif
+	(void) empty;
+	return doc;
+}
+
+void basexml_unmap_file( const unsigned char *doc, size_t len )
+{
+#ifdef _WIN32
+	free( (void *) doc );
+	(void) len;
+#else
+	if( len ) munmap( (void *) doc, len );
+#endif
+}
+
+/*
+** find_lt
+**
+** first '<' in [p, end), or end
+*/
+static const unsigned char *find_lt( const unsigned char *p, const unsigned char *end )
+{
+#ifdef __SSE2__
+	const __m128i lt = _mm_set1_epi8( '<' );
+	int mask;
+
+	for( ; end - p >= 16; p += 16 ) {
+		mask = _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i *) p ), lt ) );
+		if( mask ) return p + __builtin_ctz( mask );
+	}
+#endif
+	p = (const unsigned char *) memchr( p, '<', (size_t) (end - p) );
+	return p ? p : end;
+}
+
+/*
+** find_seq
+**
+** first s (n bytes) in [p, end), or end
+*/
+static const unsigned char *find_seq( const unsigned char *p, const unsigned char *end, const char *s, size_t n )
+{
+	for( ; (p = (const unsigned char *) memchr( p, s[0], (size_t) (end - p) )) != NULL; p++ ) {
+		if( (size_t) (end - p) < n ) break;
+		if( !memcmp( p, s, n ) ) return p;
+	}
+	return end;
+}
+
+static int is_space( unsigned char c )
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/*
+** basexml_scan_elements
+**
+** Find the elements named names[0..nnames-1] in the document. *elements
+** is allocated (free() it), *count elements long.
+*/
+int basexml_scan_elements( const unsigned char *doc, size_t len, const char *const *names, int nnames,
+	basexml_element **elements, size_t *count )
+{
+	const unsigned char *end = doc + len, *p = doc, *gt, *content, *close;
+	basexml_element *found = NULL, *grown;
+	size_t allocated = 0, n = 0;
+	int k;
+	char quote;
+
+	*count = 0;
+	while( (p = find_lt( p, end )) < end ) {
+		if( end - p >= 4 && !memcmp( p, "<!--", 4 ) ) { // comment
+			p = find_seq( p + 4, end, "-->", 3 );
+			continue;
+		}
+		if( end - p >= 9 && !memcmp( p, "<![CDATA[", 9 ) ) {
+			p = find_seq( p + 9, end, "]]>", 3 );
+			continue;
+		}
+		if( end - p >= 2 && p[1] == '?' ) { // processing instruction
+			p = find_seq( p + 2, end, "?>", 2 );
+			continue;
+		}
+		for( k = 0; k < nnames; k++ ) {
+			n = strlen( names[k] );
+			if( (size_t) (end - p) > n + 1 && !memcmp( p + 1, names[k], n ) && (p[n + 1] == '>' || p[n + 1] == '/' || is_space( p[n + 1] )) )
+				break;
+		}
+		if( k == nnames ) {
+			p++;
+			continue;
+		}
+
+		for( gt = p + n + 1, quote = 0; gt < end && (quote || *gt != '>'); gt++ ) { // end of the start tag, '>' may be in attributes
+			if( *gt == '"' || *gt == '\'' ) quote = quote == *gt ? 0 : quote ? quote : (char) *gt;
+		}
+		if( gt == end ) break;
+		content = gt + 1;
+		close = gt[-1] == '/' ? content : find_lt( content, end );
+		if( close != content || gt[-1] != '/' ) { // not an empty element: the content must be followed by its end tag
+			const unsigned char *q = close + 2 + n;
+			if( (size_t) (end - close) < n + 3 || close[1] != '/' || memcmp( close + 2, names[k], n ) != 0 ) {
+				p = close; // not BaseXML content
+				continue;
+			}
+			while( q < end && is_space( *q ) ) q++;
+			if( q == end || *q != '>' ) {
+				p = close;
+				continue;
+			}
+		}
+
+		if( *count == allocated ) {
+			allocated = allocated ? allocated * 2 : 64;
+			grown = (basexml_element *) realloc( found, allocated * sizeof( *found ) );
+			if( !grown ) {
+				free( found );
+				return BASEXML_FILE_IO_ERROR;
+			}
+			found = grown;
+		}
+		found[*count].name = k;
+		found[*count].index = *count;
+		found[*count].offset = (size_t) (content - doc);
+		found[*count].enc_len = (size_t) (close - content);
+		(*count)++;
+		p = close > content ? close : content;
+	}
+
+	*elements = found;
+	return 0;
+}
+
+/*
+** decode_element
+**
+** decode the content of an element to fn, in pieces
+*/
+static int decode_element( const unsigned char *doc, const basexml_element *element, basexml_element_fn fn, void *ctx )
+{
+	unsigned char out[BASEXML_DECODE_UPDATE_MAX( BASEXML_SCAN_CHUNK )];
+	const unsigned char *p = doc + element->offset;
+	size_t left = element->enc_len, n, out_len;
+	basexml_decoder dec;
+	int retcode = 0;
+
+	basexml_decoder_init( &dec );
+	for( ; left && !retcode; p += n, left -= n ) {
+		n = left < BASEXML_SCAN_CHUNK ? left : BASEXML_SCAN_CHUNK;
+		retcode = basexml_decoder_update( &dec, p, n, out, &out_len );
+		if( !retcode && out_len ) retcode = fn( ctx, element, out, out_len );
+	}
+	if( !retcode ) retcode = basexml_decoder_finish( &dec, out, &out_len );
+	if( !retcode && out_len ) retcode = fn( ctx, element, out, out_len );
+	if( !retcode ) retcode = fn( ctx, element, out, 0 );
+	return retcode;
+}
+
+typedef struct scan_pool {
+	const unsigned char *doc;
+	const basexml_element *elements;
+	size_t count;
+	size_t next;         // next element to decode
+	basexml_element_fn fn;
+	void *ctx;
+	int retcode;         // first error
+#ifdef BASEXML_WITH_PTHREADS
+	pthread_mutex_t lock;
+#endif
+} scan_pool;
+
+static void *scan_worker( void *arg )
+{
+	scan_pool *pool = (scan_pool *) arg;
+	size_t k;
+	int retcode;
+
+	for( ;; ) {
+#ifdef BASEXML_WITH_PTHREADS
+		pthread_mutex_lock( &pool->lock );
+#endif
+		k = pool->retcode ? pool->count : pool->next++;
+#ifdef BASEXML_WITH_PTHREADS
+		pthread_mutex_unlock( &pool->lock );
+#endif
+		if( k >= pool->count ) break;
+		retcode = decode_element( pool->doc, &pool->elements[k], pool->fn, pool->ctx );
+		if( retcode ) {
+#ifdef BASEXML_WITH_PTHREADS
+			pthread_mutex_lock( &pool->lock );
+#endif
+			if( !pool->retcode ) pool->retcode = retcode;
+#ifdef BASEXML_WITH_PTHREADS
+			pthread_mutex_unlock( &pool->lock );
+#endif
+		}
+	}
+	return NULL;
+}
+
+/*
+** basexml_decode_elements
+**
+** Decode the elements found by basexml_scan_elements to fn, on up to
+** threads threads (with BASEXML_WITH_PTHREADS, else one).
+*/
+int basexml_decode_elements( const unsigned char *doc, const basexml_element *elements, size_t count, int threads,
+	basexml_element_fn fn, void *ctx )
+{
+	scan_pool pool;
+#ifdef BASEXML_WITH_PTHREADS
+	pthread_t thread[BASEXML_MAX_THREADS];
+	int k, started = 0;
+#endif
+
+	pool.doc = doc;
+	pool.elements = elements;
+	pool.count = count;
+	pool.next = 0;
+	pool.fn = fn;
+	pool.ctx = ctx;
+	pool.retcode = 0;
+#ifdef BASEXML_WITH_PTHREADS
+	pthread_mutex_init( &pool.lock, NULL );
+	for( k = 1; k < threads && k < BASEXML_MAX_THREADS && (size_t) k < count; k++ ) {
+		if( pthread_create( &thread[started], NULL, scan_worker, &pool ) == 0 ) started++;
+	}
+	scan_worker( &pool );
+	for( k = 0; k < started; k++ ) {
+		pthread_join( thread[k], NULL );
+	}
+	pthread_mutex_destroy( &pool.lock );
+#else
+	(void) threads;
+	scan_worker( &pool );
+#endif
+	return pool.retcode;
+}
+
+/*
+** basexml_scan
+**
+** basexml_scan_elements then basexml_decode_elements
+*/
+int basexml_scan( const unsigned char *doc, size_t len, const char *const *names, int nnames, int threads,
+	basexml_element_fn fn, void *ctx )
+{
+	basexml_element *elements;
+	size_t count;
+	int retcode = basexml_scan_elements( doc, len, names, nnames, &elements, &count );
+
+	if( !retcode ) {
+		retcode = basexml_decode_elements( doc, elements, count, threads, fn, ctx );
+		free( elements );
+	}
+	return retcode;
+}
+
+#ifdef BASEXML_WITH_EXPAT
+/*
+** Expat adapter
+**
+** Expat hands the text of an element in pieces split anywhere. The
+** adapter decodes each piece as it comes, the streaming decoder carrying
+** the partial group and the possible termination sequence, and hands
+** the decoded bytes of the named elements to fn: memory stays bounded
+** whatever the size of the payloads.
+**   basexml_expat x;
+**   XML_Parser parser = XML_ParserCreate( "UTF-8" );
+**   basexml_expat_attach( &x, parser, names, nnames, fn, ctx );
+**   ... XML_Parse( parser, ... ) ...
+**   if( x.retcode ) ...   // a payload couldn't be decoded (nothing printed)
+** It takes the parser's element and character data handlers, and its
+** user data: set start/end in the basexml_expat to get the elements too.
+*/
+typedef int (*basexml_expat_fn)( void *ctx, const char *name, const unsigned char *data, size_t len ); // len 0: end of the element
+
+typedef struct basexml_expat {
+	XML_Parser parser;
+	const char *const *names;
+	int nnames;
+	basexml_expat_fn fn;
+	void *ctx;
+	XML_StartElementHandler start; // called with ctx as user data
+	XML_EndElementHandler end;
+	int depth;                     // of the open elements
+	int in_payload;                // depth of the named element being decoded, 0: none
+	const char *name;
+	int retcode;                   // first error, stops the parser
+	basexml_decoder dec;
+	unsigned char out[BASEXML_DECODE_UPDATE_MAX( BASEXML_SCAN_CHUNK )];
+} basexml_expat;
+
+static void expat_fail( basexml_expat *x, int retcode )
+{
+	if( !x->retcode ) {
+		x->retcode = retcode;
+		XML_StopParser( x->parser, XML_FALSE );
+	}
+}
+
+static void XMLCALL expat_start( void *data, const XML_Char *name, const XML_Char **atts )
+{
+	basexml_expat *x = (basexml_expat *) data;
+	int k;
+
+	x->depth++;
+	if( x->in_payload ) { // an element inside a payload: not BaseXML
+		expat_fail( x, BASEXML_UNDECODABLE_GROUP );
+		return;
+	}
+	for( k = 0; k < x->nnames; k++ ) {
+		if( !strcmp( name, x->names[k] ) ) {
+			x->in_payload = x->depth;
+			x->name = x->names[k];
+			basexml_decoder_init( &x->dec );
+			break;
+		}
+	}
+	if( x->start ) x->start( x->ctx, name, atts );
+}
+
+static void XMLCALL expat_text( void *data, const XML_Char *s, int len )
+{
+	basexml_expat *x = (basexml_expat *) data;
+	const unsigned char *p = (const unsigned char *) s;
+	size_t left = (size_t) len, n, out_len;
+	int retcode = 0;
+
+	if( !x->in_payload || x->retcode ) return;
+	for( ; left && !retcode; p += n, left -= n ) {
+		n = left < BASEXML_SCAN_CHUNK ? left : BASEXML_SCAN_CHUNK;
+		retcode = basexml_decoder_update( &x->dec, p, n, x->out, &out_len );
+		if( !retcode && out_len ) retcode = x->fn( x->ctx, x->name, x->out, out_len );
+	}
+	if( retcode ) expat_fail( x, retcode );
+}
+
+static void XMLCALL expat_end( void *data, const XML_Char *name )
+{
+	basexml_expat *x = (basexml_expat *) data;
+	size_t out_len;
+	int retcode;
+
+	if( x->in_payload == x->depth && !x->retcode ) {
+		x->in_payload = 0;
+		retcode = basexml_decoder_finish( &x->dec, x->out, &out_len );
+		if( !retcode && out_len ) retcode = x->fn( x->ctx, x->name, x->out, out_len );
+		if( !retcode ) retcode = x->fn( x->ctx, x->name, x->out, 0 );
+		if( retcode ) expat_fail( x, retcode );
+	}
+	x->depth--;
+	if( x->end ) x->end( x->ctx, name );
+}
+
+void basexml_expat_attach( basexml_expat *x, XML_Parser parser, const char *const *names, int nnames, basexml_expat_fn fn, void *ctx )
+{
+	x->parser = parser;
+	x->names = names;
+	x->nnames = nnames;
+	x->fn = fn;
+	x->ctx = ctx;
+	x->start = NULL;
+	x->end = NULL;
+	x->depth = 0;
+	x->in_payload = 0;
+	x->name = NULL;
+	x->retcode = 0;
+	XML_SetUserData( parser, x );
+	XML_SetElementHandler( parser, expat_start, expat_end );
+	XML_SetCharacterDataHandler( parser, expat_text );
+}
+#endif
+
+#ifndef BASEXML_NO_MAIN // the command line, from here to the end of the file
+/*
+** Framed files
+**
+** Frames are read, encoded or decoded, and written in batches of one
+** frame per thread. Built with BASEXML_WITH_PTHREADS (and -lpthread),
+** the frames of a batch are processed in parallel.
+*/
+static uint32_t framed_size = 0; // --framed[=FrameSize], 0: plain BaseXML
+static int threads = 0;          // --threads=N, 0: one per CPU (with pthreads)
+static int auto_mode = 0;        // --auto: plain or compressed, from a sample
+static int stats_mode = 0;       // --stats
+static int xml11_mode = 0;       // -e11/-d11: BaseXML for XML1.1
+static int crc_mode = 0;         // --crc: 1 shows the CRC32C of the raw data, 2 (--crc=HEX) checks it
+static uint32_t crc_expected = 0;
+static uint64_t stats_in = 0, stats_out = 0;
+
+/*
+** crc_result
+**
+** --crc: show crc, the CRC32C of the raw data. --crc=HEX: show it when
+** encoding, check it when decoding (BASEXML_CRC_MISMATCH if it differs)
+*/
+static int crc_result( uint32_t crc, int decoding )
+{
+	if( crc_mode == 1 || (crc_mode == 2 && !decoding) ) {
+		fprintf( stderr, "basexml: crc32c %08lx\n", (unsigned long) crc );
+	}
+	if( crc_mode == 2 && decoding && crc != crc_expected ) {
+		fprintf( stderr, "basexml: crc32c %08lx, expected %08lx\n", (unsigned long) crc, (unsigned long) crc_expected );
+		return BASEXML_CRC_MISMATCH;
+	}
+	return 0;
+}
+
+typedef struct frame_job {
+	unsigned char *in;
+	unsigned char *out;
+	size_t len;        // raw length of the frame
+	size_t out_len;    // encoded length, when encoding
+	uint32_t crc;      // of the raw frame
+	int decode;
+	int retcode;
+} frame_job;
+
+static void *run_frame_job( void *arg )
+{
+	frame_job *job = (frame_job *) arg;
+	basexml_encoder enc;
+
+	if( job->decode ) {
+		job->retcode = decode_frame( job->in, job->len, job->out, &job->crc );
+	} else {
+		job->crc = basexml_crc32c( 0, job->in, job->len );
+		basexml_encoder_init( &enc );
+		job->out_len = basexml_encoder_update( &enc, job->in, job->len, job->out );
+		job->out_len += basexml_encoder_finish( &enc, job->out + job->out_len );
+		job->retcode = 0;
+	}
+	return NULL;
+}
+
+static void run_frame_jobs( frame_job *jobs, int n )
+{
+	int k;
+#ifdef BASEXML_WITH_PTHREADS
+	pthread_t thread[BASEXML_MAX_THREADS];
+	int started[BASEXML_MAX_THREADS];
+
+	for( k = 1; k < n; k++ ) {
+		started[k] = pthread_create( &thread[k], NULL, run_frame_job, &jobs[k] ) == 0;
+	}
+	run_frame_job( &jobs[0] );
+	for( k = 1; k < n; k++ ) {
+		if( started[k] )
+			pthread_join( thread[k], NULL );
+		else // no thread left: do it here
+			run_frame_job( &jobs[k] );
+	}
+#else
+	for( k = 0; k < n; k++ ) {
+		run_frame_job( &jobs[k] );
+	}
+#endif
+}
+
+static int thread_count( void )
+{
+	int n = threads;
+
+#ifdef BASEXML_WITH_PTHREADS
+#ifdef _SC_NPROCESSORS_ONLN
+	if( n <= 0 ) n = (int) sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+#endif
+	if( n <= 0 ) n = 1;
+	return n < BASEXML_MAX_THREADS ? n : BASEXML_MAX_THREADS;
+}
+
+/*
+** read_prefixed
+**
+** fread taking first the *prefix_len bytes already read from infile
+*/
+static size_t read_prefixed( FILE *infile, const unsigned char **prefix, size_t *prefix_len, unsigned char *buf, size_t n )
+{
+	size_t k = *prefix_len < n ? *prefix_len : n;
+
+	memcpy( buf, *prefix, k );
+	*prefix += k;
+	*prefix_len -= k;
+	return k < n ? k + fread( buf + k, 1, n - k, infile ) : k;
+}
+
+/*
+** encode_framed
+**
+** encode a stream (prefix: its first bytes, already read) in frames of
+** frame_size bytes. The total size goes in the header: it is taken from
+** the input when it is seekable, else the header is written again at
+** the end (the output must be seekable then).
+*/
+static int encode_framed( FILE *infile, FILE *outfile, uint32_t frame_size, const unsigned char *prefix, size_t prefix_len )
+{
+	frame_job jobs[BASEXML_MAX_THREADS];
+	unsigned char header[BASEXML_FRAMED_HEADER];
+	unsigned char *buffers, *crcs = NULL, *index, *grown;
+	size_t stride = frame_size + BASEXML_ENCODED_SIZE( frame_size ) + 9, index_len;
+	uint64_t total = 0, expected = 0, count = 0;
+	basexml_off_t start, end, header_pos = -1;
+	uint32_t crc = 0; // of all the raw data, for --crc
+	int n, k, nthreads = thread_count(), last = 0, retcode = 0;
+
+	start = basexml_ftell( infile );
+	if( start >= 0 && basexml_fseek( infile, 0, SEEK_END ) == 0 && (end = basexml_ftell( infile )) >= start &&
+		basexml_fseek( infile, start, SEEK_SET ) == 0 ) {
+		expected = (uint64_t) (end - start) + prefix_len;
+	} else if( (header_pos = basexml_ftell( outfile )) < 0 ) {
+		fprintf( stderr, "basexml: framed encoding needs a seekable input or output\n" );
+		return BASEXML_FILE_IO_ERROR;
+	}
+	buffers = (unsigned char *) malloc( nthreads * stride );
+	if( !buffers ) {
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+
+	framed_header( header, frame_size, expected );
+	fwrite( header, 1, BASEXML_FRAMED_HEADER, outfile );
+	while( !last && !retcode ) {
+		for( n = 0; n < nthreads && !last; n++ ) {
+			jobs[n].in = buffers + n * stride;
+			jobs[n].out = jobs[n].in + frame_size;
+			jobs[n].decode = 0;
+			jobs[n].len = read_prefixed( infile, &prefix, &prefix_len, jobs[n].in, frame_size );
+			last = jobs[n].len < frame_size;
+			if( !jobs[n].len ) break;
+		}
+		run_frame_jobs( jobs, n );
+		grown = (unsigned char *) realloc( crcs, (count + n) * 4 + 1 );
+		if( !grown ) {
+			retcode = BASEXML_FILE_IO_ERROR;
+			break;
+		}
+		crcs = grown;
+		for( k = 0; k < n; k++, count++ ) {
+			fwrite( jobs[k].out, 1, jobs[k].out_len, outfile );
+			stats_out += jobs[k].out_len;
+			if( crc_mode ) crc = basexml_crc32c( crc, jobs[k].in, jobs[k].len );
+			crcs[count * 4] = (unsigned char) jobs[k].crc;
+			crcs[count * 4 + 1] = (unsigned char) (jobs[k].crc >> 8);
+			crcs[count * 4 + 2] = (unsigned char) (jobs[k].crc >> 16);
+			crcs[count * 4 + 3] = (unsigned char) (jobs[k].crc >> 24);
+			total += jobs[k].len;
+		}
+	}
+	free( buffers );
+	if( !retcode && (ferror( infile ) || (header_pos < 0 && total != expected)) ) { // read error, or the input changed meanwhile
+		retcode = BASEXML_FILE_IO_ERROR;
+	}
+
+	if( !retcode ) { // the CRC32C index
+		index = (unsigned char *) malloc( BASEXML_ENCODED_SIZE( count * 4 ) + 9 );
+		if( index ) {
+			basexml_encoder enc;
+			basexml_encoder_init( &enc );
+			index_len = basexml_encoder_update( &enc, crcs, (size_t) count * 4, index );
+			index_len += basexml_encoder_finish( &enc, index + index_len );
+			fwrite( index, 1, index_len, outfile );
+			stats_out += BASEXML_FRAMED_HEADER + index_len;
+			stats_in += total;
+			free( index );
+		} else {
+			retcode = BASEXML_FILE_IO_ERROR;
+		}
+	}
+	free( crcs );
+	if( !retcode && header_pos >= 0 ) { // now that the total size is known
+		framed_header( header, frame_size, total );
+		if( fflush( outfile ) != 0 || basexml_fseek( outfile, header_pos, SEEK_SET ) != 0 ||
+			fwrite( header, 1, BASEXML_FRAMED_HEADER, outfile ) != BASEXML_FRAMED_HEADER || basexml_fseek( outfile, 0, SEEK_END ) != 0 ) {
+			retcode = BASEXML_FILE_IO_ERROR;
+		}
+	}
+	if( retcode ) {
+		perror( basexml_message( retcode ) );
+	} else {
+		crc_result( crc, 0 );
+	}
+	return retcode;
+}
+
+/*
+** decode_framed
+**
+** decode a framed stream (prefix: its first bytes, already read). When
+** the input is seekable, the index is read first and each frame is
+** checked before being written, else the frames are checked at the end.
+*/
+static int decode_framed( FILE *infile, FILE *outfile, const unsigned char *prefix, size_t prefix_len )
+{
+	frame_job jobs[BASEXML_MAX_THREADS];
+	unsigned char header[BASEXML_FRAMED_HEADER], crc[4];
+	unsigned char *buffers = NULL, *index = NULL, *crcs = NULL;
+	size_t stride, index_len = 0, size;
+	uint64_t k = 0, bad = 0, count;
+	basexml_off_t pos;
+	basexml_frame_info info;
+	uint32_t crc_all = 0; // of all the raw data, for --crc
+	int n, j, nthreads = thread_count(), checked = 0, retcode;
+
+	if( read_prefixed( infile, &prefix, &prefix_len, header, BASEXML_FRAMED_HEADER ) != BASEXML_FRAMED_HEADER ||
+		basexml_framed_info( header, BASEXML_FRAMED_HEADER, &info ) ) {
+		perror( basexml_message( BASEXML_BAD_FRAMING ) );
+		return BASEXML_BAD_FRAMING;
+	}
+	count = info.frame_count;
+	stride = BASEXML_ENCODED_SIZE( info.frame_size ) + info.frame_size;
+	index_len = BASEXML_ENCODED_SIZE( count * 4 );
+	buffers = (unsigned char *) malloc( nthreads * stride );
+	index = (unsigned char *) malloc( index_len + 1 );
+	crcs = (unsigned char *) malloc( count * 4 + 1 );
+	if( !buffers || !index || !crcs ) {
+		retcode = BASEXML_FILE_IO_ERROR;
+		goto done;
+	}
+
+	// seekable input: the index first, so that no corrupted frame is written
+	pos = basexml_ftell( infile ) - (basexml_off_t) prefix_len;
+	if( basexml_ftell( infile ) >= 0 && basexml_fseek( infile, pos - BASEXML_FRAMED_HEADER + (basexml_off_t) info.index_offset, SEEK_SET ) == 0 ) {
+		if( fread( index, 1, index_len, infile ) != index_len || basexml_fseek( infile, pos + (basexml_off_t) prefix_len, SEEK_SET ) != 0 ) {
+			retcode = BASEXML_BAD_FRAMING;
+			goto done;
+		}
+		checked = 1;
+	}
+	clearerr( infile );
+	if( checked && (decoded_size_end( index + index_len, index_len, &size ) || size != count * 4) ) {
+		retcode = BASEXML_BAD_FRAMING;
+		goto done;
+	}
+	if( checked ) decode_span( index, 0, (size_t) count * 4, crcs, 0 );
+
+	retcode = 0;
+	while( k < count && !retcode ) {
+		for( n = 0; n < nthreads && k + n < count; n++ ) {
+			jobs[n].in = buffers + n * stride;
+			jobs[n].out = jobs[n].in + BASEXML_ENCODED_SIZE( info.frame_size );
+			jobs[n].decode = 1;
+			jobs[n].len = frame_len( &info, k + n );
+			if( read_prefixed( infile, &prefix, &prefix_len, jobs[n].in, BASEXML_ENCODED_SIZE( jobs[n].len ) ) != BASEXML_ENCODED_SIZE( jobs[n].len ) ) {
+				retcode = BASEXML_UNEXPECTED_END;
+				break;
+			}
+		}
+		run_frame_jobs( jobs, n );
+		for( j = 0; j < n && !retcode; j++, k++ ) {
+			retcode = jobs[j].retcode;
+			if( !retcode && checked && jobs[j].crc != ((uint32_t) crcs[k * 4] | (uint32_t) crcs[k * 4 + 1] << 8 |
+				(uint32_t) crcs[k * 4 + 2] << 16 | (uint32_t) crcs[k * 4 + 3] << 24) ) {
+				fprintf( stderr, "basexml: frame %llu is corrupted\n", (unsigned long long) k );
+				retcode = BASEXML_CRC_MISMATCH;
+			}
+			if( !retcode && !checked ) { // kept to be checked against the index at the end
+				crcs[k * 4] = (unsigned char) jobs[j].crc;
+				crcs[k * 4 + 1] = (unsigned char) (jobs[j].crc >> 8);
+				crcs[k * 4 + 2] = (unsigned char) (jobs[j].crc >> 16);
+				crcs[k * 4 + 3] = (unsigned char) (jobs[j].crc >> 24);
+			}
+			if( !retcode ) fwrite( jobs[j].out, 1, jobs[j].len, outfile );
+			if( !retcode && crc_mode ) crc_all = basexml_crc32c( crc_all, jobs[j].out, jobs[j].len );
+		}
+	}
+
+	if( !retcode && !checked ) { // the index comes last in the stream
+		if( read_prefixed( infile, &prefix, &prefix_len, index, index_len ) != index_len ||
+			decoded_size_end( index + index_len, index_len, &size ) || size != count * 4 ) {
+			retcode = BASEXML_BAD_FRAMING;
+			goto done;
+		}
+		for( k = 0; k < count; k++ ) {
+			decode_span( index + k * 4 / 5 * 6, k * 4 % 5, 4, crc, 0 );
+			if( memcmp( crc, crcs + k * 4, 4 ) != 0 ) {
+				fprintf( stderr, "basexml: frame %llu is corrupted\n", (unsigned long long) k );
+				bad++;
+			}
+		}
+		if( bad ) retcode = BASEXML_CRC_MISMATCH;
+	}
+
+done:
+	free( buffers );
+	free( index );
+	free( crcs );
+	if( retcode ) {
+		perror( basexml_message( retcode ) );
+	} else {
+		retcode = crc_result( crc_all, 1 );
+	}
+	return retcode;
+}
+
+/*
+** Compressed files
+*/
+static int zcodec = 0;  // --zlib[=Level] or --zstd[=Level], 0: not compressed
+static int zlevel = -1;
+
+static int file_sink( void *ctx, const unsigned char *data, size_t len )
+{
+	stats_out += len;
+	return fwrite( data, 1, len, (FILE *) ctx ) == len ? 0 : BASEXML_FILE_IO_ERROR;
+}
+
+static uint32_t sink_crc = 0; // CRC32C of the data written by crc_sink, for --crc
+
+static int crc_sink( void *ctx, const unsigned char *data, size_t len )
+{
+	sink_crc = basexml_crc32c( sink_crc, data, len );
+	return file_sink( ctx, data, len );
+}
+
+/*
+** encode_compressed
+**
+** compress and encode a stream (prefix: its first bytes, already read)
+*/
+static int encode_compressed( FILE *infile, FILE *outfile, const unsigned char *prefix, size_t prefix_len )
+{
+	static basexml_zstream z;
+	static unsigned char in[BASEXML_ZCHUNK];
+	size_t len;
+	uint32_t crc = 0;
+	int retcode = basexml_zencoder_init( &z, zcodec, zlevel, file_sink, outfile );
+
+	z.enc.xml11 = xml11_mode;
+	if( !retcode ) {
+		if( crc_mode ) crc = basexml_crc32c( crc, prefix, prefix_len );
+		retcode = basexml_zencoder_update( &z, prefix, prefix_len );
+		stats_in += prefix_len;
+	}
+	while( !retcode && (len = fread( in, 1, BASEXML_ZCHUNK, infile )) > 0 ) {
+		if( crc_mode ) crc = basexml_crc32c( crc, in, len );
+		retcode = basexml_zencoder_update( &z, in, len );
+		stats_in += len;
+	}
+	if( !retcode && ferror( infile ) ) {
+		retcode = BASEXML_FILE_IO_ERROR;
+	}
+	if( !retcode ) {
+		retcode = basexml_zencoder_finish( &z );
+	}
+	basexml_zstream_end( &z );
+	if( retcode ) {
+		perror( basexml_message( retcode ) );
+	} else {
+		crc_result( crc, 0 );
+	}
+	return retcode;
+}
+
+/*
+** decode_compressed
+**
+** decode and decompress a stream (prefix: its first bytes, already read)
+*/
+static int decode_compressed( FILE *infile, FILE *outfile, const unsigned char *prefix, size_t prefix_len )
+{
+	static basexml_zstream z;
+	static unsigned char in[BASEXML_ZCHUNK];
+	size_t len;
+	int retcode = basexml_zdecoder_init( &z, crc_mode ? crc_sink : file_sink, outfile ); // the sink gets the raw data
+
+	z.dec.xml11 = xml11_mode;
+	if( !retcode ) {
+		retcode = basexml_zdecoder_update( &z, prefix, prefix_len );
+	}
+	while( !retcode && (len = fread( in, 1, BASEXML_ZCHUNK, infile )) > 0 ) {
+		retcode = basexml_zdecoder_update( &z, in, len );
+	}
+	if( !retcode && ferror( infile ) ) {
+		retcode = BASEXML_FILE_IO_ERROR;
+	}
+	if( !retcode ) {
+		retcode = basexml_zdecoder_finish( &z );
+	}
+	basexml_zstream_end( &z );
+	if( retcode ) {
+		perror( basexml_message( retcode ) );
+	} else {
+		retcode = crc_result( sink_crc, 1 );
+	}
+	return retcode;
+}
+
+/*
+** encode_escaped
+**
+** escape a stream instead of encoding it (prefix: its first bytes, already read)
+*/
+static int escape_mode = 0; // --escape
+
+static int encode_escaped( FILE *infile, FILE *outfile, const unsigned char *prefix, size_t prefix_len )
+{
+	static unsigned char in[BASEXML_ZCHUNK];
+	static unsigned char out[BASEXML_ESCAPE_UPDATE_MAX( BASEXML_ZCHUNK )];
+	basexml_escaper e;
+	size_t len, out_len;
+	uint32_t crc = 0;
+
+	basexml_escape_init( &e );
+	while( (len = read_prefixed( infile, &prefix, &prefix_len, in, BASEXML_ZCHUNK )) > 0 ) {
+		if( crc_mode ) crc = basexml_crc32c( crc, in, len );
+		out_len = basexml_escape_update( &e, in, len, out );
+		fwrite( out, 1, out_len, outfile );
+		stats_in += len;
+		stats_out += out_len;
+	}
+	if( ferror( infile ) ) {
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+	out_len = basexml_escape_finish( &e, out );
+	fwrite( out, 1, out_len, outfile );
+	stats_out += out_len;
+	return crc_result( crc, 0 );
+}
+
+/*
+** decode_escaped
+**
+** decode an escaped stream (prefix: its first bytes, already read)
+*/
+static int decode_escaped( FILE *infile, FILE *outfile, const unsigned char *prefix, size_t prefix_len )
+{
+	static unsigned char in[BASEXML_ZCHUNK];
+	static unsigned char out[BASEXML_UNESCAPE_UPDATE_MAX( BASEXML_ZCHUNK )];
+	basexml_escaper e;
+	size_t len, out_len;
+	uint32_t crc = 0;
+	int retcode = 0;
+
+	basexml_unescape_init( &e );
+	while( !retcode && (len = read_prefixed( infile, &prefix, &prefix_len, in, BASEXML_ZCHUNK )) > 0 ) {
+		retcode = basexml_unescape_update( &e, in, len, out, &out_len );
+		fwrite( out, 1, out_len, outfile );
+		if( crc_mode ) crc = basexml_crc32c( crc, out, out_len );
+	}
+	if( !retcode && ferror( infile ) ) {
+		retcode = BASEXML_FILE_IO_ERROR;
+	}
+	if( !retcode ) {
+		retcode = basexml_unescape_finish( &e );
+	}
+	if( retcode ) {
+		perror( basexml_message( retcode ) );
+	} else {
+		retcode = crc_result( crc, 1 );
+	}
+	return retcode;
+}
+
+/*
+** extract
+**
+** decode the elements named in names (comma separated) of a document to
+** files <prefix><name>-<index>.bin, on several threads (pthreads build)
+*/
+#define BASEXML_EXTRACT_NAMES 64
+
+typedef struct extract_files {
+	const char *prefix;
+	const char *const *names;
+	FILE **files;        // per element, open while it is decoded
+} extract_files;
+
+static int extract_fn( void *ctx, const basexml_element *element, const unsigned char *data, size_t len )
+{
+	extract_files *x = (extract_files *) ctx;
+	FILE **file = &x->files[element->index];
+	char path[4096];
+
+	if( !*file ) {
+		snprintf( path, sizeof( path ), "%s%s-%lu.bin", x->prefix, x->names[element->name], (unsigned long) element->index );
+		*file = fopen( path, "wb" );
+		if( !*file ) {
+			perror( path );
+			return BASEXML_FILE_ERROR;
+		}
+	}
+	if( len ) {
+		return fwrite( data, 1, len, *file ) == len ? 0 : BASEXML_FILE_IO_ERROR;
+	}
+	len = fclose( *file ); // end of the element
+	*file = NULL;
+	return len ? BASEXML_ERROR_OUT_CLOSE : 0;
+}
+
+static int extract( const char *docname, char *names_arg, const char *prefix )
+{
+	const char *names[BASEXML_EXTRACT_NAMES];
+	const unsigned char *doc;
+	basexml_element *elements;
+	extract_files x;
+	size_t len, count, k;
+	int nnames = 0, retcode;
+	char *name;
+
+	for( name = strtok( names_arg, "," ); name && nnames < BASEXML_EXTRACT_NAMES; name = strtok( NULL, "," ) ) {
+		names[nnames++] = name;
+	}
+	doc = basexml_map_file( docname, &len );
+	if( !doc ) {
+		perror( docname );
+		return BASEXML_FILE_ERROR;
+	}
+	retcode = basexml_scan_elements( doc, len, names, nnames, &elements, &count );
+	if( !retcode ) {
+		x.prefix = prefix;
+		x.names = names;
+		x.files = (FILE **) calloc( count + 1, sizeof( FILE * ) );
+		if( !x.files ) {
+			retcode = BASEXML_FILE_IO_ERROR;
+			perror( basexml_message( retcode ) );
+		} else {
+			retcode = basexml_decode_elements( doc, elements, count, thread_count(), extract_fn, &x );
+			for( k = 0; k < count; k++ ) { // left open by an error
+				if( x.files[k] ) fclose( x.files[k] );
+			}
+			free( x.files );
+		}
+		free( elements );
+		if( stats_mode ) {
+			fprintf( stderr, "basexml: %lu elements found\n", (unsigned long) count );
+		}
+	}
+	basexml_unmap_file( doc, len );
+	return retcode;
+}
+
+/*
+** encode_chunked
+**
+** encode a stream as <c> elements of chunk_size encoded bytes
+*/
+static size_t chunk_size = 0;    // --chunks=<Size>[:<Name>], 0: one payload
+static const char *chunk_name = "c";
+
+static int encode_chunked( FILE *infile, FILE *outfile )
+{
+	static unsigned char in[BASEXML_ZCHUNK];
+	static unsigned char out[BASEXML_ENCODE_UPDATE_MAX( BASEXML_ZCHUNK )];
+	basexml_chunker ch;
+	basexml_encoder enc;
+	size_t len;
+	int retcode = basexml_chunker_init( &ch, chunk_name, chunk_size, file_sink, outfile );
+
+	basexml_encoder_init( &enc );
+	enc.xml11 = xml11_mode;
+	enc.crc_on = crc_mode != 0;
+	while( !retcode && (len = fread( in, 1, BASEXML_ZCHUNK, infile )) > 0 ) {
+		stats_in += len;
+		retcode = basexml_chunker_write( &ch, out, basexml_encoder_update( &enc, in, len, out ) );
+	}
+	if( !retcode && ferror( infile ) ) {
+		retcode = BASEXML_FILE_IO_ERROR;
+	}
+	if( !retcode ) {
+		retcode = basexml_chunker_write( &ch, out, basexml_encoder_finish( &enc, out ) );
+	}
+	if( !retcode ) {
+		retcode = basexml_chunker_finish( &ch );
+	}
+	if( retcode ) {
+		perror( basexml_message( retcode ) );
+	} else {
+		crc_result( enc.crc, 0 );
+	}
+	return retcode;
+}
+
+/*
+** encode
+**
+** basexml encode a stream
+*/
+#define BASEXML_CHUNK 60000 // multiple of 5 and 6: whole blocks both ways
+
+static int encode_stream( basexml_encoder *enc, FILE *infile, FILE *outfile, const unsigned char *prefix, size_t prefix_len )
+{
+	static unsigned char in[BASEXML_CHUNK];
+	static unsigned char out[BASEXML_ENCODE_UPDATE_MAX(BASEXML_CHUNK)];
+	size_t len, out_len;
+	int retcode = 0;
+
+	enc->crc_on = crc_mode != 0;
+	while( (len = read_prefixed( infile, &prefix, &prefix_len, in, BASEXML_CHUNK )) > 0 ) {
+		out_len = basexml_encoder_update( enc, in, len, out );
+		fwrite( out, 1, out_len, outfile );
+		stats_in += len;
+		stats_out += out_len;
+	}
+	if(ferror( infile )) { // Unexpected file I/O error
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+	out_len = basexml_encoder_finish( enc, out );
+	fwrite( out, 1, out_len, outfile );
+	stats_out += out_len;
+	crc_result( enc->crc, 0 );
+
+	if( ferror( outfile ) ) { // let's handle that out of the stream loop to improve performance. who cares we can't write?
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		retcode = BASEXML_FILE_IO_ERROR;
+	}
+
+    return( retcode );
+}
+
+/*
+** encode_auto
+**
+** sample the input, then encode it plain or compressed. Seekable
+** inputs are sampled at several places, others on their first bytes.
+*/
+#define BASEXML_AUTO_SAMPLE 16384 // bytes per sampled place
+#define BASEXML_AUTO_PLACES 4
+
+static int encode_auto( FILE *infile, FILE *outfile )
+{
+	static unsigned char sample[BASEXML_AUTO_SAMPLE * BASEXML_AUTO_PLACES];
+	basexml_auto_stats stats;
+	basexml_encoder enc;
+	basexml_off_t start = basexml_ftell( infile ), end;
+	size_t len, prefix_len;
+	int k;
+
+	prefix_len = fread( sample, 1, BASEXML_AUTO_SAMPLE, infile ); // the start of the data, kept
+	len = prefix_len;
+	if( prefix_len == BASEXML_AUTO_SAMPLE && start >= 0 && basexml_fseek( infile, 0, SEEK_END ) == 0 &&
+		(end = basexml_ftell( infile )) >= start ) {
+		for( k = 1; k < BASEXML_AUTO_PLACES; k++ ) {
+			if( basexml_fseek( infile, start + (end - start) / BASEXML_AUTO_PLACES * k, SEEK_SET ) == 0 )
+				len += fread( sample + len, 1, BASEXML_AUTO_SAMPLE, infile );
+		}
+		if( basexml_fseek( infile, start + (basexml_off_t) prefix_len, SEEK_SET ) != 0 ) {
+			perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+			return BASEXML_FILE_IO_ERROR;
+		}
+	} else if( prefix_len == BASEXML_AUTO_SAMPLE ) {
+		prefix_len += fread( sample + prefix_len, 1, sizeof( sample ) - prefix_len, infile );
+		len = prefix_len;
+	}
+	if( ferror( infile ) ) {
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+
+	zcodec = basexml_auto_codec( sample, len, &stats );
+	if( stats_mode ) {
+		fprintf( stderr, "basexml: auto: %lu bytes sampled, concentration %.2f (1.00: random), repeats %.1f%%, %s\n",
+			(unsigned long) stats.sampled, stats.concentration, stats.repeats * 100,
+			zcodec == BASEXML_CODEC_ZSTD ? "zstd" : zcodec == BASEXML_CODEC_ZLIB ? "zlib" : "plain" );
+	}
+	if( zcodec ) {
+		return encode_compressed( infile, outfile, sample, prefix_len );
+	}
+	basexml_encoder_init( &enc );
+	enc.xml11 = xml11_mode;
+	return encode_stream( &enc, infile, outfile, sample, prefix_len );
+}
+
+static int encode( FILE *infile, FILE *outfile )
+{
+	basexml_encoder enc;
+	int retcode;
+
+	if( escape_mode ) {
+		retcode = encode_escaped( infile, outfile, NULL, 0 );
+	} else if( auto_mode ) {
+		retcode = encode_auto( infile, outfile );
+	} else if( zcodec ) {
+		retcode = encode_compressed( infile, outfile, NULL, 0 );
+	} else if( chunk_size ) {
+		retcode = encode_chunked( infile, outfile );
+	} else if( framed_size ) {
+		retcode = encode_framed( infile, outfile, framed_size, NULL, 0 );
+	} else {
+		basexml_encoder_init( &enc );
+		enc.xml11 = xml11_mode;
+		retcode = encode_stream( &enc, infile, outfile, NULL, 0 );
+	}
+	if( !retcode && stats_mode ) {
+		fprintf( stderr, "basexml: %llu bytes in, %llu bytes out (%.1f%%)\n", (unsigned long long) stats_in,
+			(unsigned long long) stats_out, stats_in ? stats_out * 100.0 / stats_in : 0.0 );
+	}
+	return retcode;
+}
+
+/*
+** from_base64
+**
+** transcode a Base64 stream to BaseXML
+*/
+static int from_base64( FILE *infile, FILE *outfile )
+{
+	static unsigned char in[BASEXML_CHUNK];
+	static unsigned char out[BASEXML_FROM_BASE64_MAX( BASEXML_CHUNK )];
+	basexml_from64 t;
+	size_t len, out_len;
+	int retcode = 0;
+
+	basexml_from_base64_init( &t );
+	while( !retcode && (len = fread( in, 1, BASEXML_CHUNK, infile )) > 0 ) {
+		retcode = basexml_from_base64_update( &t, in, len, out, &out_len );
+		fwrite( out, 1, out_len, outfile );
+	}
+	if( !retcode && ferror( infile ) ) {
+		retcode = BASEXML_FILE_IO_ERROR;
+	}
+	if( !retcode ) {
+		retcode = basexml_from_base64_finish( &t, out, &out_len );
+		fwrite( out, 1, out_len, outfile );
+	}
+	if( retcode ) {
+		perror( basexml_message( retcode ) );
+	}
+	return retcode;
+}
+
+/*
+** to_base64
+**
+** transcode a BaseXML stream to Base64, in lines of wrap characters
+*/
+static size_t base64_wrap = 0; // --to-base64=WRAP
+
+static int to_base64( FILE *infile, FILE *outfile )
+{
+	static unsigned char in[BASEXML_CHUNK];
+	static unsigned char out[BASEXML_TO_BASE64_MAX( BASEXML_CHUNK, 1 )];
+	basexml_to64 t;
+	size_t len, out_len;
+	int retcode = 0;
+
+	basexml_to_base64_init( &t, base64_wrap );
+	while( !retcode && (len = fread( in, 1, BASEXML_CHUNK, infile )) > 0 ) {
+		retcode = basexml_to_base64_update( &t, in, len, out, &out_len );
+		fwrite( out, 1, out_len, outfile );
+	}
+	if( !retcode && ferror( infile ) ) {
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+	if( !retcode ) {
+		retcode = basexml_to_base64_finish( &t, out, &out_len );
+		fwrite( out, 1, out_len, outfile );
+	}
+	if( retcode ) {
+		perror( basexml_message( retcode ) );
+	}
+	return retcode;
+}
+
+/*
+** decode
+**
+** decode a basexml encoded stream
+*/
+static int decode( FILE *infile, FILE *outfile )
+{
+	static unsigned char in[BASEXML_CHUNK];
+	static unsigned char out[BASEXML_DECODE_UPDATE_MAX(BASEXML_CHUNK)];
+	basexml_decoder dec;
+	basexml_unchunker un;
+	size_t len, out_len;
+	int retcode = 0, chunked;
+
+	basexml_decoder_init( &dec );
+	dec.crc_on = crc_mode != 0;
+	dec.xml11 = xml11_mode;
+	len = fread( in, 1, BASEXML_CHUNK, infile );
+	chunked = len && in[0] == '<'; // <c> elements, see encode_chunked: '<' is never in BaseXML
+	basexml_unchunker_init( &un, chunk_name );
+	if( len >= 3 && !memcmp( in, BASEXML_FRAMED_MARKER, 3 ) ) { // framed data, see basexml_encode_framed
+		return decode_framed( infile, outfile, in, len );
+	}
+	if( len >= 3 && !memcmp( in, BASEXML_COMPRESSED_MARKER, 3 ) ) { // compressed data, see basexml_zencoder_init
+		return decode_compressed( infile, outfile, in, len );
+	}
+	if( len >= 3 && !memcmp( in, BASEXML_ESCAPED_MARKER, 3 ) ) { // escaped data, see basexml_escape_init
+		return decode_escaped( infile, outfile, in, len );
+	}
+	for( ; !retcode && len > 0; len = fread( in, 1, BASEXML_CHUNK, infile ) ) {
+		if( chunked ) len = basexml_unchunk( &un, in, len, in );
+		retcode = basexml_decoder_update( &dec, in, len, out, &out_len );
+		fwrite( out, 1, out_len, outfile );
+	}
+	if( !retcode && ferror( infile ) ) { // Unexpected file I/O error
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+	if( !retcode ) {
+		retcode = basexml_decoder_finish( &dec, out, &out_len );
+		fwrite( out, 1, out_len, outfile );
+	}
+	if( retcode ) {
+		perror( basexml_message( retcode ) );
+	}
+	if( !retcode ) {
+		retcode = crc_result( dec.crc, 1 );
+	}
+
+	if( ferror( outfile ) ) { // let's handle that out of the stream loop to improve performance
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		retcode = BASEXML_FILE_IO_ERROR;
+	}
+
+    return( retcode );
+}
+
+/*
+** payload_size
+**
+** encoded length of the payload found at start in file (up to the end
+** of the file if enc_len is -1), and its decoded size from its last 3
+** bytes. After the ?X? marker, *start and *enc_len are moved past it
+** and *xml11 is set: the groups are BaseXML for XML1.1.
+*/
+static int payload_size( FILE *file, basexml_off_t *start, basexml_off_t *enc_len, size_t *size, int *xml11 )
+{
+	unsigned char head[3] = { 0, 0, 0 }, tail[3] = { 0, 0, 0 };
+	size_t skip;
+	int retcode;
+
+	if( *enc_len < 0 && (basexml_fseek( file, 0, SEEK_END ) != 0 || (*enc_len = basexml_ftell( file ) - *start) < 0) ) {
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+	if( *enc_len >= 3 && (basexml_fseek( file, *start, SEEK_SET ) != 0 || fread( head, 1, 3, file ) != 3 ||
+		basexml_fseek( file, *start + *enc_len - 3, SEEK_SET ) != 0 || fread( tail, 1, 3, file ) != 3) ) {
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+	retcode = plain_start( head, (size_t) *enc_len, &skip, xml11 );
+	if( !retcode ) {
+		*start += (basexml_off_t) skip;
+		*enc_len -= (basexml_off_t) skip;
+		retcode = decoded_size_end( tail + 3, (size_t) *enc_len, size );
+	}
+	if( retcode ) {
+		perror( basexml_message( retcode ) );
+	}
+	return retcode;
+}
+
+/*
+** decode_range
+**
+** decode bytes [offset, offset+length) of the basexml payload at start
+** in infile (enc_len bytes, -1 up to the end), seeking to the blocks
+** covering them (the input must be seekable)
+*/
+static int decode_range( FILE *infile, FILE *outfile, basexml_off_t start, basexml_off_t enc_len, size_t offset, size_t length )
+{
+	static unsigned char in[BASEXML_CHUNK];
+	static unsigned char out[BASEXML_CHUNK / 6 * 5];
+	size_t size, skip, groups, n;
+	int xml11, retcode = payload_size( infile, &start, &enc_len, &size, &xml11 );
+
+	if( retcode ) {
+		return retcode;
+	}
+	if( offset > size || length > size - offset ) {
+		perror( basexml_message( BASEXML_OUT_OF_RANGE ) );
+		return BASEXML_OUT_OF_RANGE;
+	}
+	if( basexml_fseek( infile, start + (basexml_off_t) (offset / 5 * 6), SEEK_SET ) != 0 ) {
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+
+	skip = offset % 5;
+	while( length ) {
+		groups = (skip + length + 4) / 5;
+		if( groups > BASEXML_CHUNK / 6 ) groups = BASEXML_CHUNK / 6;
+		if( fread( in, 6, groups, infile ) != groups ) {
+			perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+			return BASEXML_FILE_IO_ERROR;
+		}
+		n = groups * 5 - skip < length ? groups * 5 - skip : length;
+		decode_span( in, skip, n, out, xml11 );
+		fwrite( out, 1, n, outfile );
+		length -= n;
+		skip = 0;
+	}
+
+	return 0;
+}
+
+/*
+** patch
+**
+** overwrite the decoded bytes from offset of the basexml payload at start
+** in encfile (enc_len bytes, -1 up to the end) with the content of
+** patchfile, rewriting only the groups covering them
+*/
+static int patch( FILE *patchfile, FILE *encfile, basexml_off_t start, basexml_off_t enc_len, size_t offset )
+{
+	static unsigned char data[BASEXML_CHUNK / 6 * 5];
+	static unsigned char groups[BASEXML_CHUNK + 3];
+	size_t size, n, group_len;
+	int last_len, xml11;
+	int retcode = payload_size( encfile, &start, &enc_len, &size, &xml11 );
+
+	if( retcode ) {
+		return retcode;
+	}
+	// after the first piece, pieces start on a block: each block is rewritten once
+	while( (n = fread( data, 1, sizeof( data ) - offset % 5, patchfile )) > 0 ) {
+		if( offset > size || n > size - offset ) {
+			perror( basexml_message( BASEXML_OUT_OF_RANGE ) );
+			return BASEXML_OUT_OF_RANGE;
+		}
+		last_len = patch_last_len( size, offset, n );
+		group_len = ((offset + n - 1) / 5 - offset / 5 + 1) * 6 + (last_len > 2 && last_len < 5 ? 3 : 0);
+		if( basexml_fseek( encfile, start + (basexml_off_t) (offset / 5 * 6), SEEK_SET ) != 0 ||
+			fread( groups, 1, group_len, encfile ) != group_len ) {
+			perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+			return BASEXML_FILE_IO_ERROR;
+		}
+		patch_span( groups, offset % 5, data, n, last_len, xml11 );
+		if( basexml_fseek( encfile, start + (basexml_off_t) (offset / 5 * 6), SEEK_SET ) != 0 ||
+			fwrite( groups, 1, group_len, encfile ) != group_len ) {
+			perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+			return BASEXML_FILE_IO_ERROR;
+		}
+		offset += n;
+	}
+	if( ferror( patchfile ) ) {
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+
+	return 0;
+}
+
+/*
+** append
+**
+** append the content of infile to the basexml encoded outfile: its
+** final partial block is decoded, the old tail truncated, and the
+** encoding resumes from there with the new data
+*/
+static int append( FILE *infile, FILE *outfile )
+{
+	unsigned char tail[12] = BASEXML_XML11_MARKER; // the marker, then the tail read after it when the data has one
+	basexml_encoder enc;
+	basexml_off_t start = 0, enc_len = -1, keep;
+	size_t size, head, tail_len, tail_keep;
+	int xml11, retcode = payload_size( outfile, &start, &enc_len, &size, &xml11 );
+
+	if( retcode ) {
+		return retcode;
+	}
+	keep = start + (basexml_off_t) (size / 5 * 6);
+	tail_len = (size_t) (start + enc_len - keep); // 0, 6 or 9 bytes
+	head = xml11 ? 3 : 0; // the encoder resumes from the marker and the tail: it goes on as BaseXML for XML1.1
+	if( basexml_fseek( outfile, keep, SEEK_SET ) != 0 || fread( tail + head, 1, tail_len, outfile ) != tail_len ) {
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+	retcode = basexml_encoder_resume( &enc, tail, head + tail_len, &tail_keep );
+	if( retcode ) {
+		return retcode;
+	}
+	if( fflush( outfile ) != 0 || basexml_truncate( outfile, keep ) != 0 || basexml_fseek( outfile, keep, SEEK_SET ) != 0 ) {
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+
+	return encode_stream( &enc, infile, outfile, NULL, 0 );
+}
+
+/*
+** validate_payload
+**
+** check enc_len bytes (-1: up to the end) of plain BaseXML, the rest of
+** a stream (prefix: its next bytes, already read) starting at offset
+** start, through un when it is chunked (offsets are then in the text
+** of the chunks). After the ?X? marker, it is BaseXML for XML1.1.
+*/
+static int validate_payload( FILE *infile, const unsigned char **prefix, size_t *prefix_len, basexml_off_t start,
+                             basexml_off_t enc_len, basexml_unchunker *un )
+{
+	static unsigned char in[BASEXML_CHUNK + 6];
+	size_t carry = 0, len, n, bad, data_len, want = BASEXML_CHUNK;
+	basexml_off_t base = 0; // offset of in[0] in the payload
+	int retcode, checked = 0, xml11 = 0;
+
+	while( (enc_len < 0 || (want = enc_len < BASEXML_CHUNK ? (size_t) enc_len : BASEXML_CHUNK) > 0) &&
+	       (len = read_prefixed( infile, prefix, prefix_len, in + carry, want )) > 0 ) {
+		if( enc_len >= 0 ) enc_len -= (basexml_off_t) len;
+		if( un ) len = basexml_unchunk( un, in + carry, len, in + carry );
+		len += carry;
+		if( !checked && len >= 3 ) {
+			checked = 1;
+			if( !memcmp( in, BASEXML_XML11_MARKER, 3 ) ) {
+				xml11 = 1;
+				len -= 3;
+				memmove( in, in + 3, len );
+				start += 3;
+			}
+		}
+		n = len > 3 ? (len - 3) / 3 * 3 : 0; // the last 3 bytes may be a termination sequence
+		bad = validate_groups( in, n, xml11 );
+		if( bad < n ) {
+			fprintf( stderr, "basexml: bad group at offset %lld\n", (long long) (start + base + bad) );
+			return BASEXML_UNDECODABLE_GROUP;
+		}
+		carry = len - n;
+		memmove( in, in + n, carry );
+		base += n;
+	}
+	if( ferror( infile ) ) {
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+	if( enc_len > 0 ) {
+		fprintf( stderr, "basexml: bad end at offset %lld\n", (long long) (start + base + carry) );
+		return BASEXML_UNEXPECTED_END;
+	}
+
+	retcode = validate_tail( in + carry, (size_t) base + carry, &data_len );
+	if( data_len > (size_t) base ) {
+		bad = validate_groups( in, data_len - (size_t) base, xml11 );
+		if( bad < data_len - (size_t) base ) {
+			fprintf( stderr, "basexml: bad group at offset %lld\n", (long long) (start + base + bad) );
+			return BASEXML_UNDECODABLE_GROUP;
+		}
+	}
+	if( retcode ) {
+		fprintf( stderr, "basexml: bad end at offset %lld\n", (long long) (start + data_len) );
+	}
+	return retcode;
+}
+
+/*
+** validate_escaped
+**
+** check escaped data (prefix: its first bytes, already read, marker
+** included): only the characters and escapes basexml_escape_update writes
+*/
+static int validate_escaped( FILE *infile, const unsigned char *prefix, size_t prefix_len )
+{
+	static unsigned char in[BASEXML_ZCHUNK + 4];
+	unsigned char byte;
+	size_t carry = 0, len, i = 3; // after the marker
+	basexml_off_t base = 0;       // offset of in[0]
+	int n, more, last;
+
+	for( ;; ) {
+		len = read_prefixed( infile, &prefix, &prefix_len, in + carry, BASEXML_ZCHUNK );
+		last = len == 0;
+		len += carry;
+		while( i < len ) {
+			if( in[i] == '=' ) {
+				n = unescape_one( in + i, len - i, &byte );
+				more = n == 0;
+			} else {
+				n = escape_char( in + i, len - i );
+				more = n < 0;
+			}
+			if( n > 0 ) {
+				i += n;
+			} else if( more && !last ) { // cut by the end of in
+				break;
+			} else {
+				fprintf( stderr, "basexml: bad escape at offset %lld\n", (long long) (base + i) );
+				return BASEXML_BAD_ESCAPE;
+			}
+		}
+		if( last ) break;
+		carry = len - i;
+		memmove( in, in + i, carry );
+		base += i;
+		i = 0;
+	}
+	if( ferror( infile ) ) {
+		perror( basexml_message( BASEXML_FILE_IO_ERROR ) );
+		return BASEXML_FILE_IO_ERROR;
+	}
+	return 0;
+}
+
+/*
+** validate
+**
+** check a basexml encoded stream without decoding it, reporting the
+** offset of the first bad byte. The containers decode detects are
+** checked too: the header, frames and index of framed data, the
+** BaseXML after the codec byte of compressed data (the compressed
+** stream itself isn't), escaped data and <c> chunks.
+*/
+static int validate( FILE *infile )
+{
+	unsigned char head[BASEXML_FRAMED_HEADER];
+	const unsigned char *prefix = head;
+	size_t prefix_len = fread( head, 1, BASEXML_FRAMED_HEADER, infile );
+	basexml_unchunker un;
+	basexml_frame_info info;
+	int retcode;
+
+	if( prefix_len >= 3 && !memcmp( head, BASEXML_FRAMED_MARKER, 3 ) ) { // see basexml_encode_framed
+		if( basexml_framed_info( head, prefix_len, &info ) || validate_groups( head + 3, 18, 0 ) < 18 ) {
+			perror( basexml_message( BASEXML_BAD_FRAMING ) );
+			return BASEXML_BAD_FRAMING;
+		}
+		prefix_len = 0;
+		retcode = validate_payload( infile, &prefix, &prefix_len, BASEXML_FRAMED_HEADER,
+		                            (basexml_off_t) BASEXML_ENCODED_SIZE( info.total_size ), NULL ); // the frames make one payload
+		if( !retcode ) {
+			retcode = validate_payload( infile, &prefix, &prefix_len, (basexml_off_t) info.index_offset,
+			                            (basexml_off_t) BASEXML_ENCODED_SIZE( info.frame_count * 4 ), NULL );
+		}
+		if( !retcode && fgetc( infile ) != EOF ) {
+			fprintf( stderr, "basexml: bad end at offset %lld\n",
+			         (long long) (info.index_offset + BASEXML_ENCODED_SIZE( info.frame_count * 4 )) );
+			retcode = BASEXML_BAD_FRAMING;
+		}
+		return retcode;
+	}
+	if( prefix_len >= 3 && !memcmp( head, BASEXML_COMPRESSED_MARKER, 3 ) ) { // see basexml_zencoder_init
+		if( prefix_len < 4 || (head[3] != BASEXML_CODEC_ZLIB && head[3] != BASEXML_CODEC_ZSTD) ) {
+			perror( basexml_message( BASEXML_BAD_CODEC ) );
+			return BASEXML_BAD_CODEC;
+		}
+		prefix += 4;
+		prefix_len -= 4;
+		return validate_payload( infile, &prefix, &prefix_len, 4, -1, NULL );
+	}
+	if( prefix_len >= 3 && !memcmp( head, BASEXML_ESCAPED_MARKER, 3 ) ) { // see basexml_escape_init
+		return validate_escaped( infile, prefix, prefix_len );
+	}
+	basexml_unchunker_init( &un, chunk_name );
+	return validate_payload( infile, &prefix, &prefix_len, 0, -1, prefix_len && head[0] == '<' ? &un : NULL );
+}
+
+/*
+** basexml
+**
+** 'engine' that opens streams and calls encode/decode
+*/
+
+static size_t range_offset = 0, range_length = 0; // --range OFF:LEN, --patch OFF
+static size_t element_start = 0, element_length = 0; // --element START:LEN
+static int element_set = 0;                           // else the payload is the whole file
+
+static int basexml( char opt, char *infilename, char *outfilename )
+{
+    FILE *infile;
+    int retcode = BASEXML_FILE_ERROR;
+
+    if( !infilename ) {
+        infile = stdin;
+    }
+    else {
+        infile = fopen( infilename, "rb" );
     }
     if( !infile ) {
         perror( infilename );
@@ -658,7 +5105,10 @@ static int basexml( char opt, char *infilename, char *outfilename )
             outfile = stdout;
         }
         else {
-            outfile = fopen( outfilename, "wb" );
+            outfile = fopen( outfilename, opt == 'p' || opt == 'a' ? "r+b" : "wb" ); // patches are written in place
+            if( !outfile && opt == 'a' ) { // appending to nothing yet
+                outfile = fopen( outfilename, "w+b" );
+            }
         }
         if( !outfile ) {
             perror( outfilename );
@@ -667,6 +5117,26 @@ static int basexml( char opt, char *infilename, char *outfilename )
             if( opt == 'e' ) {
                 retcode = encode( infile, outfile );
             }
+            else if( opt == 'r' ) {
+                retcode = decode_range( infile, outfile, (basexml_off_t) element_start,
+                                        element_set ? (basexml_off_t) element_length : -1, range_offset, range_length );
+            }
+            else if( opt == 'v' ) {
+                retcode = validate( infile );
+            }
+            else if( opt == 'f' ) {
+                retcode = from_base64( infile, outfile );
+            }
+            else if( opt == 't' ) {
+                retcode = to_base64( infile, outfile );
+            }
+            else if( opt == 'a' ) {
+                retcode = append( infile, outfile );
+            }
+            else if( opt == 'p' ) {
+                retcode = patch( infile, outfile, (basexml_off_t) element_start,
+                                 element_set ? (basexml_off_t) element_length : -1, range_offset );
+            }
             else {
                 retcode = decode( infile, outfile );
             }
@@ -702,10 +5172,49 @@ static int basexml( char opt, char *infilename, char *outfilename )
 static void showuse( )
 {
 	printf( "\n" );
-	printf( "  basexml11  (BaseXML for XML1.1)    KrisWebDev   06/2013\n" );
+	printf( "  basexml10  (BaseXML for XML1.0)    KrisWebDev   06/2013\n" );
 	printf( "  Usage:\n");
-	printf( "    Encode:  basexml11 -e <FileIn> [<FileOut>]\n" );
-	printf( "    Decode:  basexml11 -d <FileIn> [<FileOut>]\n" );
+	printf( "    Encode:  basexml10 -e <FileIn> [<FileOut>]\n" );
+	printf( "    Decode:  basexml10 -d <FileIn> [<FileOut>]\n" );
+	printf( "    XML1.1:  basexml10 -e11 / -d11 <FileIn> [<FileOut>]\n" );
+	printf( "             (BaseXML for XML1.1, for XML 1.1 documents: it starts with\n" );
+	printf( "             the ?X? marker, which -d, -v, -a, --range and\n" );
+	printf( "             --patch detect)\n" );
+	printf( "    Range:   basexml10 --range <Offset>:<Length> <FileIn> [<FileOut>]\n" );
+	printf( "             (decodes only the bytes <Offset> to <Offset>+<Length>-1)\n" );
+	printf( "    Base64:  basexml10 --from-base64 <FileIn> [<FileOut>]\n" );
+	printf( "             (transcodes Base64 to BaseXML)\n" );
+	printf( "             basexml10 --to-base64[=<Wrap>] <FileIn> [<FileOut>]\n" );
+	printf( "             (transcodes BaseXML to Base64, in lines of <Wrap> chars)\n" );
+	printf( "    Check:   basexml10 -v <FileIn>\n" );
+	printf( "             (checks encoded data without decoding it)\n" );
+	printf( "    Append:  basexml10 -a [<FileIn>] <EncodedFile>\n" );
+	printf( "             (encodes <FileIn> at the end of <EncodedFile>)\n" );
+	printf( "    Patch:   basexml10 --patch <Offset> <PatchFile> <EncodedFile>\n" );
+	printf( "             (overwrites the decoded bytes from <Offset> in place)\n" );
+	printf( "    Extract: basexml10 --extract <Name>[,<Name>...] <Document> [<OutPrefix>]\n" );
+	printf( "             (decodes each <Name> element of an XML document to\n" );
+	printf( "             <OutPrefix><Name>-<Index>.bin)\n" );
+	printf( "    Options: --crc with -e, -d or -a shows the CRC32C of the raw data,\n" );
+	printf( "             --crc=<Hex> with -d checks it\n" );
+	printf( "             --framed[=<FrameSize>] with -e cuts the data into frames\n" );
+	printf( "             (1MB by default) checked by CRC32C, -d detects them;\n" );
+	printf( "             --threads=<N> processes N frames at once (pthreads build)\n" );
+	printf( "             --zlib[=<Level>] or --zstd[=<Level>] with -e compresses\n" );
+	printf( "             the data first (zlib/zstd build, Level 0-9/0-22, not with\n" );
+	printf( "             --framed), -d detects it\n" );
+	printf( "             --escape with -e keeps the bytes that can be in XML text\n" );
+	printf( "             and escapes the others (for text, alone: not with -e11\n" );
+	printf( "             or another mode), -d detects it\n" );
+	printf( "             --auto with -e compresses the data only when a sample\n" );
+	printf( "             of it is compressible (not with --zlib/--zstd/--framed),\n" );
+	printf( "             --stats shows the sizes\n" );
+	printf( "             --chunks=<Size>[:<Name>] with -e writes <c> elements of\n" );
+	printf( "             <Size> encoded bytes each, -d detects them (even\n" );
+	printf( "             in a document, give the same :<Name> if not c; plain\n" );
+	printf( "             BaseXML only: not with --zlib/--zstd/--auto/--framed)\n" );
+	printf( "             --element <Start>:<Length> before --range or --patch when\n" );
+	printf( "             the encoded data is only a part of <FileIn>/<EncodedFile>\n" );
 	printf( "  Purpose:   This program is a simple utility that encodes\n" );
 	printf( "             and decodes files to BaseXML format.\n" );
 	printf( "  Returns:   0 = Success.  Non-zero is an error code.\n" );
@@ -714,6 +5223,44 @@ static void showuse( )
 
 #define THIS_OPT(ac, av) ((char)(ac > 1 ? av[1][0] == '-' ? av[1][1] : 0 : 0))
 
+/*
+** parse_hex32
+**
+** parse an 8-digit hexadecimal CRC, returns 0 if malformed
+*/
+static int parse_hex32( const char *arg, uint32_t *value )
+{
+	char *end;
+
+	*value = (uint32_t) strtoul( arg, &end, 16 );
+	return end != arg && *end == '\0' && end - arg <= 8;
+}
+
+/*
+** parse_offset / parse_range
+**
+** parse <Offset> or <Offset>:<Length>, returns 0 if malformed
+*/
+static int parse_offset( const char *arg, size_t *offset )
+{
+	char *end;
+
+	*offset = (size_t) strtoull( arg, &end, 10 );
+	return end != arg && *end == '\0';
+}
+
+static int parse_range( const char *arg, size_t *offset, size_t *length )
+{
+	char *end;
+
+	*offset = (size_t) strtoull( arg, &end, 10 );
+	if( end == arg || *end != ':' )
+		return 0;
+	arg = end + 1;
+	*length = (size_t) strtoull( arg, &end, 10 );
+	return end != arg && *end == '\0';
+}
+
 /*
 ** main
 **
@@ -724,17 +5271,100 @@ int main( int argc, char **argv )
     char opt = (char) 0;
     int retcode = 0;
     char *infilename = NULL, *outfilename = NULL;
+    size_t frame_arg;
+    char *extract_names = NULL;
+    int syntax_error = 0; // a bad option or value, whatever -e/-d comes after it
 
     while( THIS_OPT( argc, argv ) != (char) 0 ) {
         switch( THIS_OPT(argc, argv) ) {
             case '?':
 			case 'h':
+            case 'a':
+            case 'v':
+                    opt = THIS_OPT(argc, argv);
+                    break;
             case 'e':
             case 'd':
                     opt = THIS_OPT(argc, argv);
+                    xml11_mode = !strcmp( argv[1] + 2, "11" ); // -e11/-d11
+                    break;
+            case '-': // long options
+                    if( !strcmp( argv[1], "--range" ) && argc > 2 && parse_range( argv[2], &range_offset, &range_length ) ) {
+                        opt = 'r';
+                        argv++;
+                        argc--;
+                    }
+                    else if( !strcmp( argv[1], "--patch" ) && argc > 2 && parse_offset( argv[2], &range_offset ) ) {
+                        opt = 'p';
+                        argv++;
+                        argc--;
+                    }
+                    else if( !strcmp( argv[1], "--from-base64" ) ) {
+                        opt = 'f';
+                    }
+                    else if( !strcmp( argv[1], "--to-base64" ) ) {
+                        opt = 't';
+                    }
+                    else if( !strncmp( argv[1], "--to-base64=", 12 ) && parse_offset( argv[1] + 12, &base64_wrap ) ) {
+                        opt = 't';
+                    }
+                    else if( !strcmp( argv[1], "--crc" ) ) {
+                        crc_mode = 1;
+                    }
+                    else if( !strncmp( argv[1], "--crc=", 6 ) && parse_hex32( argv[1] + 6, &crc_expected ) ) {
+                        crc_mode = 2;
+                    }
+                    else if( !strcmp( argv[1], "--framed" ) ) {
+                        framed_size = BASEXML_FRAME_SIZE_DEFAULT;
+                    }
+                    else if( !strncmp( argv[1], "--framed=", 9 ) && parse_offset( argv[1] + 9, &frame_arg ) && frame_arg >= 5 && frame_arg <= 0xffffffff ) {
+                        framed_size = (uint32_t) (frame_arg / 5 * 5); // whole blocks
+                    }
+                    else if( !strncmp( argv[1], "--zlib", 6 ) || !strncmp( argv[1], "--zstd", 6 ) ) {
+                        zcodec = argv[1][3] == 'l' ? BASEXML_CODEC_ZLIB : BASEXML_CODEC_ZSTD;
+                        if( argv[1][6] == '=' && parse_offset( argv[1] + 7, &frame_arg ) && frame_arg <= BASEXML_CODEC_MAX_LEVEL( zcodec ) )
+                            zlevel = (int) frame_arg;
+                        else if( argv[1][6] != '\0' )
+                            syntax_error = 1;
+                    }
+                    else if( !strcmp( argv[1], "--escape" ) ) {
+                        escape_mode = 1;
+                    }
+                    else if( !strcmp( argv[1], "--auto" ) ) {
+                        auto_mode = 1;
+                    }
+                    else if( !strcmp( argv[1], "--stats" ) ) {
+                        stats_mode = 1;
+                    }
+                    else if( !strncmp( argv[1], "--chunks=", 9 ) ) {
+                        char *name = strchr( argv[1] + 9, ':' );
+                        if( name ) *name++ = '\0';
+                        if( parse_offset( argv[1] + 9, &chunk_size ) && chunk_size && (!name || (*name && strlen( name ) <= BASEXML_CHUNK_NAME)) ) {
+                            if( name ) chunk_name = name;
+                        }
+                        else
+                            syntax_error = 1;
+                    }
+                    else if( !strncmp( argv[1], "--threads=", 10 ) && parse_offset( argv[1] + 10, &frame_arg ) ) {
+                        threads = (int) (frame_arg < BASEXML_MAX_THREADS ? frame_arg : BASEXML_MAX_THREADS);
+                    }
+                    else if( !strcmp( argv[1], "--extract" ) && argc > 2 ) {
+                        opt = 'x';
+                        extract_names = argv[2];
+                        argv++;
+                        argc--;
+                    }
+                    else if( !strcmp( argv[1], "--element" ) && argc > 2 && parse_range( argv[2], &element_start, &element_length ) ) {
+                        element_set = 1;
+                        argv++;
+                        argc--;
+                    }
+                    else {
+                        syntax_error = 1;
+                    }
                     break;
              default:
-                    opt = (char) 0;
+                    syntax_error = 1;
                     break;
         }
         argv++;
@@ -744,15 +5374,64 @@ int main( int argc, char **argv )
         fprintf(stderr, "%s\n", basexml_message( BASEXML_SYNTAX_TOOMANYARGS ) );
         opt = (char) 0;
     }
+    if( xml11_mode && framed_size ) { // frames are XML1.0 only
+        syntax_error = 1;
+    }
+    if( zcodec && framed_size ) { // compressed data isn't cut into frames
+        syntax_error = 1;
+    }
+    if( auto_mode && (zcodec || framed_size) ) { // --auto picks the codec itself, and may compress
+        syntax_error = 1;
+    }
+    if( chunk_size && (zcodec || auto_mode || framed_size) ) { // chunks hold plain BaseXML
+        syntax_error = 1;
+    }
+    if( escape_mode && (zcodec || auto_mode || chunk_size || framed_size || xml11_mode) ) { // escaped text is a mode of its own
+        syntax_error = 1;
+    }
+    if( syntax_error ) {
+        opt = (char) 0;
+    }
     switch( opt ) {
         case 'e':
         case 'd':
+        case 'r':
+        case 'f':
+        case 't':
             infilename = argc > 1 ? argv[1] : NULL;
             outfilename = argc > 2 ? argv[2] : NULL;
             retcode = basexml( opt, infilename, outfilename );
             break;
+        case 'v':
+            if( argc > 2 ) {
+                retcode = BASEXML_SYNTAX_ERROR;
+                break;
+            }
+            retcode = basexml( opt, argc > 1 ? argv[1] : NULL, NULL );
+            break;
+        case 'x': // mapped: no stdin
+            if( argc != 2 && argc != 3 ) {
+                retcode = BASEXML_SYNTAX_ERROR;
+                break;
+            }
+            retcode = extract( argv[1], extract_names, argc > 2 ? argv[2] : "" );
+            break;
+        case 'a': // the encoded file can't be stdout
+            if( argc != 2 && argc != 3 ) {
+                retcode = BASEXML_SYNTAX_ERROR;
+                break;
+            }
+            retcode = basexml( opt, argc > 2 ? argv[1] : NULL, argv[argc - 1] );
+            break;
+        case 'p': // the encoded file can't be stdout
+            if( argc != 3 ) {
+                retcode = BASEXML_SYNTAX_ERROR;
+                break;
+            }
+            retcode = basexml( opt, argv[1], argv[2] );
+            break;
         case 0:
-			if( argv[1] == NULL ) {
+			if( argv[1] == NULL && !syntax_error ) {
 				showuse();
 			}
 			else {
@@ -767,3 +5446,4 @@ int main( int argc, char **argv )
 
     return( retcode );
 }
+#endif /* BASEXML_NO_MAIN */
@@ -14,11 +14,24 @@ LICENSE          :  Open source under the MIT License.
 
 COMPILATION      :  You dont need to compile it yourself, just use the
                       Javascript pre-built asm.js directly.
+					 It dates from 2014: encode/decode return views
+					 into its heap, freed by the caller, and it has
+					 none of the calls added to src-post-js.js since.
                     If you still want to compile asm.js , you need
 					  Emsripten with all its dependencies
 					  (https://github.com/kripken/emscripten).
 					Then run:
-					  emcc -O2 -s EXPORTED_FUNCTIONS="['_encode_string','_decode_string','_get_length','_free']" -s ASM_JS=1 asmjs-basexml10.c --pre-js src-pre-js.js --post-js src-post-js.js -o asmjs.js
+					  emcc -O2 -s EXPORTED_FUNCTIONS="['_encode_string','_decode_string','_encode_string_into','_decode_string_into','_encode_string_utf16_into','_decode_string_utf16_into','_encode_string_crc_into','_decode_string_crc_into','_get_length','_malloc','_free']" -s ASM_JS=1 asmjs-basexml10.c --pre-js src-pre-js.js --post-js src-post-js.js -o asmjs.js
+					The WebAssembly modules are built from this same file.
+					 The SIMD128 one uses vector kernels for the bulk of
+					 the data, the other one is the scalar fallback:
+					  emcc -O3 -msimd128 -s WASM=1 -s ALLOW_MEMORY_GROWTH=1 -s EXPORTED_FUNCTIONS="['_encode_string','_decode_string','_encode_string_into','_decode_string_into','_encode_string_utf16_into','_decode_string_utf16_into','_encode_string_crc_into','_decode_string_crc_into','_get_length','_malloc','_free']" -s EXPORTED_RUNTIME_METHODS="['ccall','HEAPU8','HEAPU16']" asmjs-basexml10.c --pre-js src-pre-js.js --post-js src-post-js.js -o wasm-basexml10-simd.js
+					  emcc -O3 -s WASM=1 -s ALLOW_MEMORY_GROWTH=1 -s EXPORTED_FUNCTIONS="['_encode_string','_decode_string','_encode_string_into','_decode_string_into','_encode_string_utf16_into','_decode_string_utf16_into','_encode_string_crc_into','_decode_string_crc_into','_get_length','_malloc','_free']" -s EXPORTED_RUNTIME_METHODS="['ccall','HEAPU8','HEAPU16']" asmjs-basexml10.c --pre-js src-pre-js.js --post-js src-post-js.js -o wasm-basexml10.js
+					basexml-loader.js picks the best of the three builds
+					 for the running engine. bench-node.js compares them.
+					simd128-check.c checks the SIMD128 kernels against
+					 the scalar code, for all the 2^20 groups:
+					  emcc -O2 -msimd128 simd128-check.c -o simd128-check.js && node simd128-check.js
 
 USAGE            :  See the .html file for examples.
 					ASM.JS code is compatible with all main browsers.
@@ -118,7 +131,7 @@ Except as contained in this notice, the name(s) of the above copyright
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
+#include <string.h>
 
 
 #ifdef _MSC_VER
@@ -130,6 +143,13 @@ typedef unsigned __int64 uint64_t;
 #include <stdint.h>
 #endif
 
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#define BASEXML_SIMD128
+#elif defined(BASEXML_SIMD128_EMULATED) // simd128-check.c, which defines the wasm_* calls itself
+#define BASEXML_SIMD128
+#endif
+
 			
 /*
 ** returnable errors
@@ -225,6 +245,554 @@ uint32_t input = 0x00000000;
 uint32_t output = 0x00000000;
 
 /* Function definitions */
+
+#ifdef BASEXML_SIMD128
+/*
+** encodeblock_simd128 / decodeblock_simd128
+**
+** SIMD128 kernels for the bulk of the data: 4 blocks of 20 bits are
+** transposed at once, one per i32x4 lane. Every case is computed on
+** every lane, then the lanes pick their case in reverse priority order
+** so that the result is exactly the one of the scalar if/else chain.
+** They return the number of input bytes processed (multiple of 10
+** resp. 12) and leave the tail and the termination to the scalar code.
+** Both load and store 16 bytes, the callers keep enough data after.
+*/
+#define SPLAT(x) wasm_i32x4_splat((int32_t)(x))
+#define IS(v, mask, val) wasm_i32x4_eq(wasm_v128_and(v, SPLAT(mask)), SPLAT(val))
+#define PICK(r, m, v) r = wasm_v128_bitselect(v, r, m)
+
+static unsigned long encodeblock_simd128( unsigned char *in, unsigned char *out, unsigned long len_in )
+{
+	unsigned long i5 = 0, j = 0;
+	v128_t x, r, e, no_gh, no_no;
+
+	for( ; i5 + 16 <= len_in ; i5 += 10, j += 12 ) {
+		// lanes = ABCDEFGH IJKLMNOP QRST0000 ******** of in[0-2], in[2-4], in[5-7], in[7-9]
+		x = wasm_i8x16_swizzle(wasm_v128_load(in + i5), wasm_i8x16_make(16,2,1,0, 16,4,3,2, 16,7,6,5, 16,9,8,7));
+		x = wasm_i32x4_mul(x, wasm_i32x4_make(1, 16, 1, 16)); // 2nd blocks of 20bits start at the 4 low bits of in[2]
+		x = wasm_v128_and(x, SPLAT(0xfffff000));
+
+		no_gh = IS(x, 0x03000000, 0); // GH == 00
+		no_no = IS(x, 0x00060000, 0); // NO == 00
+
+		// Case CONTROL_CHARS_RIGHT E4
+		r = wasm_v128_or(wasm_v128_or(SPLAT(0xc0800000),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0xf8000000)), 3)), wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x04000000)), 5), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x0001f000)), 4),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x03f80000)), 11))));
+		// Case CONTROL_CHARS_LEFT E3
+		e = wasm_v128_or(wasm_v128_or(SPLAT(0x00c08000),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x0007f000)), 12)), wasm_v128_or(
+			wasm_v128_or(wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0xf8000000)), 11),
+			             wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x00080000)), 6)),
+			wasm_v128_or(wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x04000000)), 14),
+			             wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x00f00000)), 12))));
+		PICK(r, no_gh, e);
+		// Case CONTROL_CHARS_BOTH E2
+		e = wasm_v128_or(wasm_v128_or(SPLAT(0x20404000),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0xf0000000)), 4)), wasm_v128_or(
+			wasm_v128_or(wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x0c000000)), 6),
+			             wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x00f00000)), 4)),
+			wasm_v128_or(wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x00080000)), 6),
+			             wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x0001f000)), 4))));
+		PICK(r, wasm_v128_and(no_gh, no_no), e);
+		// Case CONTROL_CHARS_RIGHT_CANONICAL E6
+		e = wasm_v128_or(wasm_v128_or(SPLAT(0x20402000),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00010000)), 11)), wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x0e000000)), 1), wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x01f80000)), 3),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x0000f000)), 4))));
+		PICK(r, IS(x, 0xf0060000, 0), e);
+		// Case CONTROL_CHARS_LEFT_CANONICAL E5
+		e = wasm_v128_or(wasm_v128_or(SPLAT(0x20204000),
+			wasm_v128_and(x, SPLAT(0x0c000000))), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00c00000)), 2), wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x003c0000)), 2),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x0003f000)), 4))));
+		PICK(r, IS(x, 0xf3000000, 0), e);
+		// Case STANDARD E1
+		e = wasm_v128_or(wasm_v128_or(SPLAT(0x40000000),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0xfc000000)), 2)), wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x03f80000)), 3),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x0007f000)), 4)));
+		PICK(r, wasm_v128_not(wasm_v128_or(no_gh, no_no)), e);
+		// Case ILLEGAL<>_RIGHT I2
+		e = wasm_v128_or(wasm_v128_or(SPLAT(0x34404000),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00002000)), 12)), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00080000)), 5), wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0xfc000000)), 10),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x03f00000)), 12))));
+		PICK(r, IS(x, 0x0007d000, 0x0003c000), e);
+		// Case ILLEGAL<>_LEFT I1
+		e = wasm_v128_or(wasm_v128_or(SPLAT(0x30404000),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00100000)), 5)), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00001000)), 12), wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0xfc000000)), 10),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x0007e000)), 5))));
+		PICK(r, IS(x, 0x03e80000, 0x01e00000), e);
+		// Case ILLEGAL<>_BOTH I3
+		e = wasm_v128_or(wasm_v128_or(SPLAT(0x38404000),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00100000)), 5)), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00002000)), 11),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0xfc000000)), 10)));
+		PICK(r, IS(x, 0x03efd000, 0x01e3c000), e);
+
+		// XML ENTITY UNALLOWED CHARS: convert & (0x26) to TAB (0x09)
+		r = wasm_v128_bitselect(wasm_i8x16_splat(0x09), r, wasm_i8x16_eq(r, wasm_i8x16_splat(0x26)));
+
+		// keep the 3 high bytes of each lane, big endian
+		wasm_v128_store(out + j, wasm_i8x16_swizzle(r, wasm_i8x16_make(3,2,1, 7,6,5, 11,10,9, 15,14,13, 16,16,16,16)));
+	}
+
+	return i5;
+}
+
+static unsigned long decodeblock_simd128( unsigned char *in, unsigned char *out, unsigned long len_in )
+{
+	unsigned long i3 = 0, j = 0;
+	v128_t x, r, e;
+
+	for( ; i3 + 24 <= len_in ; i3 += 12, j += 10 ) { // the last 12 bytes may hold a termination sequence: scalar code
+		x = wasm_v128_load(in + i3);
+		// XML ENTITY UNALLOWED CHARS: preliminary transform of TAB (0x09) to & (0x26)
+		x = wasm_v128_bitselect(wasm_i8x16_splat(0x26), x, wasm_i8x16_eq(x, wasm_i8x16_splat(0x09)));
+		// lanes = in[0-2], in[3-5], in[6-8], in[9-11] as 24 high bits
+		x = wasm_i8x16_swizzle(x, wasm_i8x16_make(16,2,1,0, 16,5,4,3, 16,8,7,6, 16,11,10,9));
+
+		// Case CONTROL_CHARS_RIGHT E4 DECODE
+		e = wasm_v128_or(wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x1f000000)), 3),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00200000)), 5)), wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x001f0000)), 4),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00007f00)), 11)));
+		r = wasm_v128_and(e, IS(x, 0xe0c08000, 0xc0800000));
+		// Case CONTROL_CHARS_LEFT E3 DECODE
+		e = wasm_v128_or(wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x7f000000)), 12),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x001f0000)), 11)), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00002000)), 6), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00001000)), 14),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00000f00)), 12))));
+		PICK(r, IS(x, 0x80e0c000, 0x00c08000), e);
+		// Case CONTROL_CHARS_BOTH E2 DECODE
+		e = wasm_v128_or(wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x0f000000)), 4),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00300000)), 6)), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x000f0000)), 4), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00002000)), 6),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00001f00)), 4))));
+		PICK(r, IS(x, 0xf0c0c000, 0x20404000), e);
+		// Case CONTROL_CHARS_RIGHT_CANONICAL E6 DECODE
+		e = wasm_v128_or(wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x08000000)), 11),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x07000000)), 1)), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x003f0000)), 3),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00000f00)), 4)));
+		PICK(r, IS(x, 0xf0c0f000, 0x20402000), e);
+		// Case CONTROL_CHARS_LEFT_CANONICAL E5 DECODE
+		e = wasm_v128_or(wasm_v128_or(
+			wasm_v128_and(x, SPLAT(0x0c000000)),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x03000000)), 2)), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x000f0000)), 2),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00003f00)), 4)));
+		PICK(r, IS(x, 0xf0f0c000, 0x20204000), e);
+		// Case STANDARD E1 DECODE
+		e = wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x3f000000)), 2), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x007f0000)), 3),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00007f00)), 4)));
+		PICK(r, IS(x, 0xc0808000, 0x40000000), e);
+		// Case ILLEGAL<>_RIGHT I2 DECODE
+		e = wasm_v128_or(wasm_v128_or(SPLAT(0x0003c000),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x02000000)), 12)), wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x01000000)), 5), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x003f0000)), 10),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00003f00)), 12))));
+		PICK(r, IS(x, 0xfcc0c000, 0x34404000), e);
+		// Case ILLEGAL<>_LEFT I1 DECODE
+		e = wasm_v128_or(wasm_v128_or(SPLAT(0x01e00000),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x02000000)), 5)), wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x01000000)), 12), wasm_v128_or(
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x003f0000)), 10),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x00003f00)), 5))));
+		PICK(r, IS(x, 0xfcc0c000, 0x30404000), e);
+		// Case ILLEGAL<>_BOTH I3 DECODE
+		e = wasm_v128_or(wasm_v128_or(SPLAT(0x01e3c000),
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x02000000)), 5)), wasm_v128_or(
+			wasm_u32x4_shr(wasm_v128_and(x, SPLAT(0x01000000)), 11),
+			wasm_i32x4_shl(wasm_v128_and(x, SPLAT(0x003f0000)), 10)));
+		PICK(r, IS(x, 0xfcc0f000, 0x38404000), e);
+
+		// 2 lanes of 20 bits -> 1 block of 40 bits per i64x2 lane, then big endian bytes
+		r = wasm_u32x4_shr(r, 12);
+		r = wasm_v128_or(wasm_i64x2_shl(wasm_v128_and(r, wasm_i64x2_splat(0xffffffff)), 20), wasm_u64x2_shr(r, 32));
+		wasm_v128_store(out + j, wasm_i8x16_swizzle(r, wasm_i8x16_make(4,3,2,1,0, 12,11,10,9,8, 16,16,16,16,16,16)));
+	}
+
+	return i3;
+}
+
+#undef PICK
+#undef IS
+#undef SPLAT
+#endif
+
+/*
+** encode20
+**
+** encode the 20 bits at the top of input (ABCDEFGH IJKLMNOP QRST0000)
+** into 24 bits at the top of the result, case by case
+*/
+static uint32_t encode20( uint32_t input )
+{
+	uint32_t output = 0x00000000;
+
+	// input = ABCDEFGH IJKLMNOP QRST0000
+
+	// Case ILLEGAL<>_BOTH I3
+	if ( ( input & 0x03efd000 ) == 0x01e3c000 ) { // GHIJKMNOPQRT == 011110011110
+			output  = 0x38404000; // 001110LS 01ABCDEF 01000000 ********
+			output |= (input & 0x00100000) <<  5; // L
+			output |= (input & 0x00002000) << 11; // S
+			output |= (input & 0xfc000000) >> 10; // ABCDEF
+	} else 
+	// Case ILLEGAL<>_LEFT I1
+	if ( ( input & 0x03e80000 ) == 0x01e00000 ) { // GHIJKM == 011110
+			output  = 0x30404000; // 001100LT 01ABCDEF 01NOPQRS ********
+			output |= (input & 0x00100000) <<  5; // L
+			output |= (input & 0x00001000) << 12; // T
+			output |= (input & 0xfc000000) >> 10; // ABCDEF
+			output |= (input & 0x0007e000) >>  5; // NOPQRS
+	} else 
+	// Case ILLEGAL<>_RIGHT I2
+	if ( ( input & 0x0007d000 ) == 0x0003c000 ) { // NOPQRT == 011110
+			output  = 0x34404000; // 001101SM 01ABCDEF 01GHIJKL ********
+			output |= (input & 0x00002000) << 12; // S
+			output |= (input & 0x00080000) <<  5; // M
+			output |= (input & 0xfc000000) >> 10; // ABCDEF
+			output |= (input & 0x03f00000) >> 12; // GHIJKL
+	} else 
+	if ( input & 0x03000000  &&  // GH != 00
+
+	 input & 0x00060000 ) { // NO != 00
+
+	// Case STANDARD E1
+			output  = 0x40000000; // 01ABCDEF 0GHIJKLM 0NOPQRST ********
+			output |= (input & 0xfc000000) >>  2; // ABCDEF
+			output |= (input & 0x03f80000) >>  3; // GHIJKLM
+			output |= (input & 0x0007f000) >>  4; // NOPQRST
+	} else 
+	// Case CONTROL_CHARS_LEFT_CANONICAL E5 : ABCD==0000 and GH==00
+	if ( !( input & 0xf3000000 ) ) { // ABCDGH == 000000
+			output  = 0x20204000; // 0010EFIJ 0010KLMN 01OPQRST ********
+			output |= (input & 0x0c000000); // EF
+			output |= (input & 0x00c00000) <<  2; // IJ
+			output |= (input & 0x003c0000) >>  2; // KLMN
+			output |= (input & 0x0003f000) >>  4; // OPQRST
+	} else 
+	// Case CONTROL_CHARS_RIGHT_CANONICAL E6 : ABCD==0000 and NO==00
+	if ( !( input & 0xf0060000 ) ) { // ABCDNO == 000000
+			output  = 0x20402000; // 0010PEFG 01HIJKLM 0010QRST ********
+			output |= (input & 0x00010000) << 11; // P
+			output |= (input & 0x0e000000) >>  1; // EFG
+			output |= (input & 0x01f80000) >>  3; // HIJKLM
+			output |= (input & 0x0000f000) >>  4; // QRST
+	} else 
+	// Case CONTROL_CHARS_BOTH E2
+	if ( !( input & 0x03060000 ) ) { // GHNO == 0000
+			output  = 0x20404000; // 0010ABCD 01EFIJKL 01MPQRST ********
+			output |= (input & 0xf0000000) >>  4; // ABCD
+			output |= (input & 0x0c000000) >>  6; // EF
+			output |= (input & 0x00f00000) >>  4; // IJKL
+			output |= (input & 0x00080000) >>  6; // M
+			output |= (input & 0x0001f000) >>  4; // PQRST
+	} else 
+	// Case CONTROL_CHARS_LEFT E3
+	if ( !( input & 0x03000000 ) ) { // GH == 00
+			output  = 0x00c08000; // 0NOPQRST 110ABCDE 10MFIJKL ********
+			output |= (input & 0x0007f000) << 12; // NOPQRST
+			output |= (input & 0xf8000000) >> 11; // ABCDE
+			output |= (input & 0x00080000) >>  6; // M
+			output |= (input & 0x04000000) >> 14; // F
+			output |= (input & 0x00f00000) >> 12; // IJKL
+	} else 
+	// Case CONTROL_CHARS_RIGHT E4
+	if ( !( input & 0x00060000 ) ) { // NO == 00
+			output  = 0xc0800000; // 110ABCDE 10FPQRST 0GHIJKLM ********
+			output |= (input & 0xf8000000) >>  3; // ABCDE
+			output |= (input & 0x04000000) >>  5; // F
+			output |= (input & 0x0001f000) <<  4; // PQRST
+			output |= (input & 0x03f80000) >> 11; // GHIJKLM
+	}
+		
+
+	/* DEBUG: printf("ENCODEBLOCK input   32: "BYTETOBINARYPATTERN"\n", BYTETOBINARY(input)); */
+	/* DEBUG: printf("ENCODEBLOCK out<>   32: "BYTETOBINARYPATTERN"\n", BYTETOBINARY(output)); */
+			
+	// XML ENTITY UNALLOWED CHARS
+	/*
+		On "encoded" variable apply:
+		convert & (0x26) to TAB (0x09)
+	*/
+	if ((output & 0xFF000000) == 0x26000000) {
+		output &= 0x00FFFFFF; output |= 0x09000000;
+	}
+	if ((output & 0x00FF0000) == 0x00260000) {
+		output &= 0xFF00FFFF; output |= 0x00090000;
+	}
+	if ((output & 0x0000FF00) == 0x00002600) {
+		output &= 0xFFFF00FF; output |= 0x00000900;
+	}
+
+	return output;
+}
+
+/*
+** decode20
+**
+** decode the 24 bits at the top of input into 20 bits at the top of
+** the result, 0 if undecodable
+*/
+static uint32_t decode20( uint32_t input )
+{
+	uint32_t output = 0x00000000;
+
+	/* DEBUG: printf("DECODEBLOCK bytes     : %x\n", input); */
+	/* DEBUG: printf("DECODEBLOCK inXML   32: "BYTETOBINARYPATTERN"\n", BYTETOBINARY(input)); */
+	
+	// XML ENTITY UNALLOWED CHARS
+	// Preliminary transform of \n\r\t to <>& in each encoded byte
+	if((input & 0xFF000000) == 0x09000000) {
+		input &= 0x00FFFFFF; input |= 0x26000000;
+	}
+	
+	if((input & 0x00FF0000) == 0x00090000) {
+		input &= 0xFF00FFFF; input |= 0x00260000;
+	}
+	
+	if((input & 0x0000FF00) == 0x00000900) {
+		input &= 0xFFFF00FF; input |= 0x00002600;
+	}
+	
+	/* DEBUG: printf("DECODEBLOCK in<>    32: "BYTETOBINARYPATTERN"\n", BYTETOBINARY(input)); */
+			
+
+	// Case ILLEGAL<>_BOTH I3 DECODE
+	if ( ( input & 0xfcc0f000 ) == 0x38404000 ) { // ABCDEFIJQRST == 001110010100
+		    output  = 0x01e3c000; // 001110LS 01ABCDEF 01000000 ********
+		    output |= (input & 0x02000000) >>  5; // L
+		    output |= (input & 0x01000000) >> 11; // S
+		    output |= (input & 0x003f0000) << 10; // ABCDEF
+	} else 
+	// Case ILLEGAL<>_LEFT I1 DECODE
+	if ( ( input & 0xfcc0c000 ) == 0x30404000 ) { // ABCDEFIJQR == 0011000101
+		    output  = 0x01e00000; // 001100LT 01ABCDEF 01NOPQRS ********
+		    output |= (input & 0x02000000) >>  5; // L
+		    output |= (input & 0x01000000) >> 12; // T
+		    output |= (input & 0x003f0000) << 10; // ABCDEF
+		    output |= (input & 0x00003f00) <<  5; // NOPQRS
+	} else 
+	// Case ILLEGAL<>_RIGHT I2 DECODE
+	if ( ( input & 0xfcc0c000 ) == 0x34404000 ) { // ABCDEFIJQR == 0011010101
+		    output  = 0x0003c000; // 001101SM 01ABCDEF 01GHIJKL ********
+		    output |= (input & 0x02000000) >> 12; // S
+		    output |= (input & 0x01000000) >>  5; // M
+		    output |= (input & 0x003f0000) << 10; // ABCDEF
+		    output |= (input & 0x00003f00) << 12; // GHIJKL
+	} else 
+	// Case STANDARD E1 DECODE
+	if ( ( input & 0xc0808000 ) == 0x40000000 ) { // ABIQ == 0100
+		    output |= (input & 0x3f000000) <<  2; // ABCDEF
+		    output |= (input & 0x007f0000) <<  3; // GHIJKLM
+		    output |= (input & 0x00007f00) <<  4; // NOPQRST
+	} else 
+	// Case CONTROL_CHARS_LEFT_CANONICAL E5 : ABCD==0000 and GH==00 DECODE
+	if ( ( input & 0xf0f0c000 ) == 0x20204000 ) { // ABCDIJKLQR == 0010001001
+		    output |= (input & 0x0c000000); // EF
+		    output |= (input & 0x03000000) >>  2; // IJ
+		    output |= (input & 0x000f0000) <<  2; // KLMN
+		    output |= (input & 0x00003f00) <<  4; // OPQRST
+	} else 
+	// Case CONTROL_CHARS_RIGHT_CANONICAL E6 : ABCD==0000 and NO==00 DECODE
+	if ( ( input & 0xf0c0f000 ) == 0x20402000 ) { // ABCDIJQRST == 0010010010
+		    output |= (input & 0x08000000) >> 11; // P
+		    output |= (input & 0x07000000) <<  1; // EFG
+		    output |= (input & 0x003f0000) <<  3; // HIJKLM
+		    output |= (input & 0x00000f00) <<  4; // QRST
+	} else 
+	// Case CONTROL_CHARS_BOTH E2 DECODE
+	if ( ( input & 0xf0c0c000 ) == 0x20404000 ) { // ABCDIJQR == 00100101
+		    output |= (input & 0x0f000000) <<  4; // ABCD
+		    output |= (input & 0x00300000) <<  6; // EF
+		    output |= (input & 0x000f0000) <<  4; // IJKL
+		    output |= (input & 0x00002000) <<  6; // M
+		    output |= (input & 0x00001f00) <<  4; // PQRST
+	} else 
+	// Case CONTROL_CHARS_LEFT E3 DECODE
+	if ( ( input & 0x80e0c000 ) == 0x00c08000 ) { // AIJKQR == 011010
+		    output |= (input & 0x7f000000) >> 12; // NOPQRST
+		    output |= (input & 0x001f0000) << 11; // ABCDE
+		    output |= (input & 0x00002000) <<  6; // M
+		    output |= (input & 0x00001000) << 14; // F
+		    output |= (input & 0x00000f00) << 12; // IJKL
+	} else 
+	// Case CONTROL_CHARS_RIGHT E4 DECODE
+	if ( ( input & 0xe0c08000 ) == 0xc0800000 ) { // ABCIJQ == 110100
+		    output |= (input & 0x1f000000) <<  3; // ABCDE
+		    output |= (input & 0x00200000) <<  5; // F
+		    output |= (input & 0x001f0000) >>  4; // PQRST
+		    output |= (input & 0x00007f00) << 11; // GHIJKLM
+	} /*
+	  else if( ( input & 0xfff0ff00 ) == 0x3f303f00 ) { // == 00111111 0011**** 00111111 ********
+
+		// ERROR
+		// BaseXML10BS termination sequence doesn't store encoded bytes.
+		// That's the job of decode() to anticipate termination sequence and pass len to decodeblock().
+
+	} */
+
+	return output;
+}
+
+/*
+** encode_small / decode_small
+**
+** Short strings (IDs, tokens, hashes) skip the block loop: a switch on
+** the number of 20-bit groups falls into straight-line code, with no
+** loop, no floating point and no allocation. encodeblock / decodeblock
+** take this path by themselves, so every exported function gets it.
+** decode_small returns 0, leaving it to decodeblock, for anything longer
+** or not well-formed.
+*/
+#define BASEXML_SMALL_MAX         64
+#define BASEXML_SMALL_ENCODED_MAX 81 // 12 blocks, 4 bytes and the termination sequence
+
+static void encode_small_group( const unsigned char *in, unsigned char *out, int k ) // 20-bit group k, a constant once inlined
+{
+	const unsigned char *p = in + k / 2 * 5;
+	uint32_t v = encode20( k % 2 ? (uint32_t) p[2] << 28 | (uint32_t) p[3] << 20 | (uint32_t) p[4] << 12
+	                             : (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) (p[2] & 0xF0) << 8 );
+
+	out[k * 3]     = (unsigned char) (v >> 24);
+	out[k * 3 + 1] = (unsigned char) (v >> 16);
+	out[k * 3 + 2] = (unsigned char) (v >> 8);
+}
+
+static void decode_small_group( const unsigned char *in, unsigned char *out, int k )
+{
+	const unsigned char *g = in + k * 3;
+	unsigned char *p = out + k / 2 * 5;
+	uint32_t v = decode20( (uint32_t) g[0] << 24 | (uint32_t) g[1] << 16 | (uint32_t) g[2] << 8 );
+
+	if( k % 2 ) { // groups are decoded last to first: each one adds its half of p[2]
+		p[2] |= (unsigned char) ((v >> 28) & 0x0F);
+		p[3]  = (unsigned char) (v >> 20);
+		p[4]  = (unsigned char) (v >> 12);
+	} else {
+		p[0]  = (unsigned char) (v >> 24);
+		p[1]  = (unsigned char) (v >> 16);
+		p[2] |= (unsigned char) ((v >> 8) & 0xF0);
+	}
+}
+
+static unsigned long encode_small( const unsigned char *in, unsigned char *out, unsigned long len_in ) // len_in <= BASEXML_SMALL_MAX
+{
+	unsigned char pad[BASEXML_SMALL_MAX + 5];
+	unsigned long groups = (len_in * 2 + 4) / 5;
+
+	memcpy( pad, in, len_in );
+	memset( pad + len_in, 0, 5 ); // the last group is zero-padded, as by encodeblock
+	switch( groups ) { // each case falls through, last group first
+		case 26: encode_small_group( pad, out, 25 ); /* fall through */
+		case 25: encode_small_group( pad, out, 24 ); /* fall through */
+		case 24: encode_small_group( pad, out, 23 ); /* fall through */
+		case 23: encode_small_group( pad, out, 22 ); /* fall through */
+		case 22: encode_small_group( pad, out, 21 ); /* fall through */
+		case 21: encode_small_group( pad, out, 20 ); /* fall through */
+		case 20: encode_small_group( pad, out, 19 ); /* fall through */
+		case 19: encode_small_group( pad, out, 18 ); /* fall through */
+		case 18: encode_small_group( pad, out, 17 ); /* fall through */
+		case 17: encode_small_group( pad, out, 16 ); /* fall through */
+		case 16: encode_small_group( pad, out, 15 ); /* fall through */
+		case 15: encode_small_group( pad, out, 14 ); /* fall through */
+		case 14: encode_small_group( pad, out, 13 ); /* fall through */
+		case 13: encode_small_group( pad, out, 12 ); /* fall through */
+		case 12: encode_small_group( pad, out, 11 ); /* fall through */
+		case 11: encode_small_group( pad, out, 10 ); /* fall through */
+		case 10: encode_small_group( pad, out, 9 ); /* fall through */
+		case 9: encode_small_group( pad, out, 8 ); /* fall through */
+		case 8: encode_small_group( pad, out, 7 ); /* fall through */
+		case 7: encode_small_group( pad, out, 6 ); /* fall through */
+		case 6: encode_small_group( pad, out, 5 ); /* fall through */
+		case 5: encode_small_group( pad, out, 4 ); /* fall through */
+		case 4: encode_small_group( pad, out, 3 ); /* fall through */
+		case 3: encode_small_group( pad, out, 2 ); /* fall through */
+		case 2: encode_small_group( pad, out, 1 ); /* fall through */
+		case 1: encode_small_group( pad, out, 0 );
+	}
+	if( len_in % 5 ) { // termination sequence
+		out[groups * 3]     = 0x3f;
+		out[groups * 3 + 1] = (unsigned char) (0x30 | len_in % 5);
+		out[groups * 3 + 2] = 0x3f;
+		groups++;
+	}
+	return groups * 3;
+}
+
+static int decode_small( const unsigned char *in, unsigned char *out, unsigned long len_in, unsigned long *len_out )
+{
+	unsigned char block[BASEXML_SMALL_MAX + 5] = { 0 };
+	unsigned long size;
+	unsigned char last;
+
+	if( len_in > BASEXML_SMALL_ENCODED_MAX )
+		return 0;
+	if( len_in % 3 == 0 && len_in >= 3 && in[len_in - 3] == 0x3f && in[len_in - 1] == 0x3f ) {
+		// termination sequence: 1 or 2 bytes inside the last 6, 3 or 4 after them
+		last = in[len_in - 2];
+		if( len_in % 6 == 0 ? (last != 0x31 && last != 0x32) : (len_in < 9 || (last != 0x33 && last != 0x34)) )
+			return 0;
+		size = (len_in - 3) / 6 * 5 + (last & 0x07) - (len_in % 6 ? 5 : 0);
+	} else if( len_in % 6 == 0 ) {
+		size = len_in / 6 * 5;
+	} else {
+		return 0;
+	}
+	switch( (size * 2 + 4) / 5 ) { // each case falls through, last group first
+		case 26: decode_small_group( in, block, 25 ); /* fall through */
+		case 25: decode_small_group( in, block, 24 ); /* fall through */
+		case 24: decode_small_group( in, block, 23 ); /* fall through */
+		case 23: decode_small_group( in, block, 22 ); /* fall through */
+		case 22: decode_small_group( in, block, 21 ); /* fall through */
+		case 21: decode_small_group( in, block, 20 ); /* fall through */
+		case 20: decode_small_group( in, block, 19 ); /* fall through */
+		case 19: decode_small_group( in, block, 18 ); /* fall through */
+		case 18: decode_small_group( in, block, 17 ); /* fall through */
+		case 17: decode_small_group( in, block, 16 ); /* fall through */
+		case 16: decode_small_group( in, block, 15 ); /* fall through */
+		case 15: decode_small_group( in, block, 14 ); /* fall through */
+		case 14: decode_small_group( in, block, 13 ); /* fall through */
+		case 13: decode_small_group( in, block, 12 ); /* fall through */
+		case 12: decode_small_group( in, block, 11 ); /* fall through */
+		case 11: decode_small_group( in, block, 10 ); /* fall through */
+		case 10: decode_small_group( in, block, 9 ); /* fall through */
+		case 9: decode_small_group( in, block, 8 ); /* fall through */
+		case 8: decode_small_group( in, block, 7 ); /* fall through */
+		case 7: decode_small_group( in, block, 6 ); /* fall through */
+		case 6: decode_small_group( in, block, 5 ); /* fall through */
+		case 5: decode_small_group( in, block, 4 ); /* fall through */
+		case 4: decode_small_group( in, block, 3 ); /* fall through */
+		case 3: decode_small_group( in, block, 2 ); /* fall through */
+		case 2: decode_small_group( in, block, 1 ); /* fall through */
+		case 1: decode_small_group( in, block, 0 );
+	}
+	memcpy( out, block, size );
+	*len_out = size;
+	return 1;
+}
+
 static void encodeblock( unsigned char *in, unsigned char *out, unsigned long len_in, unsigned long *len_out )
 {
 
@@ -232,7 +800,7 @@ static void encodeblock( unsigned char *in, unsigned char *out, unsigned long le
 	unsigned long i5 = 0; // input character position = i*5 on each 2 loops
 	unsigned long j  = 0; // output character position
 	unsigned long len_last  = 0; // output character position
-	unsigned long i_ceil  = (unsigned long) ceil((float)len_in/2.5);
+	unsigned long i_ceil  = (len_in * 2 + 4) / 5; // 20-bit groups, integers only
 	int len_rest;
 
 
@@ -240,9 +808,17 @@ static void encodeblock( unsigned char *in, unsigned char *out, unsigned long le
 
 
 	
+	if( len_in <= BASEXML_SMALL_MAX ) {
+		*len_out = encode_small(in, out, len_in);
+		return;
+	}
 	*len_out = 0;
 	
-	for( i = 0, i5 = 0, j = 0; i < i_ceil ; i++ ) {
+#ifdef BASEXML_SIMD128
+	i5 = encodeblock_simd128(in, out, len_in);
+	j  = i5 / 5 * 6;
+#endif
+	for( i = i5 / 5 * 2; i < i_ceil ; i++ ) {
 		
 		/* DEBUG: printf("ENCODEBLOCK loop i=%lu (i_ceil=%lu)\n", i, i_ceil); */
 
@@ -272,102 +848,7 @@ static void encodeblock( unsigned char *in, unsigned char *out, unsigned long le
 						(in[i5+2] & 0xF0) << 8;
 			}
 		}	
-		// input = ABCDEFGH IJKLMNOP QRST0000
-
-		// Case ILLEGAL<>_BOTH I3
-		if ( ( input & 0x03efd000 ) == 0x01e3c000 ) { // GHIJKMNOPQRT == 011110011110
-				output  = 0x38404000; // 001110LS 01ABCDEF 01000000 ********
-				output |= (input & 0x00100000) <<  5; // L
-				output |= (input & 0x00002000) << 11; // S
-				output |= (input & 0xfc000000) >> 10; // ABCDEF
-		} else 
-		// Case ILLEGAL<>_LEFT I1
-		if ( ( input & 0x03e80000 ) == 0x01e00000 ) { // GHIJKM == 011110
-				output  = 0x30404000; // 001100LT 01ABCDEF 01NOPQRS ********
-				output |= (input & 0x00100000) <<  5; // L
-				output |= (input & 0x00001000) << 12; // T
-				output |= (input & 0xfc000000) >> 10; // ABCDEF
-				output |= (input & 0x0007e000) >>  5; // NOPQRS
-		} else 
-		// Case ILLEGAL<>_RIGHT I2
-		if ( ( input & 0x0007d000 ) == 0x0003c000 ) { // NOPQRT == 011110
-				output  = 0x34404000; // 001101SM 01ABCDEF 01GHIJKL ********
-				output |= (input & 0x00002000) << 12; // S
-				output |= (input & 0x00080000) <<  5; // M
-				output |= (input & 0xfc000000) >> 10; // ABCDEF
-				output |= (input & 0x03f00000) >> 12; // GHIJKL
-		} else 
-		if ( input & 0x03000000  &&  // GH != 00
-
-		 input & 0x00060000 ) { // NO != 00
-
-		// Case STANDARD E1
-				output  = 0x40000000; // 01ABCDEF 0GHIJKLM 0NOPQRST ********
-				output |= (input & 0xfc000000) >>  2; // ABCDEF
-				output |= (input & 0x03f80000) >>  3; // GHIJKLM
-				output |= (input & 0x0007f000) >>  4; // NOPQRST
-		} else 
-		// Case CONTROL_CHARS_LEFT_CANONICAL E5 : ABCD==0000 and GH==00
-		if ( !( input & 0xf3000000 ) ) { // ABCDGH == 000000
-				output  = 0x20204000; // 0010EFIJ 0010KLMN 01OPQRST ********
-				output |= (input & 0x0c000000); // EF
-				output |= (input & 0x00c00000) <<  2; // IJ
-				output |= (input & 0x003c0000) >>  2; // KLMN
-				output |= (input & 0x0003f000) >>  4; // OPQRST
-		} else 
-		// Case CONTROL_CHARS_RIGHT_CANONICAL E6 : ABCD==0000 and NO==00
-		if ( !( input & 0xf0060000 ) ) { // ABCDNO == 000000
-				output  = 0x20402000; // 0010PEFG 01HIJKLM 0010QRST ********
-				output |= (input & 0x00010000) << 11; // P
-				output |= (input & 0x0e000000) >>  1; // EFG
-				output |= (input & 0x01f80000) >>  3; // HIJKLM
-				output |= (input & 0x0000f000) >>  4; // QRST
-		} else 
-		// Case CONTROL_CHARS_BOTH E2
-		if ( !( input & 0x03060000 ) ) { // GHNO == 0000
-				output  = 0x20404000; // 0010ABCD 01EFIJKL 01MPQRST ********
-				output |= (input & 0xf0000000) >>  4; // ABCD
-				output |= (input & 0x0c000000) >>  6; // EF
-				output |= (input & 0x00f00000) >>  4; // IJKL
-				output |= (input & 0x00080000) >>  6; // M
-				output |= (input & 0x0001f000) >>  4; // PQRST
-		} else 
-		// Case CONTROL_CHARS_LEFT E3
-		if ( !( input & 0x03000000 ) ) { // GH == 00
-				output  = 0x00c08000; // 0NOPQRST 110ABCDE 10MFIJKL ********
-				output |= (input & 0x0007f000) << 12; // NOPQRST
-				output |= (input & 0xf8000000) >> 11; // ABCDE
-				output |= (input & 0x00080000) >>  6; // M
-				output |= (input & 0x04000000) >> 14; // F
-				output |= (input & 0x00f00000) >> 12; // IJKL
-		} else 
-		// Case CONTROL_CHARS_RIGHT E4
-		if ( !( input & 0x00060000 ) ) { // NO == 00
-				output  = 0xc0800000; // 110ABCDE 10FPQRST 0GHIJKLM ********
-				output |= (input & 0xf8000000) >>  3; // ABCDE
-				output |= (input & 0x04000000) >>  5; // F
-				output |= (input & 0x0001f000) <<  4; // PQRST
-				output |= (input & 0x03f80000) >> 11; // GHIJKLM
-		}
-			
-
-		/* DEBUG: printf("ENCODEBLOCK(%lu) input   32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(input)); */
-		/* DEBUG: printf("ENCODEBLOCK(%lu) out<>   32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(output)); */
-				
-		// XML ENTITY UNALLOWED CHARS
-		/*
-			On "encoded" variable apply:
-			convert & (0x26) to TAB (0x09)
-		*/
-		if ((output & 0xFF000000) == 0x26000000) {
-			output &= 0x00FFFFFF; output |= 0x09000000;
-		}
-		if ((output & 0x00FF0000) == 0x00260000) {
-			output &= 0xFF00FFFF; output |= 0x00090000;
-		}
-		if ((output & 0x0000FF00) == 0x00002600) {
-			output &= 0xFFFF00FF; output |= 0x00000900;
-		}
+		output = encode20( input );
 		
 		/* DEBUG: printf("ENCODEBLOCK(%lu) outXML  32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(output)); */
 		
@@ -416,14 +897,20 @@ static void decodeblock( unsigned char *in, unsigned char *out, unsigned long le
 	unsigned long i3 = 0; // input character position = i*3
 	unsigned long j  = 0; // output character position
 	unsigned long len_last  = 0; // output character position
-	unsigned long i_ceil   = (unsigned long)ceil((float)len_in/6)*2;
-	unsigned long i_floor  = (unsigned long)floor((float)len_in/6)*2;
+	unsigned long i_ceil   = (len_in + 5) / 6 * 2; // integers: a float loses precision over 16MB
+	unsigned long i_floor  = len_in / 6 * 2;
 	
+	if( decode_small(in, out, len_in, len_out) )
+		return;
 	*len_out = 0;
 
 	/* DEBUG: printf("Decoding %lu bytes...\n",len_in); */
 	
-	for( i = 0, i3 = 0; i < i_ceil ; i++, i3 += 3 ) {
+#ifdef BASEXML_SIMD128
+	i3 = decodeblock_simd128(in, out, len_in);
+	j  = i3 / 6 * 5;
+#endif
+	for( i = i3 / 3; i < i_ceil ; i++, i3 += 3 ) {
 
 		/* DEBUG: printf("DECODEBLOCK loop i=%lu, i3=%lu (i_ceil=%lu)\n", i, i3, i_ceil); */
 				
@@ -445,12 +932,12 @@ static void decodeblock( unsigned char *in, unsigned char *out, unsigned long le
 					}
 					break;
 				} /*else  DEBUG: printf("DECODEBLOCK(%lu) Not a termination sequence\n",i); */
-			} /*else  DEBUG */ printf("DECODEBLOCK(%lu) i3+2 < len_in",i);
+			} /* else DEBUG: printf("DECODEBLOCK(%lu) i3+2 >= len_in",i); */
 			
 			 // Full sequence
 			if(i3<len_in)   input |= in[i3]   << 24;
 			if(i3+1<len_in) input |= in[i3+1] << 16;
-			if(i3+1<len_in) input |= in[i3+2] <<  8;
+			if(i3+2<len_in) input |= in[i3+2] <<  8;
 		} else {
 		//printf("DECODEBLOCK(%lu) DEBUG INPUT BEFORE     : %x\n", i, input);
 		//printf("DECODEBLOCK(%lu) DEBUG i3     : %lu\n", i, i3);
@@ -466,101 +953,7 @@ static void decodeblock( unsigned char *in, unsigned char *out, unsigned long le
 		}
 		
 
-		output  = 0x00000000;
-		
-		/* DEBUG: printf("DECODEBLOCK(%lu) bytes     : %x\n", i, input); */
-		/* DEBUG: printf("DECODEBLOCK(%lu) inXML   32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(input)); */
-		
-		// XML ENTITY UNALLOWED CHARS
-		// Preliminary transform of \n\r\t to <>& in each encoded byte
-		if((input & 0xFF000000) == 0x09000000) {
-			input &= 0x00FFFFFF; input |= 0x26000000;
-		}
-		
-		if((input & 0x00FF0000) == 0x00090000) {
-			input &= 0xFF00FFFF; input |= 0x00260000;
-		}
-		
-		if((input & 0x0000FF00) == 0x00000900) {
-			input &= 0xFFFF00FF; input |= 0x00002600;
-		}
-		
-		/* DEBUG: printf("DECODEBLOCK(%lu) in<>    32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(input)); */
-				
-
-		// Case ILLEGAL<>_BOTH I3 DECODE
-		if ( ( input & 0xfcc0f000 ) == 0x38404000 ) { // ABCDEFIJQRST == 001110010100
-			    output  = 0x01e3c000; // 001110LS 01ABCDEF 01000000 ********
-			    output |= (input & 0x02000000) >>  5; // L
-			    output |= (input & 0x01000000) >> 11; // S
-			    output |= (input & 0x003f0000) << 10; // ABCDEF
-		} else 
-		// Case ILLEGAL<>_LEFT I1 DECODE
-		if ( ( input & 0xfcc0c000 ) == 0x30404000 ) { // ABCDEFIJQR == 0011000101
-			    output  = 0x01e00000; // 001100LT 01ABCDEF 01NOPQRS ********
-			    output |= (input & 0x02000000) >>  5; // L
-			    output |= (input & 0x01000000) >> 12; // T
-			    output |= (input & 0x003f0000) << 10; // ABCDEF
-			    output |= (input & 0x00003f00) <<  5; // NOPQRS
-		} else 
-		// Case ILLEGAL<>_RIGHT I2 DECODE
-		if ( ( input & 0xfcc0c000 ) == 0x34404000 ) { // ABCDEFIJQR == 0011010101
-			    output  = 0x0003c000; // 001101SM 01ABCDEF 01GHIJKL ********
-			    output |= (input & 0x02000000) >> 12; // S
-			    output |= (input & 0x01000000) >>  5; // M
-			    output |= (input & 0x003f0000) << 10; // ABCDEF
-			    output |= (input & 0x00003f00) << 12; // GHIJKL
-		} else 
-		// Case STANDARD E1 DECODE
-		if ( ( input & 0xc0808000 ) == 0x40000000 ) { // ABIQ == 0100
-			    output |= (input & 0x3f000000) <<  2; // ABCDEF
-			    output |= (input & 0x007f0000) <<  3; // GHIJKLM
-			    output |= (input & 0x00007f00) <<  4; // NOPQRST
-		} else 
-		// Case CONTROL_CHARS_LEFT_CANONICAL E5 : ABCD==0000 and GH==00 DECODE
-		if ( ( input & 0xf0f0c000 ) == 0x20204000 ) { // ABCDIJKLQR == 0010001001
-			    output |= (input & 0x0c000000); // EF
-			    output |= (input & 0x03000000) >>  2; // IJ
-			    output |= (input & 0x000f0000) <<  2; // KLMN
-			    output |= (input & 0x00003f00) <<  4; // OPQRST
-		} else 
-		// Case CONTROL_CHARS_RIGHT_CANONICAL E6 : ABCD==0000 and NO==00 DECODE
-		if ( ( input & 0xf0c0f000 ) == 0x20402000 ) { // ABCDIJQRST == 0010010010
-			    output |= (input & 0x08000000) >> 11; // P
-			    output |= (input & 0x07000000) <<  1; // EFG
-			    output |= (input & 0x003f0000) <<  3; // HIJKLM
-			    output |= (input & 0x00000f00) <<  4; // QRST
-		} else 
-		// Case CONTROL_CHARS_BOTH E2 DECODE
-		if ( ( input & 0xf0c0c000 ) == 0x20404000 ) { // ABCDIJQR == 00100101
-			    output |= (input & 0x0f000000) <<  4; // ABCD
-			    output |= (input & 0x00300000) <<  6; // EF
-			    output |= (input & 0x000f0000) <<  4; // IJKL
-			    output |= (input & 0x00002000) <<  6; // M
-			    output |= (input & 0x00001f00) <<  4; // PQRST
-		} else 
-		// Case CONTROL_CHARS_LEFT E3 DECODE
-		if ( ( input & 0x80e0c000 ) == 0x00c08000 ) { // AIJKQR == 011010
-			    output |= (input & 0x7f000000) >> 12; // NOPQRST
-			    output |= (input & 0x001f0000) << 11; // ABCDE
-			    output |= (input & 0x00002000) <<  6; // M
-			    output |= (input & 0x00001000) << 14; // F
-			    output |= (input & 0x00000f00) << 12; // IJKL
-		} else 
-		// Case CONTROL_CHARS_RIGHT E4 DECODE
-		if ( ( input & 0xe0c08000 ) == 0xc0800000 ) { // ABCIJQ == 110100
-			    output |= (input & 0x1f000000) <<  3; // ABCDE
-			    output |= (input & 0x00200000) <<  5; // F
-			    output |= (input & 0x001f0000) >>  4; // PQRST
-			    output |= (input & 0x00007f00) << 11; // GHIJKLM
-		} /*
-		  else if( ( input & 0xfff0ff00 ) == 0x3f303f00 ) { // == 00111111 0011**** 00111111 ********
-
-			// ERROR
-			// BaseXML10BS termination sequence doesn't store encoded bytes.
-			// That's the job of decode() to anticipate termination sequence and pass len to decodeblock().
-
-		} */
+		output = decode20( input );
 		
 	/* DEBUG: printf("DECODEBLOCK(%lu) output  32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(output)); */
 	
@@ -636,6 +1029,184 @@ unsigned char* decode_string(
 }
 
 
+/*
+** encode_string_into / decode_string_into
+**
+** Same as encode_string / decode_string, but write into a buffer owned
+** by the caller (the Javascript binding keeps a pooled scratch region):
+** nothing is allocated here, nothing has to be freed.
+** The output buffer must hold input_len*6/5 + 12 bytes when encoding,
+** input_len*5/6 + 5 bytes when decoding.
+** The output length is returned, not kept in output_len: no get_length()
+** call is needed afterwards and overlapping calls can't mix their lengths.
+*/
+
+unsigned long encode_string_into(
+		unsigned char* input_buffer, 
+		unsigned long input_len,
+		unsigned char* output_to
+		)
+{
+	unsigned long len_out = 0;
+	encodeblock(input_buffer, output_to, input_len, &len_out);
+	return len_out;
+}
+
+unsigned long decode_string_into(
+		unsigned char* input_buffer, 
+		unsigned long input_len,
+		unsigned char* output_to
+		)
+{
+	unsigned long len_out = 0;
+	decodeblock(input_buffer, output_to, input_len, &len_out);
+	return len_out;
+}
+
+
+/*
+** encode_string_utf16_into / decode_string_utf16_into
+**
+** Same as encode_string_into / decode_string_into, but the encoded side
+** is UTF-16 code units (what Javascript strings are made of) instead of
+** UTF-8 bytes. BaseXML only produces 1 byte and 2 bytes UTF-8 characters:
+** each of them is one code unit. The UTF-8 side only lives in a small
+** tile on the stack, there is no second pass over a full buffer.
+** The output must hold input_len*6/5 + 12 code units when encoding,
+** input_len*5/3 + 5 bytes when decoding. The output length is returned.
+*/
+#define UTF16_TILE 1200 // multiple of 5 and 6: tiles hold whole blocks
+
+unsigned long encode_string_utf16_into(
+		unsigned char* input_buffer, 
+		unsigned long input_len,
+		uint16_t* output_to
+		)
+{
+	unsigned char tile[UTF16_TILE*6/5 + 12];
+	unsigned long pos, n, k, tile_len, j = 0;
+
+	for( pos = 0; pos < input_len; pos += n ) {
+		n = input_len - pos < UTF16_TILE ? input_len - pos : UTF16_TILE;
+		encodeblock(input_buffer + pos, tile, n, &tile_len); // the termination only comes with the last tile
+		for( k = 0; k < tile_len; k++ ) {
+			if( tile[k] & 0x80 ) { // 110xxxxx 10xxxxxx
+				output_to[j++] = (uint16_t) (((tile[k] & 0x1f) << 6) | (tile[k+1] & 0x3f));
+				k++;
+			} else {
+				output_to[j++] = tile[k];
+			}
+		}
+	}
+	return j;
+}
+
+unsigned long decode_string_utf16_into(
+		uint16_t* input_buffer, 
+		unsigned long input_len,
+		unsigned char* output_to
+		)
+{
+	unsigned char tile[UTF16_TILE + 2];
+	unsigned long i, n, tile_len = 0, len_out, j = 0;
+	uint16_t c;
+
+	for( i = 0; i < input_len; i++ ) {
+		c = input_buffer[i];
+		if( c < 0x80 ) {
+			tile[tile_len++] = (unsigned char) c;
+		} else { // not BaseXML above 0x7ff: kept on 2 bytes, decodeblock is permissive anyway
+			if( c > 0x7ff ) c = 0x7ff;
+			tile[tile_len++] = (unsigned char) (0xc0 | (c >> 6));
+			tile[tile_len++] = (unsigned char) (0x80 | (c & 0x3f));
+		}
+		if( tile_len >= UTF16_TILE ) {
+			// decode whole groups, but keep the last 9+ bytes: they may be the termination
+			n = (tile_len - 9) / 6 * 6;
+			decodeblock(tile, output_to + j, n, &len_out);
+			j += len_out;
+			memmove(tile, tile + n, tile_len - n);
+			tile_len -= n;
+		}
+	}
+	decodeblock(tile, output_to + j, tile_len, &len_out);
+	return j + len_out;
+}
+
+
+/*
+** crc32c / encode_string_crc_into / decode_string_crc_into
+**
+** CRC32C (Castagnoli) of the raw data, from a byte table: neither asm.js
+** nor WebAssembly have a crc instruction. The _crc_into versions are
+** encode_string_into / decode_string_into computing it tile by tile,
+** while each tile is hot in cache, and storing it at crc_to.
+*/
+#define CRC_TILE 30000 // multiple of 5 and 6: tiles hold whole blocks
+
+static uint32_t crc32c_table[256];
+
+static uint32_t crc32c( uint32_t crc, const unsigned char *p, unsigned long len )
+{
+	uint32_t c;
+	int i, k;
+
+	if( !crc32c_table[1] ) {
+		for( i = 0; i < 256; i++ ) {
+			c = (uint32_t) i;
+			for( k = 0; k < 8; k++ )
+				c = c & 1 ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+			crc32c_table[i] = c;
+		}
+	}
+	crc = ~crc;
+	for( ; len; len--, p++ ) {
+		crc = crc32c_table[(crc ^ *p) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+unsigned long encode_string_crc_into(
+		unsigned char* input_buffer, 
+		unsigned long input_len,
+		unsigned char* output_to,
+		uint32_t* crc_to
+		)
+{
+	unsigned long pos, n, tile_len, j = 0;
+	uint32_t crc = 0;
+
+	for( pos = 0; pos < input_len; pos += n ) {
+		n = input_len - pos < CRC_TILE ? input_len - pos : CRC_TILE;
+		crc = crc32c(crc, input_buffer + pos, n);
+		encodeblock(input_buffer + pos, output_to + j, n, &tile_len); // the termination only comes with the last tile
+		j += tile_len;
+	}
+	*crc_to = crc;
+	return j;
+}
+
+unsigned long decode_string_crc_into(
+		unsigned char* input_buffer, 
+		unsigned long input_len,
+		unsigned char* output_to,
+		uint32_t* crc_to
+		)
+{
+	unsigned long pos, n, tile_len, j = 0;
+	uint32_t crc = 0;
+
+	for( pos = 0; pos < input_len; pos += n ) { // the last tile keeps the termination sequence
+		n = input_len - pos < CRC_TILE + 12 ? input_len - pos : CRC_TILE;
+		decodeblock(input_buffer + pos, output_to + j, n, &tile_len);
+		crc = crc32c(crc, output_to + j, tile_len);
+		j += tile_len;
+	}
+	*crc_to = crc;
+	return j;
+}
+
+
 int get_length() {
 	return output_len;
 }
@@ -0,0 +1,109 @@
+
+// This is BaseXML loader
+//
+// Picks the fastest BaseXML build the Javascript engine can run:
+//   wasm-basexml10-simd.js  WebAssembly with SIMD128 kernels
+//   wasm-basexml10.js       WebAssembly, scalar
+//   asmjs.js                asm.js, for engines without WebAssembly
+// See asmjs-basexml10.c for the build commands.
+//
+// <script src='basexml-loader.js'></script>
+// <script>
+//    BaseXMLLoader.load().then(function(BaseXML) {
+//       var encoded = BaseXML.encode( source );
+//    });
+// </script>
+
+var BaseXMLLoader = (function() {
+
+var BUILDS = {
+	'simd':  'wasm-basexml10-simd.js',
+	'wasm':  'wasm-basexml10.js',
+	'asmjs': 'asmjs.js'
+};
+
+// Smallest module using a v128 instruction: it only validates on SIMD128 engines.
+var SIMD128_TEST = new Uint8Array([0,97,115,109,1,0,0,0,1,5,1,96,0,1,123,3,2,1,0,10,10,1,8,0,65,0,253,15,253,98,11]);
+
+function detect() {
+	if (typeof WebAssembly !== 'object') {
+		return 'asmjs';
+	}
+	return WebAssembly.validate(SIMD128_TEST) ? 'simd' : 'wasm';
+}
+
+var ORDER = ['simd', 'wasm', 'asmjs'];
+
+// load([path], [build]): path is the folder of the builds (default: this script's one),
+// build forces one of 'simd', 'wasm' or 'asmjs' (default: detect(), then the next
+// ones down to the pre-built asmjs.js if a build can't be found).
+function load(path, build) {
+	return load_build(path, build || detect(), !!build);
+}
+
+function load_build(path, build, forced) {
+	if (!BUILDS[build]) {
+		return Promise.reject(new Error('BaseXML: unknown build ' + build));
+	}
+
+	function next(error) {
+		if (forced || build === 'asmjs') throw error;
+		return load_build(path, ORDER[ORDER.indexOf(build) + 1], false);
+	}
+
+	if (typeof process === 'object' && typeof require === 'function') { // Node (main thread or worker_threads)
+		var file = require('path').join(path || __dirname, BUILDS[build]);
+		if (!require('fs').existsSync(file)) {
+			return Promise.resolve(null).then(function() { return next(new Error('BaseXML: cannot load ' + file)); });
+		}
+		return require_node(file, build);
+	}
+
+	var src = (path ? path.replace(/\/?$/, '/') : '') + BUILDS[build];
+
+	if (typeof importScripts === 'function') { // Web Worker
+		try {
+			importScripts(src);
+		} catch (e) {
+			return Promise.resolve(null).then(function() { return next(e); });
+		}
+		return self['BaseXML']['ready'] || Promise.resolve(self['BaseXML']);
+	}
+
+	return new Promise(function(resolve, reject) { // Browser
+		var script = document.createElement('script');
+		script.src = src;
+		script.onload = function() {
+			resolve(self['BaseXML']['ready'] || self['BaseXML']);
+		};
+		script.onerror = function() {
+			reject(new Error('BaseXML: cannot load ' + script.src));
+		};
+		document.head.appendChild(script);
+	}).catch(next);
+}
+
+function require_node(file, build) {
+	// The pre-built asmjs.js predates Node support and expects a browser window.
+	// Don't fake one for WebAssembly builds: they would take Node for a browser.
+	var fake_window = build === 'asmjs' && !('window' in global);
+	if (fake_window) global.window = global;
+	try {
+		var mod = require(file);
+		if (!mod || !mod['encode']) mod = global.window['BaseXML'];
+	} finally {
+		if (fake_window) delete global.window;
+	}
+	return mod['ready'] || Promise.resolve(mod);
+}
+
+return {
+	'BUILDS': BUILDS,
+	'ORDER': ORDER,
+	'detect': detect,
+	'load': load
+};
+})();
+
+if (typeof self === 'object') self['BaseXMLLoader'] = BaseXMLLoader;
+if (typeof module === 'object' && module['exports']) module['exports'] = BaseXMLLoader;
@@ -0,0 +1,234 @@
+
+// This is BaseXML parallel
+//
+// Opt-in parallel encoding/decoding of large data on a pool of workers
+// (Node worker_threads or Web Workers) sharing SharedArrayBuffers.
+// The input is cut on 5 bytes (encode) or 6 bytes (decode) boundaries,
+// since each block of 5 bytes becomes exactly 6 bytes. Every worker runs
+// the BaseXML kernel (WebAssembly or asm.js, see basexml-loader.js) on
+// its slices and writes the result straight at its final place in the
+// shared output: there is nothing to assemble afterwards.
+//
+//   var pool = BaseXMLParallel.create({ workers: 4 });
+//   pool.encode( source ).then(function(encoded) { ... });
+//   pool.decode( encoded ).then(function(decoded) { ... });
+//   pool.terminate();
+//
+// Results are Uint8Array views of a SharedArrayBuffer. An input already in
+// a SharedArrayBuffer is used as is, any other input is copied into one.
+// Browsers only provide SharedArrayBuffer to cross-origin isolated pages.
+
+var BaseXMLParallel = (function() {
+
+var IS_NODE = typeof process === 'object' && typeof require === 'function';
+var WORKER_TAG = 'basexml-parallel-worker';
+
+// Slices are cut on multiples of 30 bytes: whole blocks both ways
+var SLICE_DEFAULT = 1024 * 1020;
+
+/*
+** Worker side
+*/
+
+function worker_main(path, build, on_message, post) {
+	var loader = IS_NODE ? require('./basexml-loader.js') : (importScripts(path + 'basexml-loader.js'), self['BaseXMLLoader']);
+	var ready = loader.load(IS_NODE ? __dirname : path, build || undefined);
+	on_message(function(job) {
+		ready.then(function(BaseXML) {
+			// Copy the slice in the kernel's heap, run it, then write the result at its place
+			var input = new Uint8Array(job.input, job.in_start, job.in_end - job.in_start);
+			var result = BaseXML[job.op + 'View'] ? BaseXML[job.op + 'View'](input) : BaseXML[job.op](input);
+			new Uint8Array(job.output, job.out_start, result.length).set(result);
+			if (!BaseXML['release']) { // builds without a pooled scratch region leave each call in the heap
+				BaseXML._free(BaseXML['input_ptr']);
+				BaseXML._free(BaseXML['output_ptr']);
+			}
+			post({ id: job.id, len: result.length });
+		}).catch(function(e) {
+			post({ id: job.id, error: String(e && e.message || e) });
+		});
+	});
+}
+
+if (IS_NODE) {
+	var worker_threads = require('worker_threads');
+	if (!worker_threads.isMainThread && worker_threads.workerData && worker_threads.workerData[WORKER_TAG]) {
+		worker_main('', worker_threads.workerData.build,
+			function(fn) { worker_threads.parentPort.on('message', fn); },
+			function(msg) { worker_threads.parentPort.postMessage(msg); });
+		return null;
+	}
+} else if (typeof importScripts === 'function' && self.location.hash === '#' + WORKER_TAG) {
+	var worker_build = /[?&]build=(\w+)/.exec(self.location.search);
+	worker_main(self.location.href.replace(/[^\/]*$/, ''), worker_build && worker_build[1],
+		function(fn) { self.onmessage = function(e) { fn(e.data); }; },
+		function(msg) { self.postMessage(msg); });
+	return null;
+}
+
+var SCRIPT_URL = (typeof document === 'object' && document.currentScript) ? document.currentScript.src : '';
+
+/*
+** Sizes, known before any encoding/decoding work
+*/
+
+// 6 bytes per 5 bytes block, the last partial one comes with a termination sequence
+function encoded_size(len) {
+	var rest = len % 5;
+	return Math.floor(len / 5) * 6 + (rest === 0 ? 0 : (rest <= 2 ? 6 : 9));
+}
+
+// From the termination sequence 0x3f 0x3X 0x3f: after the last 6 bytes
+// when 3 or 4 bytes are left, inside them when 1 or 2 bytes are left
+function decoded_size(input) {
+	var len = input.length;
+	if (len >= 9 && len % 6 === 3 && input[len - 3] === 0x3f && input[len - 1] === 0x3f) {
+		return (len - 3) / 6 * 5 - 5 + (input[len - 2] & 0x07);
+	}
+	if (len >= 6 && len % 6 === 0 && input[len - 3] === 0x3f && input[len - 1] === 0x3f) {
+		return len / 6 * 5 - 5 + (input[len - 2] & 0x07);
+	}
+	return Math.floor(len / 6) * 5;
+}
+
+function shared(input) {
+	if (typeof SharedArrayBuffer === 'undefined') {
+		throw new Error('BaseXML: SharedArrayBuffer is not available (browsers need cross-origin isolation)');
+	}
+	if (input.buffer instanceof SharedArrayBuffer) {
+		return input;
+	}
+	var copy = new Uint8Array(new SharedArrayBuffer(input.length));
+	copy.set(input);
+	return copy;
+}
+
+/*
+** Pool
+*/
+
+// create([options]): options.workers (default: number of CPUs), options.slice (bytes of
+// input per job), options.build (force 'simd', 'wasm' or 'asmjs'), options.script (URL
+// of this file, browsers only, when it can't be found from the <script> tag).
+function create(options) {
+	options = options || {};
+	var n = options.workers ||
+		(IS_NODE ? require('os').cpus().length : (navigator.hardwareConcurrency || 4));
+	var slice = Math.max(30, Math.floor((options.slice || SLICE_DEFAULT) / 30) * 30);
+	var workers = [], idle = [], queue = [], next_id = 0;
+
+	function dispatch() {
+		while (idle.length && queue.length) {
+			var worker = idle.pop(), job = queue.shift();
+			worker.job = job;
+			worker.post(job.msg);
+		}
+	}
+
+	function done(worker, msg) {
+		var job = worker.job;
+		worker.job = null;
+		worker.idle();
+		idle.push(worker);
+		job.callback(msg);
+		dispatch();
+	}
+
+	for (var i = 0; i < n; i++) {
+		(function(worker) {
+			if (IS_NODE) {
+				var WorkerThread = require('worker_threads').Worker;
+				var data = {};
+				data[WORKER_TAG] = true;
+				data.build = options.build || '';
+				var thread = new WorkerThread(__filename, { workerData: data });
+				thread.on('message', function(msg) { done(worker, msg); });
+				thread.on('error', function(e) { if (worker.job) done(worker, { error: String(e && e.message || e) }); });
+				thread.unref(); // an idle pool doesn't keep Node alive, a busy worker does
+				worker.post = function(msg) { thread.ref(); thread.postMessage(msg); };
+				worker.idle = function() { thread.unref(); };
+				worker.terminate = function() { return thread.terminate(); };
+			} else {
+				var url = (options.script || SCRIPT_URL) + (options.build ? '?build=' + options.build : '') + '#' + WORKER_TAG;
+				var web_worker = new Worker(url);
+				web_worker.onmessage = function(e) { done(worker, e.data); };
+				web_worker.onerror = function(e) { if (worker.job) done(worker, { error: String(e && e.message || e) }); };
+				worker.post = function(msg) { web_worker.postMessage(msg); };
+				worker.idle = function() {};
+				worker.terminate = function() { web_worker.terminate(); };
+			}
+			workers.push(worker);
+			idle.push(worker);
+		})({ job: null });
+	}
+
+	// Queue the jobs of one operation, resolve once all of them are done
+	function run(op, input, output, jobs) {
+		return new Promise(function(resolve, reject) {
+			var left = jobs.length, failed = false;
+			if (!left) {
+				resolve(output);
+				return;
+			}
+			jobs.forEach(function(job) {
+				queue.push({
+					msg: { id: next_id++, op: op, input: input.buffer, in_start: input.byteOffset + job[0],
+					       in_end: input.byteOffset + job[1], output: output.buffer, out_start: output.byteOffset + job[2] },
+					callback: function(msg) {
+						if (failed) return;
+						if (msg.error) {
+							failed = true;
+							reject(new Error(msg.error));
+						} else if (--left === 0) {
+							resolve(output);
+						}
+					}
+				});
+			});
+			dispatch();
+		});
+	}
+
+	function encode(input_array) {
+		var input = shared(input_array), len = input.length, jobs = [];
+		var output = new Uint8Array(new SharedArrayBuffer(encoded_size(len)));
+		for (var start = 0; start < len; start += slice) {
+			jobs.push([start, Math.min(len, start + slice), start / 5 * 6]);
+		}
+		return run('encode', input, output, jobs);
+	}
+
+	function decode(input_array) {
+		var input = shared(input_array), len = input.length, jobs = [], end;
+		var output = new Uint8Array(new SharedArrayBuffer(decoded_size(input)));
+		for (var start = 0; start < len; start = end) {
+			end = start + slice;
+			if (end > len - 9) end = len; // the termination sequence stays with the last slice
+			jobs.push([start, end, start / 6 * 5]);
+		}
+		return run('decode', input, output, jobs);
+	}
+
+	function terminate() {
+		return Promise.all(workers.map(function(worker) { return worker.terminate(); }));
+	}
+
+	return {
+		'encode': encode,
+		'decode': decode,
+		'terminate': terminate,
+		'workers': n
+	};
+}
+
+return {
+	'create': create,
+	'encoded_size': encoded_size,
+	'decoded_size': decoded_size
+};
+})();
+
+if (BaseXMLParallel) {
+	if (typeof self === 'object') self['BaseXMLParallel'] = BaseXMLParallel;
+	if (typeof module === 'object' && module['exports']) module['exports'] = BaseXMLParallel;
+}
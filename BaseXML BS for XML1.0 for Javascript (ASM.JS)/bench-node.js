@@ -0,0 +1,95 @@
+
+// This is BaseXML Node benchmark
+//
+// Compares the encoding/decoding speed of the asm.js build with the
+// WebAssembly builds (the ones found next to this file, see
+// asmjs-basexml10.c for the build commands), then of the parallel
+// pool (basexml-parallel.js) on <Workers> threads (default: all CPUs).
+//
+// Usage: node bench-node.js [<PayloadMB> [<Runs> [<Workers>]]]
+// Speeds are given in MB/s of unencoded data, best of <Runs>.
+
+var fs = require('fs');
+var path = require('path');
+var BaseXMLLoader = require('./basexml-loader.js');
+var BaseXMLParallel = require('./basexml-parallel.js');
+
+var payload_mb = parseFloat(process.argv[2]) || 4;
+var runs = parseInt(process.argv[3], 10) || 10;
+var workers = parseInt(process.argv[4], 10) || require('os').cpus().length;
+
+// asm.js heap is fixed (16MB by default): keep the payload reasonable for it
+// (in a SharedArrayBuffer, so that the parallel pool doesn't copy it)
+var source = new Uint8Array(new SharedArrayBuffer(Math.floor(payload_mb * 1024 * 1024)));
+for (var i = 0; i < source.length; i++) {
+	source[i] = (Math.random() * 256) | 0;
+}
+
+function now_ms() {
+	return Number(process.hrtime.bigint()) / 1e6;
+}
+
+function same(a, b) {
+	if (a.length !== b.length) return false;
+	for (var i = 0; i < a.length; i++) {
+		if (a[i] !== b[i]) return false;
+	}
+	return true;
+}
+
+// Time one call. Builds without a pooled scratch region (no release())
+// leave the buffers of each call in the heap: free them between runs.
+async function timed(BaseXML, fn, input) {
+	var t = now_ms();
+	var output = await BaseXML[fn](input);
+	t = now_ms() - t;
+	if (BaseXML._free && !BaseXML['release']) {
+		output = output.slice(); // copy out of the heap before freeing it
+		BaseXML._free(BaseXML['input_ptr']);
+		BaseXML._free(BaseXML['output_ptr']);
+	}
+	return { time: t, output: output };
+}
+
+async function bench(name, BaseXML) {
+	var best_enc = Infinity, best_dec = Infinity;
+	var encoded, decoded, r;
+	for (var run = 0; run < runs; run++) {
+		r = await timed(BaseXML, 'encode', source);
+		encoded = r.output;
+		best_enc = Math.min(best_enc, r.time);
+		r = await timed(BaseXML, 'decode', encoded);
+		decoded = r.output;
+		best_dec = Math.min(best_dec, r.time);
+	}
+	var mb = source.length / (1024 * 1024);
+	console.log(
+		(name + '            ').slice(0, 12) +
+		'  encode ' + (mb / best_enc * 1000).toFixed(1) + ' MB/s' +
+		'  decode ' + (mb / best_dec * 1000).toFixed(1) + ' MB/s' +
+		'  ' + (same(decoded, source) ? 'OK' : 'MISMATCH'));
+}
+
+async function main() {
+	console.log('Payload ' + payload_mb + ' MB, best of ' + runs + ' runs, engine ' + process.version +
+		', SIMD128 ' + (BaseXMLLoader.detect() === 'simd' ? 'supported' : 'not supported'));
+
+	var builds = ['simd', 'wasm'];
+	for (var b = 0; b < builds.length; b++) {
+		if (!fs.existsSync(path.join(__dirname, BaseXMLLoader.BUILDS[builds[b]]))) {
+			console.log((builds[b] + '            ').slice(0, 12) + '  not built');
+			continue;
+		}
+		await bench(builds[b], await BaseXMLLoader.load(__dirname, builds[b]));
+	}
+
+	var asmjs = await BaseXMLLoader.load(__dirname, 'asmjs');
+	await bench('asmjs', asmjs);
+
+	// Best build found, on every worker
+	var pool = BaseXMLParallel.create({ workers: workers });
+	await bench('parallel x' + workers, pool);
+	await pool.terminate();
+}
+
+main();
@@ -0,0 +1,229 @@
+/*********************************************************************\
+
+BaseXML - SIMD128 kernels check
+
+USAGE            :  emcc -O2 -msimd128 simd128-check.c -o simd128-check.js
+					 node simd128-check.js
+					Without Emscripten, the kernels run on a portable
+					 emulation of the wasm_* calls they use (little
+					 endian hosts):
+					 gcc -O2 -DBASEXML_SIMD128_EMULATED simd128-check.c -o simd128-check.exe
+					 simd128-check.exe
+
+DESCRIPTION      :  Checks encodeblock_simd128 / decodeblock_simd128
+					 against the scalar encode20 / decode20, exhaustively
+					 and on every lane:
+					 - encode of all 2^20 groups of 20 bits,
+					 - decode of their 2^20 encodings, which must give
+					   the groups back,
+					 - decode of all 2^24 groups of 3 bytes, bit for bit
+					   (0 for the undecodable ones),
+					 then encodeblock / decodeblock round trips of random
+					 data of every length up to 1 KB.
+					Prints the number of mismatches, exits with 1 if any.
+
+\******************************************************************** */
+
+#if defined(BASEXML_SIMD128_EMULATED) && !defined(__wasm_simd128__)
+#include <stdint.h>
+#include <string.h>
+
+typedef union { uint8_t u8[16]; uint32_t u32[4]; uint64_t u64[2]; } v128_t;
+
+static v128_t wasm_v128_load( const void *p ) { v128_t r; memcpy( r.u8, p, 16 ); return r; }
+static void wasm_v128_store( void *p, v128_t a ) { memcpy( p, a.u8, 16 ); }
+static v128_t wasm_i32x4_splat( int32_t x ) { v128_t r; int k; for( k = 0; k < 4; k++ ) r.u32[k] = (uint32_t) x; return r; }
+static v128_t wasm_i64x2_splat( int64_t x ) { v128_t r; r.u64[0] = r.u64[1] = (uint64_t) x; return r; }
+static v128_t wasm_i8x16_splat( int8_t x ) { v128_t r; memset( r.u8, (uint8_t) x, 16 ); return r; }
+static v128_t wasm_i32x4_make( int32_t a, int32_t b, int32_t c, int32_t d ) { v128_t r; r.u32[0] = (uint32_t) a; r.u32[1] = (uint32_t) b; r.u32[2] = (uint32_t) c; r.u32[3] = (uint32_t) d; return r; }
+static v128_t wasm_i8x16_make( int8_t c0, int8_t c1, int8_t c2, int8_t c3, int8_t c4, int8_t c5, int8_t c6, int8_t c7,
+                               int8_t c8, int8_t c9, int8_t c10, int8_t c11, int8_t c12, int8_t c13, int8_t c14, int8_t c15 )
+{
+	int8_t c[16] = { c0, c1, c2, c3, c4, c5, c6, c7, c8, c9, c10, c11, c12, c13, c14, c15 };
+	v128_t r;
+	memcpy( r.u8, c, 16 );
+	return r;
+}
+static v128_t wasm_v128_and( v128_t a, v128_t b ) { int k; for( k = 0; k < 2; k++ ) a.u64[k] &= b.u64[k]; return a; }
+static v128_t wasm_v128_or( v128_t a, v128_t b ) { int k; for( k = 0; k < 2; k++ ) a.u64[k] |= b.u64[k]; return a; }
+static v128_t wasm_v128_not( v128_t a ) { int k; for( k = 0; k < 2; k++ ) a.u64[k] = ~a.u64[k]; return a; }
+static v128_t wasm_v128_bitselect( v128_t a, v128_t b, v128_t m ) { int k; for( k = 0; k < 2; k++ ) a.u64[k] = (a.u64[k] & m.u64[k]) | (b.u64[k] & ~m.u64[k]); return a; }
+static v128_t wasm_i32x4_eq( v128_t a, v128_t b ) { int k; for( k = 0; k < 4; k++ ) a.u32[k] = a.u32[k] == b.u32[k] ? 0xffffffff : 0; return a; }
+static v128_t wasm_i8x16_eq( v128_t a, v128_t b ) { int k; for( k = 0; k < 16; k++ ) a.u8[k] = a.u8[k] == b.u8[k] ? 0xff : 0; return a; }
+static v128_t wasm_i32x4_mul( v128_t a, v128_t b ) { int k; for( k = 0; k < 4; k++ ) a.u32[k] *= b.u32[k]; return a; }
+static v128_t wasm_i32x4_shl( v128_t a, uint32_t n ) { int k; for( k = 0; k < 4; k++ ) a.u32[k] <<= n & 31; return a; }
+static v128_t wasm_u32x4_shr( v128_t a, uint32_t n ) { int k; for( k = 0; k < 4; k++ ) a.u32[k] >>= n & 31; return a; }
+static v128_t wasm_i64x2_shl( v128_t a, uint32_t n ) { int k; for( k = 0; k < 2; k++ ) a.u64[k] <<= n & 63; return a; }
+static v128_t wasm_u64x2_shr( v128_t a, uint32_t n ) { int k; for( k = 0; k < 2; k++ ) a.u64[k] >>= n & 63; return a; }
+static v128_t wasm_i8x16_swizzle( v128_t a, v128_t s ) { v128_t r; int k; for( k = 0; k < 16; k++ ) r.u8[k] = s.u8[k] < 16 ? a.u8[s.u8[k]] : 0; return r; }
+#endif
+
+#include "asmjs-basexml10.c"
+
+#ifndef BASEXML_SIMD128
+#error "build with emcc -msimd128, or with -DBASEXML_SIMD128_EMULATED"
+#endif
+
+#define GROUPS (1UL << 20)
+
+static unsigned long errors = 0;
+
+static void mismatch( const char *what, unsigned long group, uint32_t got, uint32_t expected )
+{
+	if( errors++ < 10 ) {
+		printf( "%s: group %06lx gives %06lx instead of %06lx\n", what, group, (unsigned long) got, (unsigned long) expected );
+	}
+}
+
+// group k of 20 bits of a block of 5 bytes, at the top of the result as for encode20
+static uint32_t get20( const unsigned char *p, unsigned long k )
+{
+	p += k / 2 * 5;
+	return k % 2 ? (uint32_t) p[2] << 28 | (uint32_t) p[3] << 20 | (uint32_t) p[4] << 12
+	             : (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) (p[2] & 0xF0) << 8;
+}
+
+static void put20( unsigned char *p, unsigned long k, uint32_t v )
+{
+	p += k / 2 * 5;
+	if( k % 2 ) {
+		p[2] = (unsigned char) ((p[2] & 0xF0) | ((v >> 28) & 0x0F));
+		p[3] = (unsigned char) (v >> 20);
+		p[4] = (unsigned char) (v >> 12);
+	} else {
+		p[0] = (unsigned char) (v >> 24);
+		p[1] = (unsigned char) (v >> 16);
+		p[2] = (unsigned char) ((p[2] & 0x0F) | ((v >> 8) & 0xF0));
+	}
+}
+
+static uint32_t get24( const unsigned char *p, unsigned long k )
+{
+	p += k * 3;
+	return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8;
+}
+
+/*
+** check_groups
+**
+** Encode all the 2^20 groups, then decode their encodings. The kernels
+** put 4 groups side by side: group k is laid out at position k ^ lane,
+** so that every group goes through every lane once.
+*/
+static void check_groups( unsigned char *raw, unsigned char *enc, unsigned char *dec )
+{
+	unsigned long k, done;
+	uint32_t lane;
+
+	for( lane = 0; lane < 4; lane++ ) {
+		for( k = 0; k < GROUPS; k++ ) {
+			put20( raw, k ^ lane, (uint32_t) k << 12 );
+		}
+		memset( raw + GROUPS / 2 * 5, 0, 16 );
+		done = encodeblock_simd128( raw, enc, GROUPS / 2 * 5 + 6 ); // 6 more bytes: the last block goes through the kernel too
+		if( done < GROUPS / 2 * 5 ) {
+			printf( "encode: the kernel stopped at byte %lu\n", done );
+			errors++;
+			return;
+		}
+		for( k = 0; k < GROUPS; k++ ) {
+			if( get24( enc, k ^ lane ) != encode20( (uint32_t) k << 12 ) ) {
+				mismatch( "encode", k, get24( enc, k ^ lane ) >> 8, encode20( (uint32_t) k << 12 ) >> 8 );
+			}
+		}
+
+		memset( enc + GROUPS * 3, 0, 16 );
+		done = decodeblock_simd128( enc, dec, GROUPS * 3 + 12 ); // 12 more bytes: the kernel leaves them to the scalar code
+		if( done < GROUPS * 3 ) {
+			printf( "decode: the kernel stopped at byte %lu\n", done );
+			errors++;
+			return;
+		}
+		for( k = 0; k < GROUPS; k++ ) {
+			if( get20( dec, k ^ lane ) != (uint32_t) k << 12 ) {
+				mismatch( "decode", k, get20( dec, k ^ lane ) >> 12, (uint32_t) k );
+			}
+		}
+	}
+}
+
+/*
+** check_triples
+**
+** Decode all the 2^24 groups of 3 bytes, valid or not, through every
+** lane, and compare them bit for bit with decode20.
+*/
+static void check_triples( unsigned char *enc, unsigned char *dec )
+{
+	unsigned long base, k;
+	uint32_t lane, t;
+
+	for( lane = 0; lane < 4; lane++ ) {
+		for( base = 0; base < (1UL << 24); base += GROUPS ) {
+			for( k = 0; k < GROUPS; k++ ) {
+				t = (uint32_t) (base + (k ^ lane));
+				enc[k * 3]     = (unsigned char) (t >> 16);
+				enc[k * 3 + 1] = (unsigned char) (t >> 8);
+				enc[k * 3 + 2] = (unsigned char) t;
+			}
+			memset( enc + GROUPS * 3, 0, 16 );
+			decodeblock_simd128( enc, dec, GROUPS * 3 + 12 );
+			for( k = 0; k < GROUPS; k++ ) {
+				t = (uint32_t) (base + (k ^ lane)) << 8;
+				if( get20( dec, k ) != (decode20( t ) & 0xfffff000) ) {
+					mismatch( "decode (3 bytes)", t >> 8, get20( dec, k ) >> 12, decode20( t ) >> 12 );
+				}
+			}
+		}
+	}
+}
+
+/*
+** check_blocks
+**
+** encodeblock / decodeblock round trips, kernel plus scalar tail and
+** termination, for every length up to 1 KB.
+*/
+static void check_blocks( unsigned char *raw, unsigned char *enc, unsigned char *dec )
+{
+	unsigned long len, enc_len, dec_len, k;
+
+	srand( 1 );
+	for( k = 0; k < 1024; k++ ) {
+		raw[k] = (unsigned char) rand();
+	}
+	for( len = 0; len <= 1024; len++ ) {
+		encodeblock( raw, enc, len, &enc_len );
+		for( k = 0; k < len / 5 * 2; k++ ) {
+			if( get24( enc, k ) != encode20( get20( raw, k ) ) ) {
+				mismatch( "encodeblock", k, get24( enc, k ) >> 8, encode20( get20( raw, k ) ) >> 8 );
+			}
+		}
+		memset( enc + enc_len, 0, 16 );
+		decodeblock( enc, dec, enc_len, &dec_len );
+		if( dec_len != len || memcmp( dec, raw, len ) ) {
+			printf( "round trip: %lu bytes come back as %lu different bytes\n", len, dec_len );
+			errors++;
+		}
+	}
+}
+
+int main( void )
+{
+	unsigned char *raw = malloc( GROUPS / 2 * 5 + 16 );
+	unsigned char *enc = malloc( GROUPS * 3 + 16 );
+	unsigned char *dec = malloc( GROUPS / 2 * 5 + 16 );
+
+	if( !raw || !enc || !dec ) {
+		printf( "out of memory\n" );
+		return 1;
+	}
+	check_groups( raw, enc, dec );
+	check_triples( enc, dec );
+	check_blocks( raw, enc, dec );
+	printf( "%lu mismatches\n", errors );
+	free( raw );
+	free( enc );
+	free( dec );
+	return errors ? 1 : 0;
+}
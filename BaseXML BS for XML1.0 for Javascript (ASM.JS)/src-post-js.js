@@ -1,34 +1,149 @@
+// Javascript API of the builds made from asmjs-basexml10.c with this file.
+// The pre-built asmjs.js (2014) predates it: there, encode()/decode() return views
+// into the heap, and the caller frees BaseXML.input_ptr and BaseXML.output_ptr
+// (see asmjs-basexml10-build.html). Of the calls below, it only has encode(),
+// decode(), Pointer_Uint8Arrayfy(), str2tarr() and hex_dump_tarr().
 
-// Save last values
-Module['input_ptr'] = 0;
-Module['output_ptr'] = 0;
 
-function encode(input_array) {
+// Scratch region of the heap: [input | output] of the last call.
+// It is allocated once and only grows, so that memory stays flat
+// whatever the number of calls. release() gives it back.
+var scratch_ptr = 0;
+var scratch_size = 0;
+
+function scratch(size) {
+	if (size > scratch_size) {
+		if (scratch_ptr) Module._free(scratch_ptr);
+		scratch_size = 1 << Math.ceil(Math.log(Math.max(size, 4096)) / Math.LN2); // grow by powers of 2
+		scratch_ptr = Module._malloc(scratch_size);
+		if (!scratch_ptr) {
+			scratch_size = 0;
+			throw new Error('BaseXML: out of memory (' + size + ' bytes)');
+		}
+	}
+	return scratch_ptr;
+}
+
+function release() {
+	if (scratch_ptr) Module._free(scratch_ptr);
+	scratch_ptr = 0;
+	scratch_size = 0;
+}
+Module['release'] = release;
+
+// Runs fn(BaseXML) then releases the scratch region, whatever happens.
+// Views returned by encodeView()/decodeView() in fn are only valid in fn.
+function scoped(fn) {
+	try {
+		return fn(Module);
+	} finally {
+		release();
+	}
+}
+Module['scoped'] = scoped;
+
+// Encoded size is input_len*6/5 + 12, decoded size input_len*5/6 + 5 (see encode_string_into):
+// the output region is sized here, and the native function returns the actual length,
+// so that one direct call to the export is the only JS<->native crossing.
+function run(fn, input_array, output_max) {
 	var input_len = input_array.length;
-	Module['input_ptr'] = Module._malloc(input_len);
-	Module.HEAPU8.set(input_array, Module['input_ptr']);
-	Module['output_ptr'] = Module.ccall('encode_string', 'pointer', ['pointer','number'], [Module['input_ptr'],input_len]);
-	var output_len = Module.ccall('get_length','number');
-	var output_array = Pointer_Uint8Arrayfy(Module['output_ptr'], output_len);
-	//Module._free(Module['input_ptr']);  // Too risky. Manual choice.
-	//Module._free(Module['output_ptr']); // Too risky. Manual choice.
-	return output_array;
+	var input_ptr = scratch(((input_len + 7) & ~7) + output_max);
+	var output_ptr = input_ptr + ((input_len + 7) & ~7);
+	Module.HEAPU8.set(input_array, input_ptr);
+	var output_len = fn(input_ptr, input_len, output_ptr) >>> 0;
+	Module['input_ptr'] = input_ptr;
+	Module['output_ptr'] = output_ptr;
+	return Pointer_Uint8Arrayfy(output_ptr, output_len);
+}
+
+// ZERO-COPY views of the scratch region: fastest, but only valid until the
+// next BaseXML call, release() or heap growth. Copy them (.slice()) to keep them.
+function encodeView(input_array) {
+	return run(Module['_encode_string_into'], input_array, Math.floor(input_array.length * 6 / 5) + 12);
+}
+Module['encodeView'] = encodeView;
+
+function decodeView(input_array) {
+	return run(Module['_decode_string_into'], input_array, Math.floor(input_array.length * 5 / 6) + 5);
+}
+Module['decodeView'] = decodeView;
+
+// SAFE copies, owned by the caller
+// With crc32, the CRC32C of the raw data comes in the same native pass:
+// encode(input_array, true) gives [encoded, crc], decode(input_array, crc)
+// throws if the decoded data doesn't match crc.
+function encode(input_array, crc32) {
+	if (crc32) {
+		return run_crc(Module['_encode_string_crc_into'], input_array, Math.floor(input_array.length * 6 / 5) + 12);
+	}
+	return new Uint8Array(encodeView(input_array));
 }
 Module['encode'] = encode;
 
-function decode(input_array) {
-	var input_len = input_array.length;
-	Module['input_ptr'] = Module._malloc(input_len);	
-	Module.HEAPU8.set(input_array, Module['input_ptr']);
-	Module['output_ptr'] = Module.ccall('decode_string', 'pointer', ['pointer','number'], [Module['input_ptr'],input_len]);
-	var output_len = Module.ccall('get_length','number');
-	var output_array = Pointer_Uint8Arrayfy(Module['output_ptr'], output_len);
-	//Module._free(Module['input_ptr']);  // Too risky. Manual choice.
-	//Module._free(Module['output_ptr']); // Too risky. Manual choice.
-	return output_array;
+function decode(input_array, crc32) {
+	if (typeof crc32 === 'number') {
+		var result = run_crc(Module['_decode_string_crc_into'], input_array, Math.floor(input_array.length * 5 / 6) + 5);
+		if (result[1] !== crc32 >>> 0) {
+			throw new Error('BaseXML: CRC32C mismatch (' + result[1].toString(16) + ', expected ' + (crc32 >>> 0).toString(16) + '), decoded data is corrupted');
+		}
+		return result[0];
+	}
+	return new Uint8Array(decodeView(input_array));
 }
 Module['decode'] = decode;
 
+function run_crc(fn, input_array, output_max) {
+	var input_len = input_array.length;
+	var input_size = (input_len + 7) & ~7;
+	var crc_ptr = scratch(input_size + 8 + output_max) + input_size;
+	var input_ptr = crc_ptr - input_size, output_ptr = crc_ptr + 8;
+	var heap = Module.HEAPU8;
+	heap.set(input_array, input_ptr);
+	var output_len = fn(input_ptr, input_len, output_ptr, crc_ptr) >>> 0;
+	heap = Module.HEAPU8; // (the heap may have grown)
+	var crc = (heap[crc_ptr] | heap[crc_ptr + 1] << 8 | heap[crc_ptr + 2] << 16 | heap[crc_ptr + 3] << 24) >>> 0;
+	return [Pointer_new_Uint8Arrayfy(output_ptr, output_len), crc];
+}
+
+
+// STRINGS: BaseXML output is meant to be XML text. encodeToString() gives it as
+// a Javascript string, decodeFromString() takes it back, without going through
+// UTF-8 bytes and TextDecoder/TextEncoder: the native code reads/writes UTF-16.
+function encodeToString(input_array) {
+	var input_len = input_array.length;
+	var input_size = (input_len + 7) & ~7;
+	var input_ptr = scratch(input_size + (Math.floor(input_len * 6 / 5) + 12) * 2);
+	var output_ptr = input_ptr + input_size;
+	Module.HEAPU8.set(input_array, input_ptr);
+	var units = Module['_encode_string_utf16_into'](input_ptr, input_len, output_ptr) >>> 0;
+	return Pointer_UTF16ToString(output_ptr, units);
+}
+Module['encodeToString'] = encodeToString;
+
+function decodeFromString(str) {
+	var units = str.length;
+	var input_size = (units * 2 + 7) & ~7;
+	var input_ptr = scratch(input_size + Math.floor(units * 5 / 3) + 5);
+	var output_ptr = input_ptr + input_size;
+	var heap16 = Module.HEAPU16, i16 = input_ptr >> 1;
+	for (var i = 0; i < units; i++) {
+		heap16[i16 + i] = str.charCodeAt(i);
+	}
+	var output_len = Module['_decode_string_utf16_into'](input_ptr, units, output_ptr) >>> 0;
+	return Pointer_new_Uint8Arrayfy(output_ptr, output_len);
+}
+Module['decodeFromString'] = decodeFromString;
+
+// Helper to build a string from UTF-16 code units of ASM.JS memory, by slices
+// small enough for String.fromCharCode.apply
+function Pointer_UTF16ToString(ptr, units) {
+	var heap16 = Module.HEAPU16, i16 = ptr >> 1, parts = [];
+	for (var i = 0; i < units; i += 0x2000) {
+		parts.push(String.fromCharCode.apply(null, heap16.subarray(i16 + i, i16 + Math.min(i + 0x2000, units))));
+	}
+	return parts.join('');
+}
+
 
 // Helper to extract data from ASM.JS memory
 function Pointer_Uint8Arrayfy(ptr, length) {
@@ -36,14 +151,14 @@ function Pointer_Uint8Arrayfy(ptr, length) {
 }
 
 function Pointer_new_Uint8Arrayfy(ptr, length) {
-	var newtarr = new Uint8Array();
-	return Module.HEAPU8.subarray(ptr, ptr + length); // Not NEW to avoid memory duplication (performance loss)... but risky.
+	return new Uint8Array(Module.HEAPU8.subarray(ptr, ptr + length)); // NEW: copied out of the heap, safe.
 }
 
-
+Module['Pointer_new_Uint8Arrayfy'] = Pointer_new_Uint8Arrayfy;
 Module['Pointer_Uint8Arrayfy'] = Pointer_Uint8Arrayfy;
 
 // Helper for demo: converts a string to an Uint8Array (typed array)
+// (BaseXML encoded strings don't need it: use decodeFromString)
 function str2tarr(str) {
 	var bufView = new Uint8Array(str.length);
 	for (var i=0, strLen=str.length; i<strLen; i++) {
@@ -62,6 +177,19 @@ function hex_dump_tarr(tarr) { // Dump array for debugging
 }
 Module['hex_dump_tarr'] = hex_dump_tarr;
 
+// WebAssembly builds are instantiated asynchronously, asm.js ones synchronously.
+// Either way, BaseXML.ready resolves with the module once it can be used.
+Module['ready'] = new Promise(function(resolve) {
+	if (runtimeInitialized) {
+		resolve(Module);
+	} else {
+		Module['onRuntimeInitialized'] = function() { resolve(Module); };
+	}
+});
+
   return Module;
 })();
 
+if (typeof self === 'object') self['BaseXML'] = BaseXML; // Browser window or Web Worker
+if (typeof module === 'object' && module['exports']) module['exports'] = BaseXML; // Node
+
@@ -1,4 +1,4 @@
 
 // This is BaseXML
 
-window['BaseXML'] = (function() {
+var BaseXML = (function() {
@@ -20,3 +20,15 @@ print "\nDecoded data: ",str_dec
 print "\nMatch: ","YES" if (str == str_dec) else "NO :("
 
 
+
+# Decoding while expat parses a document (basexml_expat module)
+
+import xml.parsers.expat
+import basexml_expat
+
+doc = '<?xml version="1.0" encoding="UTF-8"?><doc><blob>' + str_enc + '</blob></doc>'
+pieces = []
+parser = xml.parsers.expat.ParserCreate("UTF-8")
+basexml_expat.attach(parser, ["blob"], lambda name, data: pieces.append(data))
+parser.Parse(doc, True)
+print "\nExpat match: ","YES" if (str == "".join(pieces)) else "NO :("
@@ -32,6 +32,8 @@ setup(
 	license		 = "LGPL",
         platforms        = ["Unix", "Windows"],
 	ext_modules	 = [Extension("basexml",["src/python-basexml10.c"],extra_compile_args=["-O3","-g","/O2"])],
+	py_modules	 = ["basexml_expat"],
+	package_dir	 = {"": "src"},
         classifiers      = [
             "Programming Language :: Python",
             "Programming Language :: Python :: 2.5",
@@ -0,0 +1,91 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# BaseXML adapter for expat (xml.parsers.expat)
+#
+# Expat hands the text of an element in pieces split anywhere. The
+# adapter decodes each piece as it comes and hands the decoded data of
+# the named elements to a sink, so that memory stays bounded whatever
+# the size of the payloads:
+#
+#   import xml.parsers.expat, basexml_expat
+#   parser = xml.parsers.expat.ParserCreate("UTF-8")
+#   def sink(name, data):           # data == "" at the end of the element
+#       ...
+#   basexml_expat.attach(parser, ["attachment"], sink)
+#   parser.ParseFile(open("doc.xml", "rb"))
+#
+# It takes the parser's StartElementHandler, EndElementHandler and
+# CharacterDataHandler: pass start/end to attach() to get the elements too.
+
+import basexml
+
+# Decoded at once: kept back are the partial group and the 9 bytes that
+# may be a termination sequence, up to the end of the element.
+CHUNK = 30000
+LOOKAHEAD = 9
+
+
+class Adapter(object):
+
+	def __init__(self, parser, names, sink, start=None, end=None):
+		self.names = set(names)
+		self.sink = sink
+		self.start = start
+		self.end = end
+		self.depth = 0
+		self.in_payload = 0  # depth of the named element being decoded, 0: none
+		self.name = None
+		self.pending = []
+		self.pending_len = 0
+		parser.StartElementHandler = self.start_element
+		parser.EndElementHandler = self.end_element
+		parser.CharacterDataHandler = self.character_data
+		if hasattr(parser, "buffer_text"):
+			parser.buffer_text = False  # pieces as they come: no growing buffer
+
+	def start_element(self, name, attrs):
+		self.depth += 1
+		if self.in_payload:
+			raise ValueError("BaseXML: element <%s> inside <%s>" % (name, self.name))
+		if name in self.names:
+			self.in_payload = self.depth
+			self.name = name
+			self.pending = []
+			self.pending_len = 0
+		if self.start:
+			self.start(name, attrs)
+
+	def character_data(self, data):
+		if not self.in_payload:
+			return
+		if not isinstance(data, bytes):
+			data = data.encode("utf-8")
+		self.pending.append(data)
+		self.pending_len += len(data)
+		if self.pending_len >= CHUNK + LOOKAHEAD:
+			pending = b"".join(self.pending)
+			cut = (len(pending) - LOOKAHEAD) // 6 * 6  # whole groups, no termination in them
+			self.sink(self.name, basexml.decode_string(pending[:cut]))
+			self.pending = [pending[cut:]]
+			self.pending_len = len(pending) - cut
+
+	def end_element(self, name):
+		if self.in_payload == self.depth:
+			self.in_payload = 0
+			pending = b"".join(self.pending)
+			self.pending = []
+			self.pending_len = 0
+			if pending:
+				self.sink(self.name, basexml.decode_string(pending))
+			self.sink(self.name, b"")
+		self.depth -= 1
+		if self.end:
+			self.end(name)
+
+
+def attach(parser, names, sink, start=None, end=None):
+	"""attach(parser, names, sink, start=None, end=None) -> Adapter.
+	sink(name, data) gets the decoded content of the elements named in
+	names, in pieces, then data == "" at the end of each element."""
+	return Adapter(parser, names, sink, start, end)
@@ -103,7 +103,6 @@ Except as contained in this notice, the name(s) of the above copyright
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
 
 #include <fcntl.h>
 #include <Python.h>
@@ -116,6 +115,12 @@ typedef unsigned __int64 uint64_t;
 #else
 #include <stdint.h>
 #endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
 
 #define DEBUG        0
 #define debug_print(...) \
@@ -218,15 +223,21 @@ PyObject* decode_file(PyObject*, PyObject*, PyObject*);
 PyObject* encode_string(PyObject* ,PyObject* ,PyObject*);
 PyObject* decode_string(PyObject* ,PyObject* , PyObject*);
 PyObject* decode_string(PyObject* ,PyObject* ,PyObject* );
+PyObject* decode_inplace(PyObject* ,PyObject* ,PyObject* );
+PyObject* is_valid(PyObject* ,PyObject* ,PyObject* );
 
 /* Python API requirements */
 static char encode_doc[] = "encode(input_file, output_file, <size>)";
 static char decode_doc[] = "decode(input_file, output_file, <size>)";
-static char encode_string_doc[] = "encode_string(string, crc32, column)";
-static char decode_string_doc[] = "decode_string(string, crc32, escape)";
+static char encode_string_doc[] = "encode_string(string, crc32=False) -> encoded string, or (encoded string, CRC32C of string) if crc32";
+static char decode_string_doc[] = "decode_string(string, crc32=None) -> decoded string. If crc32 is given, raises ValueError unless it is the CRC32C of the decoded string";
+static char is_valid_doc[] = "is_valid(string) -> True if string is well-formed BaseXML. Checks every group and the termination sequence without decoding";
+static char decode_inplace_doc[] = "decode_inplace(buffer) -> decoded length. Decodes a bytearray (shrunk to the decoded data) or a writable buffer over itself, raises ValueError if its termination sequence is wrong";
 static PyMethodDef funcs[] = {
         {"encode_string", (PyCFunction) encode_string, METH_KEYWORDS | METH_VARARGS, encode_string_doc},
         {"decode_string", (PyCFunction) decode_string, METH_KEYWORDS | METH_VARARGS, decode_string_doc},
+        {"decode_inplace", (PyCFunction) decode_inplace, METH_KEYWORDS | METH_VARARGS, decode_inplace_doc},
+        {"is_valid", (PyCFunction) is_valid, METH_KEYWORDS | METH_VARARGS, is_valid_doc},
         {NULL, NULL, 0, NULL}
 };
 
@@ -234,6 +245,116 @@ static PyMethodDef funcs[] = {
 uint32_t input = 0x00000000;
 uint32_t output = 0x00000000;
 
+/*
+** encode20
+**
+** encode the 20 bits at the top of input (ABCDEFGH IJKLMNOP QRST0000)
+** into 24 bits at the top of the result, case by case
+*/
+static uint32_t encode20( uint32_t input )
+{
+	uint32_t output = 0x00000000;
+
+	// input = ABCDEFGH IJKLMNOP QRST0000
+
+	// Case ILLEGAL<>_BOTH I3
+	if ( ( input & 0x03efd000 ) == 0x01e3c000 ) { // GHIJKMNOPQRT == 011110011110
+			output  = 0x38404000; // 001110LS 01ABCDEF 01000000 ********
+			output |= (input & 0x00100000) <<  5; // L
+			output |= (input & 0x00002000) << 11; // S
+			output |= (input & 0xfc000000) >> 10; // ABCDEF
+	} else 
+	// Case ILLEGAL<>_LEFT I1
+	if ( ( input & 0x03e80000 ) == 0x01e00000 ) { // GHIJKM == 011110
+			output  = 0x30404000; // 001100LT 01ABCDEF 01NOPQRS ********
+			output |= (input & 0x00100000) <<  5; // L
+			output |= (input & 0x00001000) << 12; // T
+			output |= (input & 0xfc000000) >> 10; // ABCDEF
+			output |= (input & 0x0007e000) >>  5; // NOPQRS
+	} else 
+	// Case ILLEGAL<>_RIGHT I2
+	if ( ( input & 0x0007d000 ) == 0x0003c000 ) { // NOPQRT == 011110
+			output  = 0x34404000; // 001101SM 01ABCDEF 01GHIJKL ********
+			output |= (input & 0x00002000) << 12; // S
+			output |= (input & 0x00080000) <<  5; // M
+			output |= (input & 0xfc000000) >> 10; // ABCDEF
+			output |= (input & 0x03f00000) >> 12; // GHIJKL
+	} else 
+	if ( input & 0x03000000  &&  // GH != 00
+
+	 input & 0x00060000 ) { // NO != 00
+
+	// Case STANDARD E1
+			output  = 0x40000000; // 01ABCDEF 0GHIJKLM 0NOPQRST ********
+			output |= (input & 0xfc000000) >>  2; // ABCDEF
+			output |= (input & 0x03f80000) >>  3; // GHIJKLM
+			output |= (input & 0x0007f000) >>  4; // NOPQRST
+	} else 
+	// Case CONTROL_CHARS_LEFT_CANONICAL E5 : ABCD==0000 and GH==00
+	if ( !( input & 0xf3000000 ) ) { // ABCDGH == 000000
+			output  = 0x20204000; // 0010EFIJ 0010KLMN 01OPQRST ********
+			output |= (input & 0x0c000000); // EF
+			output |= (input & 0x00c00000) <<  2; // IJ
+			output |= (input & 0x003c0000) >>  2; // KLMN
+			output |= (input & 0x0003f000) >>  4; // OPQRST
+	} else 
+	// Case CONTROL_CHARS_RIGHT_CANONICAL E6 : ABCD==0000 and NO==00
+	if ( !( input & 0xf0060000 ) ) { // ABCDNO == 000000
+			output  = 0x20402000; // 0010PEFG 01HIJKLM 0010QRST ********
+			output |= (input & 0x00010000) << 11; // P
+			output |= (input & 0x0e000000) >>  1; // EFG
+			output |= (input & 0x01f80000) >>  3; // HIJKLM
+			output |= (input & 0x0000f000) >>  4; // QRST
+	} else 
+	// Case CONTROL_CHARS_BOTH E2
+	if ( !( input & 0x03060000 ) ) { // GHNO == 0000
+			output  = 0x20404000; // 0010ABCD 01EFIJKL 01MPQRST ********
+			output |= (input & 0xf0000000) >>  4; // ABCD
+			output |= (input & 0x0c000000) >>  6; // EF
+			output |= (input & 0x00f00000) >>  4; // IJKL
+			output |= (input & 0x00080000) >>  6; // M
+			output |= (input & 0x0001f000) >>  4; // PQRST
+	} else 
+	// Case CONTROL_CHARS_LEFT E3
+	if ( !( input & 0x03000000 ) ) { // GH == 00
+			output  = 0x00c08000; // 0NOPQRST 110ABCDE 10MFIJKL ********
+			output |= (input & 0x0007f000) << 12; // NOPQRST
+			output |= (input & 0xf8000000) >> 11; // ABCDE
+			output |= (input & 0x00080000) >>  6; // M
+			output |= (input & 0x04000000) >> 14; // F
+			output |= (input & 0x00f00000) >> 12; // IJKL
+	} else 
+	// Case CONTROL_CHARS_RIGHT E4
+	if ( !( input & 0x00060000 ) ) { // NO == 00
+			output  = 0xc0800000; // 110ABCDE 10FPQRST 0GHIJKLM ********
+			output |= (input & 0xf8000000) >>  3; // ABCDE
+			output |= (input & 0x04000000) >>  5; // F
+			output |= (input & 0x0001f000) <<  4; // PQRST
+			output |= (input & 0x03f80000) >> 11; // GHIJKLM
+	}
+		
+
+	debug_print ("ENCODEBLOCK input   32: "BYTETOBINARYPATTERN"\n", BYTETOBINARY(input));
+	debug_print ("ENCODEBLOCK out<>   32: "BYTETOBINARYPATTERN"\n", BYTETOBINARY(output));
+			
+	// XML ENTITY UNALLOWED CHARS
+	/*
+		On "encoded" variable apply:
+		convert & (0x26) to TAB (0x09)
+	*/
+	if ((output & 0xFF000000) == 0x26000000) {
+		output &= 0x00FFFFFF; output |= 0x09000000;
+	}
+	if ((output & 0x00FF0000) == 0x00260000) {
+		output &= 0xFF00FFFF; output |= 0x00090000;
+	}
+	if ((output & 0x0000FF00) == 0x00002600) {
+		output &= 0xFFFF00FF; output |= 0x00000900;
+	}
+
+	return output;
+}
+
 /* Function definitions */
 static void encodeblock( unsigned char *in, unsigned char *out, unsigned long len_in, unsigned long *len_out )
 {
@@ -242,7 +363,7 @@ static void encodeblock( unsigned char *in, unsigned char *out, unsigned long le
 	unsigned long i5 = 0; // input character position = i*5 on each 2 loops
 	unsigned long j  = 0; // output character position
 	unsigned long len_last  = 0; // output character position
-	unsigned long i_ceil  = (unsigned long) ceil((float)len_in/2.5);
+	unsigned long i_ceil  = (len_in * 2 + 4) / 5; // 20-bit groups, integers only
 	int len_rest;
 
 
@@ -282,102 +403,7 @@ static void encodeblock( unsigned char *in, unsigned char *out, unsigned long le
 						(in[i5+2] & 0xF0) << 8;
 			}
 		}	
-		// input = ABCDEFGH IJKLMNOP QRST0000
-
-		// Case ILLEGAL<>_BOTH I3
-		if ( ( input & 0x03efd000 ) == 0x01e3c000 ) { // GHIJKMNOPQRT == 011110011110
-				output  = 0x38404000; // 001110LS 01ABCDEF 01000000 ********
-				output |= (input & 0x00100000) <<  5; // L
-				output |= (input & 0x00002000) << 11; // S
-				output |= (input & 0xfc000000) >> 10; // ABCDEF
-		} else 
-		// Case ILLEGAL<>_LEFT I1
-		if ( ( input & 0x03e80000 ) == 0x01e00000 ) { // GHIJKM == 011110
-				output  = 0x30404000; // 001100LT 01ABCDEF 01NOPQRS ********
-				output |= (input & 0x00100000) <<  5; // L
-				output |= (input & 0x00001000) << 12; // T
-				output |= (input & 0xfc000000) >> 10; // ABCDEF
-				output |= (input & 0x0007e000) >>  5; // NOPQRS
-		} else 
-		// Case ILLEGAL<>_RIGHT I2
-		if ( ( input & 0x0007d000 ) == 0x0003c000 ) { // NOPQRT == 011110
-				output  = 0x34404000; // 001101SM 01ABCDEF 01GHIJKL ********
-				output |= (input & 0x00002000) << 12; // S
-				output |= (input & 0x00080000) <<  5; // M
-				output |= (input & 0xfc000000) >> 10; // ABCDEF
-				output |= (input & 0x03f00000) >> 12; // GHIJKL
-		} else 
-		if ( input & 0x03000000  &&  // GH != 00
-
-		 input & 0x00060000 ) { // NO != 00
-
-		// Case STANDARD E1
-				output  = 0x40000000; // 01ABCDEF 0GHIJKLM 0NOPQRST ********
-				output |= (input & 0xfc000000) >>  2; // ABCDEF
-				output |= (input & 0x03f80000) >>  3; // GHIJKLM
-				output |= (input & 0x0007f000) >>  4; // NOPQRST
-		} else 
-		// Case CONTROL_CHARS_LEFT_CANONICAL E5 : ABCD==0000 and GH==00
-		if ( !( input & 0xf3000000 ) ) { // ABCDGH == 000000
-				output  = 0x20204000; // 0010EFIJ 0010KLMN 01OPQRST ********
-				output |= (input & 0x0c000000); // EF
-				output |= (input & 0x00c00000) <<  2; // IJ
-				output |= (input & 0x003c0000) >>  2; // KLMN
-				output |= (input & 0x0003f000) >>  4; // OPQRST
-		} else 
-		// Case CONTROL_CHARS_RIGHT_CANONICAL E6 : ABCD==0000 and NO==00
-		if ( !( input & 0xf0060000 ) ) { // ABCDNO == 000000
-				output  = 0x20402000; // 0010PEFG 01HIJKLM 0010QRST ********
-				output |= (input & 0x00010000) << 11; // P
-				output |= (input & 0x0e000000) >>  1; // EFG
-				output |= (input & 0x01f80000) >>  3; // HIJKLM
-				output |= (input & 0x0000f000) >>  4; // QRST
-		} else 
-		// Case CONTROL_CHARS_BOTH E2
-		if ( !( input & 0x03060000 ) ) { // GHNO == 0000
-				output  = 0x20404000; // 0010ABCD 01EFIJKL 01MPQRST ********
-				output |= (input & 0xf0000000) >>  4; // ABCD
-				output |= (input & 0x0c000000) >>  6; // EF
-				output |= (input & 0x00f00000) >>  4; // IJKL
-				output |= (input & 0x00080000) >>  6; // M
-				output |= (input & 0x0001f000) >>  4; // PQRST
-		} else 
-		// Case CONTROL_CHARS_LEFT E3
-		if ( !( input & 0x03000000 ) ) { // GH == 00
-				output  = 0x00c08000; // 0NOPQRST 110ABCDE 10MFIJKL ********
-				output |= (input & 0x0007f000) << 12; // NOPQRST
-				output |= (input & 0xf8000000) >> 11; // ABCDE
-				output |= (input & 0x00080000) >>  6; // M
-				output |= (input & 0x04000000) >> 14; // F
-				output |= (input & 0x00f00000) >> 12; // IJKL
-		} else 
-		// Case CONTROL_CHARS_RIGHT E4
-		if ( !( input & 0x00060000 ) ) { // NO == 00
-				output  = 0xc0800000; // 110ABCDE 10FPQRST 0GHIJKLM ********
-				output |= (input & 0xf8000000) >>  3; // ABCDE
-				output |= (input & 0x04000000) >>  5; // F
-				output |= (input & 0x0001f000) <<  4; // PQRST
-				output |= (input & 0x03f80000) >> 11; // GHIJKLM
-		}
-			
-
-		debug_print ("ENCODEBLOCK(%i) input   32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(input));
-		debug_print ("ENCODEBLOCK(%i) out<>   32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(output));
-				
-		// XML ENTITY UNALLOWED CHARS
-		/*
-			On "encoded" variable apply:
-			convert & (0x26) to TAB (0x09)
-		*/
-		if ((output & 0xFF000000) == 0x26000000) {
-			output &= 0x00FFFFFF; output |= 0x09000000;
-		}
-		if ((output & 0x00FF0000) == 0x00260000) {
-			output &= 0xFF00FFFF; output |= 0x00090000;
-		}
-		if ((output & 0x0000FF00) == 0x00002600) {
-			output &= 0xFFFF00FF; output |= 0x00000900;
-		}
+		output = encode20( input );
 		
 		debug_print ("ENCODEBLOCK(%i) outXML  32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(output));
 		
@@ -411,6 +437,113 @@ static void encodeblock( unsigned char *in, unsigned char *out, unsigned long le
 }
 
 
+/*
+** decode20
+**
+** decode the 24 bits at the top of input into 20 bits at the top of
+** the result, 0 if undecodable
+*/
+static uint32_t decode20( uint32_t input )
+{
+	uint32_t output = 0x00000000;
+
+	debug_print ("DECODEBLOCK bytes     : %x\n", input);
+	debug_print ("DECODEBLOCK inXML   32: "BYTETOBINARYPATTERN"\n", BYTETOBINARY(input));
+	
+	// XML ENTITY UNALLOWED CHARS
+	// Preliminary transform of \n\r\t to <>& in each encoded byte
+	if((input & 0xFF000000) == 0x09000000) {
+		input &= 0x00FFFFFF; input |= 0x26000000;
+	}
+	
+	if((input & 0x00FF0000) == 0x00090000) {
+		input &= 0xFF00FFFF; input |= 0x00260000;
+	}
+	
+	if((input & 0x0000FF00) == 0x00000900) {
+		input &= 0xFFFF00FF; input |= 0x00002600;
+	}
+	
+	debug_print ("DECODEBLOCK in<>    32: "BYTETOBINARYPATTERN"\n", BYTETOBINARY(input));
+			
+
+	// Case ILLEGAL<>_BOTH I3 DECODE
+	if ( ( input & 0xfcc0f000 ) == 0x38404000 ) { // ABCDEFIJQRST == 001110010100
+		    output  = 0x01e3c000; // 001110LS 01ABCDEF 01000000 ********
+		    output |= (input & 0x02000000) >>  5; // L
+		    output |= (input & 0x01000000) >> 11; // S
+		    output |= (input & 0x003f0000) << 10; // ABCDEF
+	} else 
+	// Case ILLEGAL<>_LEFT I1 DECODE
+	if ( ( input & 0xfcc0c000 ) == 0x30404000 ) { // ABCDEFIJQR == 0011000101
+		    output  = 0x01e00000; // 001100LT 01ABCDEF 01NOPQRS ********
+		    output |= (input & 0x02000000) >>  5; // L
+		    output |= (input & 0x01000000) >> 12; // T
+		    output |= (input & 0x003f0000) << 10; // ABCDEF
+		    output |= (input & 0x00003f00) <<  5; // NOPQRS
+	} else 
+	// Case ILLEGAL<>_RIGHT I2 DECODE
+	if ( ( input & 0xfcc0c000 ) == 0x34404000 ) { // ABCDEFIJQR == 0011010101
+		    output  = 0x0003c000; // 001101SM 01ABCDEF 01GHIJKL ********
+		    output |= (input & 0x02000000) >> 12; // S
+		    output |= (input & 0x01000000) >>  5; // M
+		    output |= (input & 0x003f0000) << 10; // ABCDEF
+		    output |= (input & 0x00003f00) << 12; // GHIJKL
+	} else 
+	// Case STANDARD E1 DECODE
+	if ( ( input & 0xc0808000 ) == 0x40000000 ) { // ABIQ == 0100
+		    output |= (input & 0x3f000000) <<  2; // ABCDEF
+		    output |= (input & 0x007f0000) <<  3; // GHIJKLM
+		    output |= (input & 0x00007f00) <<  4; // NOPQRST
+	} else 
+	// Case CONTROL_CHARS_LEFT_CANONICAL E5 : ABCD==0000 and GH==00 DECODE
+	if ( ( input & 0xf0f0c000 ) == 0x20204000 ) { // ABCDIJKLQR == 0010001001
+		    output |= (input & 0x0c000000); // EF
+		    output |= (input & 0x03000000) >>  2; // IJ
+		    output |= (input & 0x000f0000) <<  2; // KLMN
+		    output |= (input & 0x00003f00) <<  4; // OPQRST
+	} else 
+	// Case CONTROL_CHARS_RIGHT_CANONICAL E6 : ABCD==0000 and NO==00 DECODE
+	if ( ( input & 0xf0c0f000 ) == 0x20402000 ) { // ABCDIJQRST == 0010010010
+		    output |= (input & 0x08000000) >> 11; // P
+		    output |= (input & 0x07000000) <<  1; // EFG
+		    output |= (input & 0x003f0000) <<  3; // HIJKLM
+		    output |= (input & 0x00000f00) <<  4; // QRST
+	} else 
+	// Case CONTROL_CHARS_BOTH E2 DECODE
+	if ( ( input & 0xf0c0c000 ) == 0x20404000 ) { // ABCDIJQR == 00100101
+		    output |= (input & 0x0f000000) <<  4; // ABCD
+		    output |= (input & 0x00300000) <<  6; // EF
+		    output |= (input & 0x000f0000) <<  4; // IJKL
+		    output |= (input & 0x00002000) <<  6; // M
+		    output |= (input & 0x00001f00) <<  4; // PQRST
+	} else 
+	// Case CONTROL_CHARS_LEFT E3 DECODE
+	if ( ( input & 0x80e0c000 ) == 0x00c08000 ) { // AIJKQR == 011010
+		    output |= (input & 0x7f000000) >> 12; // NOPQRST
+		    output |= (input & 0x001f0000) << 11; // ABCDE
+		    output |= (input & 0x00002000) <<  6; // M
+		    output |= (input & 0x00001000) << 14; // F
+		    output |= (input & 0x00000f00) << 12; // IJKL
+	} else 
+	// Case CONTROL_CHARS_RIGHT E4 DECODE
+	if ( ( input & 0xe0c08000 ) == 0xc0800000 ) { // ABCIJQ == 110100
+		    output |= (input & 0x1f000000) <<  3; // ABCDE
+		    output |= (input & 0x00200000) <<  5; // F
+		    output |= (input & 0x001f0000) >>  4; // PQRST
+		    output |= (input & 0x00007f00) << 11; // GHIJKLM
+	} /*
+	  else if( ( input & 0xfff0ff00 ) == 0x3f303f00 ) { // == 00111111 0011**** 00111111 ********
+
+		// ERROR
+		// BaseXML10BS termination sequence doesn't store encoded bytes.
+		// That's the job of decode() to anticipate termination sequence and pass len to decodeblock().
+
+	} */
+
+	return output;
+}
+
 /*
 ** decodeblock
 **
@@ -426,8 +559,8 @@ static void decodeblock( unsigned char *in, unsigned char *out, unsigned long le
 	unsigned long i3 = 0; // input character position = i*3
 	unsigned long j  = 0; // output character position
 	unsigned long len_last  = 0; // output character position
-	unsigned long i_ceil   = (unsigned long)ceil((float)len_in/6)*2;
-	unsigned long i_floor  = (unsigned long)floor((float)len_in/6)*2;
+	unsigned long i_ceil   = (len_in + 5) / 6 * 2; // integers: a float loses precision over 16MB
+	unsigned long i_floor  = len_in / 6 * 2;
 	
 	*len_out = 0;
 
@@ -468,101 +601,7 @@ static void decodeblock( unsigned char *in, unsigned char *out, unsigned long le
 		}
 		
 
-		output  = 0x00000000;
-		
-		debug_print ("DECODEBLOCK(%i) bytes     : %x\n", i, input);
-		debug_print ("DECODEBLOCK(%i) inXML   32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(input));
-		
-		// XML ENTITY UNALLOWED CHARS
-		// Preliminary transform of \n\r\t to <>& in each encoded byte
-		if((input & 0xFF000000) == 0x09000000) {
-			input &= 0x00FFFFFF; input |= 0x26000000;
-		}
-		
-		if((input & 0x00FF0000) == 0x00090000) {
-			input &= 0xFF00FFFF; input |= 0x00260000;
-		}
-		
-		if((input & 0x0000FF00) == 0x00000900) {
-			input &= 0xFFFF00FF; input |= 0x00002600;
-		}
-		
-		debug_print ("DECODEBLOCK(%i) in<>    32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(input));
-				
-
-		// Case ILLEGAL<>_BOTH I3 DECODE
-		if ( ( input & 0xfcc0f000 ) == 0x38404000 ) { // ABCDEFIJQRST == 001110010100
-			    output  = 0x01e3c000; // 001110LS 01ABCDEF 01000000 ********
-			    output |= (input & 0x02000000) >>  5; // L
-			    output |= (input & 0x01000000) >> 11; // S
-			    output |= (input & 0x003f0000) << 10; // ABCDEF
-		} else 
-		// Case ILLEGAL<>_LEFT I1 DECODE
-		if ( ( input & 0xfcc0c000 ) == 0x30404000 ) { // ABCDEFIJQR == 0011000101
-			    output  = 0x01e00000; // 001100LT 01ABCDEF 01NOPQRS ********
-			    output |= (input & 0x02000000) >>  5; // L
-			    output |= (input & 0x01000000) >> 12; // T
-			    output |= (input & 0x003f0000) << 10; // ABCDEF
-			    output |= (input & 0x00003f00) <<  5; // NOPQRS
-		} else 
-		// Case ILLEGAL<>_RIGHT I2 DECODE
-		if ( ( input & 0xfcc0c000 ) == 0x34404000 ) { // ABCDEFIJQR == 0011010101
-			    output  = 0x0003c000; // 001101SM 01ABCDEF 01GHIJKL ********
-			    output |= (input & 0x02000000) >> 12; // S
-			    output |= (input & 0x01000000) >>  5; // M
-			    output |= (input & 0x003f0000) << 10; // ABCDEF
-			    output |= (input & 0x00003f00) << 12; // GHIJKL
-		} else 
-		// Case STANDARD E1 DECODE
-		if ( ( input & 0xc0808000 ) == 0x40000000 ) { // ABIQ == 0100
-			    output |= (input & 0x3f000000) <<  2; // ABCDEF
-			    output |= (input & 0x007f0000) <<  3; // GHIJKLM
-			    output |= (input & 0x00007f00) <<  4; // NOPQRST
-		} else 
-		// Case CONTROL_CHARS_LEFT_CANONICAL E5 : ABCD==0000 and GH==00 DECODE
-		if ( ( input & 0xf0f0c000 ) == 0x20204000 ) { // ABCDIJKLQR == 0010001001
-			    output |= (input & 0x0c000000); // EF
-			    output |= (input & 0x03000000) >>  2; // IJ
-			    output |= (input & 0x000f0000) <<  2; // KLMN
-			    output |= (input & 0x00003f00) <<  4; // OPQRST
-		} else 
-		// Case CONTROL_CHARS_RIGHT_CANONICAL E6 : ABCD==0000 and NO==00 DECODE
-		if ( ( input & 0xf0c0f000 ) == 0x20402000 ) { // ABCDIJQRST == 0010010010
-			    output |= (input & 0x08000000) >> 11; // P
-			    output |= (input & 0x07000000) <<  1; // EFG
-			    output |= (input & 0x003f0000) <<  3; // HIJKLM
-			    output |= (input & 0x00000f00) <<  4; // QRST
-		} else 
-		// Case CONTROL_CHARS_BOTH E2 DECODE
-		if ( ( input & 0xf0c0c000 ) == 0x20404000 ) { // ABCDIJQR == 00100101
-			    output |= (input & 0x0f000000) <<  4; // ABCD
-			    output |= (input & 0x00300000) <<  6; // EF
-			    output |= (input & 0x000f0000) <<  4; // IJKL
-			    output |= (input & 0x00002000) <<  6; // M
-			    output |= (input & 0x00001f00) <<  4; // PQRST
-		} else 
-		// Case CONTROL_CHARS_LEFT E3 DECODE
-		if ( ( input & 0x80e0c000 ) == 0x00c08000 ) { // AIJKQR == 011010
-			    output |= (input & 0x7f000000) >> 12; // NOPQRST
-			    output |= (input & 0x001f0000) << 11; // ABCDE
-			    output |= (input & 0x00002000) <<  6; // M
-			    output |= (input & 0x00001000) << 14; // F
-			    output |= (input & 0x00000f00) << 12; // IJKL
-		} else 
-		// Case CONTROL_CHARS_RIGHT E4 DECODE
-		if ( ( input & 0xe0c08000 ) == 0xc0800000 ) { // ABCIJQ == 110100
-			    output |= (input & 0x1f000000) <<  3; // ABCDE
-			    output |= (input & 0x00200000) <<  5; // F
-			    output |= (input & 0x001f0000) >>  4; // PQRST
-			    output |= (input & 0x00007f00) << 11; // GHIJKLM
-		} /*
-		  else if( ( input & 0xfff0ff00 ) == 0x3f303f00 ) { // == 00111111 0011**** 00111111 ********
-
-			// ERROR
-			// BaseXML10BS termination sequence doesn't store encoded bytes.
-			// That's the job of decode() to anticipate termination sequence and pass len to decodeblock().
-
-		} */
+		output = decode20( input );
 		
 	debug_print ("DECODEBLOCK(%i) output  32: "BYTETOBINARYPATTERN"\n", i, BYTETOBINARY(output));
 	
@@ -590,6 +629,311 @@ static void decodeblock( unsigned char *in, unsigned char *out, unsigned long le
 
 
 
+/*
+** validgroup
+**
+** check one 3-byte group: none of the bytes the encoder never writes
+** (\0 \r \n < > &, and the other control chars but TAB), and once TAB
+** is swapped back to &, one of the nine case patterns of decodeblock
+*/
+static int validbytes( const unsigned char *g )
+{
+	int k;
+
+	for( k = 0; k < 3; k++ ) {
+		if( (g[k] < 0x20 && g[k] != 0x09) || g[k] == '<' || g[k] == '>' || g[k] == '&' )
+			return 0;
+	}
+	return 1;
+}
+
+static int validpattern( const unsigned char *g )
+{
+	uint32_t in = (uint32_t) (g[0] == 0x09 ? 0x26 : g[0]) << 24 |
+	              (uint32_t) (g[1] == 0x09 ? 0x26 : g[1]) << 16 |
+	              (uint32_t) (g[2] == 0x09 ? 0x26 : g[2]) << 8;
+
+	return ( in & 0xfcc0f000 ) == 0x38404000 || // I3
+	       ( in & 0xfcc0c000 ) == 0x30404000 || // I1
+	       ( in & 0xfcc0c000 ) == 0x34404000 || // I2
+	       ( in & 0xc0808000 ) == 0x40000000 || // E1
+	       ( in & 0xf0f0c000 ) == 0x20204000 || // E5
+	       ( in & 0xf0c0f000 ) == 0x20402000 || // E6
+	       ( in & 0xf0c0c000 ) == 0x20404000 || // E2
+	       ( in & 0x80e0c000 ) == 0x00c08000 || // E3
+	       ( in & 0xe0c08000 ) == 0xc0800000;   // E4
+}
+
+#ifdef __SSE2__
+/*
+** badbytes16
+**
+** nonzero if any of 16 bytes can't be in encoded data
+*/
+static int badbytes16( const unsigned char *p )
+{
+	__m128i v = _mm_loadu_si128( (const __m128i *) p );
+	__m128i bad = _mm_andnot_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( 0x09 ) ), // v < 0x20, unsigned
+		_mm_cmplt_epi8( _mm_xor_si128( v, _mm_set1_epi8( (char) 0x80 ) ), _mm_set1_epi8( (char) 0xa0 ) ) );
+
+	bad = _mm_or_si128( bad, _mm_cmpeq_epi8( v, _mm_set1_epi8( '<' ) ) );
+	bad = _mm_or_si128( bad, _mm_cmpeq_epi8( v, _mm_set1_epi8( '>' ) ) );
+	bad = _mm_or_si128( bad, _mm_cmpeq_epi8( v, _mm_set1_epi8( '&' ) ) );
+	return _mm_movemask_epi8( bad );
+}
+#endif
+
+/*
+** validate_groups
+**
+** offset of the first bad 3-byte group of p (len multiple of 3), or len
+*/
+static size_t validate_groups( const unsigned char *p, size_t len )
+{
+	size_t i = 0, k;
+
+#ifdef __SSE2__
+	for( ; i + 48 <= len; i += 48 ) { // 16 groups: bytes checked 16 at a time
+		int bytes_ok = !(badbytes16( p + i ) | badbytes16( p + i + 16 ) | badbytes16( p + i + 32 ));
+		for( k = i; k < i + 48; k += 3 ) {
+			if( (!bytes_ok && !validbytes( p + k )) || !validpattern( p + k ) )
+				return k;
+		}
+	}
+#endif
+	for( k = i; k < len; k += 3 ) {
+		if( !validbytes( p + k ) || !validpattern( p + k ) )
+			return k;
+	}
+	return len;
+}
+
+/*
+** validate_tail
+**
+** check the end of encoded data (end points just past its last byte):
+** a termination sequence 0x3f 0x3X 0x3f must hold 1 or 2 inside the
+** last 6 bytes, 3 or 4 after them, else the data is whole 6-byte groups.
+** *data_len is the length of the groups before the termination sequence.
+*/
+static int validate_tail( const unsigned char *end, size_t enc_len, size_t *data_len )
+{
+	if( enc_len % 3 == 0 && enc_len >= 3 && end[-3] == 0x3f && end[-1] == 0x3f ) {
+		*data_len = enc_len - 3;
+		if( enc_len % 6 == 0 ? (end[-2] == 0x31 || end[-2] == 0x32) : (enc_len >= 9 && (end[-2] == 0x33 || end[-2] == 0x34)) )
+			return 0;
+		return BASEXML_ILLEGAL_TERMINATION;
+	}
+	*data_len = enc_len / 6 * 6;
+	return *data_len == enc_len ? 0 : BASEXML_UNEXPECTED_END;
+}
+
+/*
+** encode_small / decode_small
+**
+** Short strings (IDs, tokens, hashes) skip the block loop: a switch on
+** the number of 20-bit groups falls into straight-line code, with no
+** loop, no floating point and no allocation (the callers use a buffer
+** on the stack). decode_small returns 0, leaving it to decodeblock, for
+** anything longer or not well-formed.
+*/
+#define BASEXML_SMALL_MAX         64
+#define BASEXML_SMALL_ENCODED_MAX 81 // 12 blocks, 4 bytes and the termination sequence
+
+static void encode_small_group( const unsigned char *in, unsigned char *out, int k ) // 20-bit group k, a constant once inlined
+{
+	const unsigned char *p = in + k / 2 * 5;
+	uint32_t output = encode20( k % 2 ? (uint32_t) p[2] << 28 | (uint32_t) p[3] << 20 | (uint32_t) p[4] << 12
+	                                  : (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) (p[2] & 0xF0) << 8 );
+
+	out[k * 3]     = (unsigned char) (output >> 24);
+	out[k * 3 + 1] = (unsigned char) (output >> 16);
+	out[k * 3 + 2] = (unsigned char) (output >> 8);
+}
+
+static void decode_small_group( const unsigned char *in, unsigned char *out, int k )
+{
+	const unsigned char *g = in + k * 3;
+	unsigned char *p = out + k / 2 * 5;
+	uint32_t output = decode20( (uint32_t) g[0] << 24 | (uint32_t) g[1] << 16 | (uint32_t) g[2] << 8 );
+
+	if( k % 2 ) { // groups are decoded last to first: each one adds its half of p[2]
+		p[2] |= (unsigned char) ((output >> 28) & 0x0F);
+		p[3]  = (unsigned char) (output >> 20);
+		p[4]  = (unsigned char) (output >> 12);
+	} else {
+		p[0]  = (unsigned char) (output >> 24);
+		p[1]  = (unsigned char) (output >> 16);
+		p[2] |= (unsigned char) ((output >> 8) & 0xF0);
+	}
+}
+
+static unsigned long encode_small( const unsigned char *in, unsigned char *out, unsigned long len_in ) // len_in <= BASEXML_SMALL_MAX
+{
+	unsigned char pad[BASEXML_SMALL_MAX + 5];
+	unsigned long groups = (len_in * 2 + 4) / 5;
+
+	memcpy( pad, in, len_in );
+	memset( pad + len_in, 0, 5 ); // the last group is zero-padded, as by encodeblock
+	switch( groups ) { // each case falls through, last group first
+		case 26: encode_small_group( pad, out, 25 ); /* fall through */
+		case 25: encode_small_group( pad, out, 24 ); /* fall through */
+		case 24: encode_small_group( pad, out, 23 ); /* fall through */
+		case 23: encode_small_group( pad, out, 22 ); /* fall through */
+		case 22: encode_small_group( pad, out, 21 ); /* fall through */
+		case 21: encode_small_group( pad, out, 20 ); /* fall through */
+		case 20: encode_small_group( pad, out, 19 ); /* fall through */
+		case 19: encode_small_group( pad, out, 18 ); /* fall through */
+		case 18: encode_small_group( pad, out, 17 ); /* fall through */
+		case 17: encode_small_group( pad, out, 16 ); /* fall through */
+		case 16: encode_small_group( pad, out, 15 ); /* fall through */
+		case 15: encode_small_group( pad, out, 14 ); /* fall through */
+		case 14: encode_small_group( pad, out, 13 ); /* fall through */
+		case 13: encode_small_group( pad, out, 12 ); /* fall through */
+		case 12: encode_small_group( pad, out, 11 ); /* fall through */
+		case 11: encode_small_group( pad, out, 10 ); /* fall through */
+		case 10: encode_small_group( pad, out, 9 ); /* fall through */
+		case 9: encode_small_group( pad, out, 8 ); /* fall through */
+		case 8: encode_small_group( pad, out, 7 ); /* fall through */
+		case 7: encode_small_group( pad, out, 6 ); /* fall through */
+		case 6: encode_small_group( pad, out, 5 ); /* fall through */
+		case 5: encode_small_group( pad, out, 4 ); /* fall through */
+		case 4: encode_small_group( pad, out, 3 ); /* fall through */
+		case 3: encode_small_group( pad, out, 2 ); /* fall through */
+		case 2: encode_small_group( pad, out, 1 ); /* fall through */
+		case 1: encode_small_group( pad, out, 0 );
+	}
+	if( len_in % 5 ) { // termination sequence
+		out[groups * 3]     = 0x3f;
+		out[groups * 3 + 1] = (unsigned char) (0x30 | len_in % 5);
+		out[groups * 3 + 2] = 0x3f;
+		groups++;
+	}
+	return groups * 3;
+}
+
+static int decode_small( const unsigned char *in, unsigned char *out, unsigned long len_in, unsigned long *len_out ) // safe in place
+{
+	unsigned char block[BASEXML_SMALL_MAX + 5] = { 0 };
+	size_t data_len;
+	unsigned long size;
+
+	if( len_in > BASEXML_SMALL_ENCODED_MAX || validate_tail( in + len_in, len_in, &data_len ) )
+		return 0;
+	size = data_len / 6 * 5;
+	if( data_len != len_in ) // the termination sequence holds the length of the last block
+		size += (in[len_in - 2] & 0x07) - (data_len % 6 ? 0 : 5);
+	switch( (size * 2 + 4) / 5 ) { // each case falls through, last group first
+		case 26: decode_small_group( in, block, 25 ); /* fall through */
+		case 25: decode_small_group( in, block, 24 ); /* fall through */
+		case 24: decode_small_group( in, block, 23 ); /* fall through */
+		case 23: decode_small_group( in, block, 22 ); /* fall through */
+		case 22: decode_small_group( in, block, 21 ); /* fall through */
+		case 21: decode_small_group( in, block, 20 ); /* fall through */
+		case 20: decode_small_group( in, block, 19 ); /* fall through */
+		case 19: decode_small_group( in, block, 18 ); /* fall through */
+		case 18: decode_small_group( in, block, 17 ); /* fall through */
+		case 17: decode_small_group( in, block, 16 ); /* fall through */
+		case 16: decode_small_group( in, block, 15 ); /* fall through */
+		case 15: decode_small_group( in, block, 14 ); /* fall through */
+		case 14: decode_small_group( in, block, 13 ); /* fall through */
+		case 13: decode_small_group( in, block, 12 ); /* fall through */
+		case 12: decode_small_group( in, block, 11 ); /* fall through */
+		case 11: decode_small_group( in, block, 10 ); /* fall through */
+		case 10: decode_small_group( in, block, 9 ); /* fall through */
+		case 9: decode_small_group( in, block, 8 ); /* fall through */
+		case 8: decode_small_group( in, block, 7 ); /* fall through */
+		case 7: decode_small_group( in, block, 6 ); /* fall through */
+		case 6: decode_small_group( in, block, 5 ); /* fall through */
+		case 5: decode_small_group( in, block, 4 ); /* fall through */
+		case 4: decode_small_group( in, block, 3 ); /* fall through */
+		case 3: decode_small_group( in, block, 2 ); /* fall through */
+		case 2: decode_small_group( in, block, 1 ); /* fall through */
+		case 1: decode_small_group( in, block, 0 );
+	}
+	memcpy( out, block, size ); // every group was read: safe in place
+	*len_out = size;
+	return 1;
+}
+
+/*
+** basexml_crc32c
+**
+** CRC32C (Castagnoli) of len bytes, continuing crc (0 to start).
+** Uses the SSE4.2 crc32 instruction when compiled for it (-msse4.2),
+** else a precomputed byte table (read-only: safe from any thread).
+*/
+#ifndef __SSE4_2__
+static const uint32_t crc32c_table[256] = { // CRC32C, reflected polynomial 0x82f63b78
+	0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c, 0x26a1e7e8, 0xd4ca64eb,
+	0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b, 0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24,
+	0x105ec76f, 0xe235446c, 0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+	0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc, 0xbc267848, 0x4e4dfb4b,
+	0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a, 0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35,
+	0xaa64d611, 0x580f5512, 0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+	0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad, 0x1642ae59, 0xe4292d5a,
+	0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a, 0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595,
+	0x417b1dbc, 0xb3109ebf, 0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+	0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f, 0xed03a29b, 0x1f682198,
+	0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927, 0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38,
+	0xdbfc821c, 0x2997011f, 0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+	0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e, 0x4767748a, 0xb50cf789,
+	0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859, 0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46,
+	0x7198540d, 0x83f3d70e, 0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+	0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de, 0xdde0eb2a, 0x2f8b6829,
+	0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c, 0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93,
+	0x082f63b7, 0xfa44e0b4, 0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+	0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b, 0xb4091bff, 0x466298fc,
+	0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c, 0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033,
+	0xa24bb5a6, 0x502036a5, 0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+	0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975, 0x0e330a81, 0xfc588982,
+	0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d, 0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622,
+	0x38cc2a06, 0xcaa7a905, 0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+	0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8, 0xe52cc12c, 0x1747422f,
+	0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff, 0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0,
+	0xd3d3e1ab, 0x21b862a8, 0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+	0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78, 0x7fab5e8c, 0x8dc0dd8f,
+	0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee, 0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1,
+	0x69e9f0d5, 0x9b8273d6, 0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+	0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69, 0xd5cf889d, 0x27a40b9e,
+	0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e, 0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+};
+#endif
+
+uint32_t basexml_crc32c( uint32_t crc, const unsigned char *p, size_t len )
+{
+	crc = ~crc;
+#ifdef __SSE4_2__
+#if defined(__x86_64__) || defined(_M_X64)
+	for( ; len >= 8; len -= 8, p += 8 ) {
+		uint64_t v;
+		memcpy( &v, p, 8 );
+		crc = (uint32_t) _mm_crc32_u64( crc, v );
+	}
+#endif
+	for( ; len >= 4; len -= 4, p += 4 ) {
+		uint32_t v;
+		memcpy( &v, p, 4 );
+		crc = _mm_crc32_u32( crc, v );
+	}
+	for( ; len; len--, p++ ) {
+		crc = _mm_crc32_u8( crc, *p );
+	}
+#else
+	for( ; len; len--, p++ ) {
+		crc = crc32c_table[(crc ^ *p) & 0xff] ^ (crc >> 8);
+	}
+#endif
+	return ~crc;
+}
+
+
+/*
+** The CRC32C is computed tile by tile, right before encoding or after
+** decoding each tile, while it is hot in cache
+*/
+#define BASEXML_CRC_TILE 30000 // multiple of 5 (and 6): no termination sequence inside
+
 /*
 ** encode_string
 **
@@ -609,25 +953,44 @@ PyObject* encode_string(
 	
 	Byte *input_buffer = NULL;
 	Byte *output_buffer = NULL;
-	uInt input_len = 0;
-	uInt output_len = 0;
+	uLong input_len = 0;
+	uLong output_len = 0;
+	Byte small_buffer[BASEXML_SMALL_ENCODED_MAX];
+	uLong i, tile, tile_len;
+	int crc32 = 0;
+	uint32_t crc = 0;
 	
-	static char *kwlist[] = { "string", NULL };
+	static char *kwlist[] = { "string", "crc32", NULL };
 	if(!PyArg_ParseTupleAndKeywords(args, 
 				kwds,
-				"O!|Li", 
+				"O!|i", 
 				kwlist,
 				&PyString_Type,
-				&Py_input_string
+				&Py_input_string,
+				&crc32
 				)) 
 		return NULL;
 
 	input_len = PyString_Size(Py_input_string);
 	input_buffer = (Byte *) PyString_AsString(Py_input_string);
+	if(!crc32 && input_len <= BASEXML_SMALL_MAX)
+		return PyString_FromStringAndSize((char *)small_buffer, encode_small(input_buffer, small_buffer, input_len));
 	output_buffer = (Byte *) malloc( input_len*6/5 + 12); // Termination sequence. Should be +6 but not future-proof.
-	encodeblock(input_buffer, output_buffer, input_len, &output_len);
+	if(crc32) {
+		for(i = 0; i < input_len; i += tile) {
+			tile = input_len - i < BASEXML_CRC_TILE ? input_len - i : BASEXML_CRC_TILE;
+			crc = basexml_crc32c(crc, input_buffer + i, tile);
+			encodeblock(input_buffer + i, output_buffer + output_len, tile, &tile_len);
+			output_len += tile_len;
+		}
+	} else {
+		encodeblock(input_buffer, output_buffer, input_len, &output_len);
+	}
 	Py_output_string = PyString_FromStringAndSize((char *)output_buffer, output_len);
-	retval = Py_BuildValue("S", Py_output_string);
+	if(crc32)
+		retval = Py_BuildValue("(Sk)", Py_output_string, (unsigned long) crc);
+	else
+		retval = Py_BuildValue("S", Py_output_string);
 
 	free(output_buffer);
 	Py_DECREF(Py_output_string);
@@ -652,27 +1015,55 @@ PyObject* decode_string(
 {
 	PyObject *Py_input_string;
 	PyObject *Py_output_string;
+	PyObject *Py_crc32 = Py_None;
 	PyObject *retval;
 	
 	Byte *input_buffer = NULL;
 	Byte *output_buffer = NULL;
-	uInt input_len = 0;
-	uInt output_len = 0;
+	uLong input_len = 0;
+	uLong output_len = 0;
+	Byte small_buffer[BASEXML_SMALL_MAX];
+	uLong i, tile, tile_len;
+	uint32_t crc = 0, crc_expected = 0;
 	
-	static char *kwlist[] = { "string", NULL };
+	static char *kwlist[] = { "string", "crc32", NULL };
 	if(!PyArg_ParseTupleAndKeywords(args, 
 				kwds,
-				"O!|Li", 
+				"O!|O", 
 				kwlist,
 				&PyString_Type,
-				&Py_input_string
+				&Py_input_string,
+				&Py_crc32
 				)) 
 		return NULL;
 
+	if(Py_crc32 != Py_None) {
+		crc_expected = (uint32_t) PyInt_AsUnsignedLongMask(Py_crc32);
+		if(PyErr_Occurred())
+			return NULL;
+	}
+
 	input_len = PyString_Size(Py_input_string);
 	input_buffer = (Byte *)PyString_AsString(Py_input_string);
+	if(Py_crc32 == Py_None && decode_small(input_buffer, small_buffer, input_len, &output_len))
+		return PyString_FromStringAndSize((char *)small_buffer, output_len);
 	output_buffer = (Byte *)malloc( input_len*5/6 + 5 );
-	decodeblock(input_buffer, output_buffer, input_len, &output_len);
+	if(Py_crc32 != Py_None) {
+		for(i = 0; i < input_len; i += tile) { // the last tile keeps the termination sequence
+			tile = input_len - i < BASEXML_CRC_TILE + 12 ? input_len - i : BASEXML_CRC_TILE;
+			decodeblock(input_buffer + i, output_buffer + output_len, tile, &tile_len);
+			crc = basexml_crc32c(crc, output_buffer + output_len, tile_len);
+			output_len += tile_len;
+		}
+		if(crc != crc_expected) {
+			free(output_buffer);
+			PyErr_Format(PyExc_ValueError, "BaseXML: CRC32C mismatch (%08lx, expected %08lx), decoded data is corrupted",
+				(unsigned long) crc, (unsigned long) crc_expected);
+			return NULL;
+		}
+	} else {
+		decodeblock(input_buffer, output_buffer, input_len, &output_len);
+	}
 	Py_output_string = PyString_FromStringAndSize((char *)output_buffer, output_len);
 	retval = Py_BuildValue("S", Py_output_string);
 	
@@ -682,6 +1073,92 @@ PyObject* decode_string(
 	return retval;
 }
 
+/*
+** decode_inplace
+**
+** Decodes a bytearray or writable buffer over itself: decodeblock
+** writes each 5 bytes behind the 6 it has just read, so a multi-GB
+** payload doesn't need a second buffer. Returns the decoded length.
+** The termination sequence is checked first (ValueError if wrong).
+**
+*/
+
+PyObject* decode_inplace(
+		PyObject* self, 
+		PyObject* args, 
+		PyObject* kwds
+		)
+{
+	PyObject *Py_input_buffer;
+	Py_buffer view;
+	uLong output_len = 0;
+	size_t data_len = 0;
+	int retcode;
+	
+	static char *kwlist[] = { "buffer", NULL };
+	if(!PyArg_ParseTupleAndKeywords(args, 
+				kwds,
+				"O", 
+				kwlist,
+				&Py_input_buffer
+				)) 
+		return NULL;
+
+	if(PyObject_GetBuffer(Py_input_buffer, &view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) < 0)
+		return NULL;
+	retcode = validate_tail((Byte *)view.buf + view.len, (size_t)view.len, &data_len);
+	if(retcode) {
+		PyBuffer_Release(&view);
+		PyErr_SetString(PyExc_ValueError, basexml_message(retcode));
+		return NULL;
+	}
+	if(!decode_small((Byte *)view.buf, (Byte *)view.buf, (uLong)view.len, &output_len))
+		decodeblock((Byte *)view.buf, (Byte *)view.buf, (uLong)view.len, &output_len);
+	PyBuffer_Release(&view);
+
+	if(PyByteArray_Check(Py_input_buffer) && PyByteArray_Resize(Py_input_buffer, output_len) < 0)
+		return NULL;
+
+	return PyLong_FromUnsignedLong(output_len);
+}
+
+/*
+** is_valid
+**
+** Checks a Python binary string is well-formed BaseXML, without decoding it
+**
+*/
+
+PyObject* is_valid(
+		PyObject* self, 
+		PyObject* args, 
+		PyObject* kwds
+		)
+{
+	PyObject *Py_input_string;
+	
+	Byte *input_buffer = NULL;
+	size_t input_len = 0;
+	size_t data_len = 0;
+	int retcode;
+	
+	static char *kwlist[] = { "string", NULL };
+	if(!PyArg_ParseTupleAndKeywords(args, 
+				kwds,
+				"O!", 
+				kwlist,
+				&PyString_Type,
+				&Py_input_string
+				)) 
+		return NULL;
+
+	input_len = PyString_Size(Py_input_string);
+	input_buffer = (Byte *)PyString_AsString(Py_input_string);
+	retcode = validate_tail(input_buffer + input_len, input_len, &data_len);
+	
+	return PyBool_FromLong(!retcode && validate_groups(input_buffer, data_len) == data_len);
+}
+
 /*
 ** Initializer
 */
@@ -351,3 +351,93 @@ for key, name in enumerate(names):
 	print (code_coder(inpstr[key], outstr[key], True))[0:-1]
 print tabs+"}"
 
+
+
+# XML 1.1
+# XML 1.1 only allows 0x7F and U+0080-U+009F as character references
+# (and normalises U+0085 to a line feed): the groups where the cases
+# above would write one are caught first, and written as one 3-byte
+# UTF-8 character (U+1000-U+CFFF), which XML 1.0 groups never are.
+
+print "\n"*3
+
+print "// XML 1.1 ENCODERS (before the cases above)"
+
+print "\n"*3
+
+names11  = []
+inpstr11 = []
+outstr11 = []
+
+# 01ABCDEF == 0x7F (E1, I1, I2, I3)
+names11.append("// Case XML11_ABCDEF X1")
+inpstr11.append("111111GH IJKLMNOP QRST**** ********")
+outstr11.append("111001GH 10IJKLMN 10OPQRST ********")
+
+# 0GHIJKLM == 0x7F (E1, E4)
+names11.append("// Case XML11_GHIJKLM X2")
+inpstr11.append("ABCDEF11 11111NOP QRST**** ********")
+outstr11.append("1110100A 10BCDEFN 10OPQRST ********")
+
+# 0NOPQRST == 0x7F (E1, E3)
+names11.append("// Case XML11_NOPQRST X3")
+inpstr11.append("ABCDEFGH IJKLM111 1111**** ********")
+outstr11.append("1110101A 10BCDEFG 10HIJKLM ********")
+
+# 110ABCDE 10MFIJKL in U+0080-U+009F (E3)
+names11.append("// Case XML11_C1_LEFT X4")
+inpstr11.append("00010F00 IJKL0NOP QRST**** ********")
+outstr11.append("11101100 10FIJKLN 10OPQRST ********")
+
+# 110ABCDE 10FPQRST in U+0080-U+009F (E4)
+names11.append("// Case XML11_C1_RIGHT X5")
+inpstr11.append("000100GH IJKLM00P QRST**** ********")
+outstr11.append("11100011 10GHIJKL 10MPQRST ********")
+
+# 01HIJKLM == 0x7F (E6)
+names11.append("// Case XML11_RIGHT_CANONICAL X6")
+inpstr11.append("0000EFG1 1111100P QRST**** ********")
+outstr11.append("11100001 100000EF 10GPQRST ********")
+
+# 01OPQRST == 0x7F (E5)
+names11.append("// Case XML11_LEFT_CANONICAL X7")
+inpstr11.append("0000EF00 IJKLMN11 1111**** ********")
+outstr11.append("11100001 100001EF 10IJKLMN ********")
+
+# 01EFIJKL == 0x7F (E2)
+names11.append("// Case XML11_BOTH_LEFT X8")
+inpstr11.append("ABCD1100 1111M00P QRST**** ********")
+outstr11.append("11100010 1001ABCD 10MPQRST ********")
+
+# 01MPQRST == 0x7F (E2)
+names11.append("// Case XML11_BOTH_RIGHT X9")
+inpstr11.append("ABCDEF00 IJKL1001 1111**** ********")
+outstr11.append("11100010 1011ABCD 10EFIJKL ********")
+
+# 01NOPQRS == 0x7F (I1)
+names11.append("// Case XML11_ILLEGAL<>_LEFT X10")
+inpstr11.append("ABCDEF01 111L0111 111T**** ********")
+outstr11.append("11100001 100010AB 10CDEFLT ********")
+
+# 01GHIJKL == 0x7F (I2)
+names11.append("// Case XML11_ILLEGAL<>_RIGHT X11")
+inpstr11.append("ABCDEF11 1111M011 11S0**** ********")
+outstr11.append("11100001 100011AB 10CDEFMS ********")
+
+for key, name in enumerate(names11):
+	print tabs[0:-1]+("} else " if key > 0 else "")
+	print tabs[0:-1]+name
+	print (code_coder(inpstr11[key], outstr11[key]))[0:-1]
+print tabs+"}"
+
+print "\n"*3
+
+print "// XML 1.1 DECODERS"
+
+print "\n"*3
+
+for key, name in enumerate(names11):
+	print tabs[0:-1]+("} else " if key > 0 else "")
+	print tabs[0:-1]+name+" DECODE"
+	print (code_coder(inpstr11[key], outstr11[key], True))[0:-1]
+print tabs+"}"